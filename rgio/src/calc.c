@@ -0,0 +1,710 @@
+/*
+ * calc.c
+ * Block-wise raster algebra over aligned inputs
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/* Largest block area processed at once */
+#define CALC_MAX_BLOCK_PIXELS 1048576
+/* Strips are grouped into units of about this many pixels */
+#define CALC_MIN_UNIT_PIXELS 262144
+
+/* -------------------------------------------------------------------------- */
+/*  Program                                                                   */
+/* -------------------------------------------------------------------------- */
+/*
+ * Expressions compile to a postfix program over whole blocks: every op
+ * reads its operands from the top of a stack of block-sized vectors and
+ * leaves its result there, so the interpreter dispatches once per op and
+ * block rather than once per pixel. Nodata travels as NaN.
+ */
+typedef enum {
+  CALC_INPUT, CALC_CONST,
+  CALC_NEG, CALC_NOT, CALC_ISNA, CALC_ABS, CALC_SQRT, CALC_LOG, CALC_EXP,
+  CALC_ADD, CALC_SUB, CALC_MUL, CALC_DIV, CALC_POW,
+  CALC_LT, CALC_LE, CALC_GT, CALC_GE, CALC_EQ, CALC_NE,
+  CALC_AND, CALC_OR,
+  CALC_IFELSE, CALC_MIN, CALC_MAX
+} calc_opcode;
+
+typedef struct {
+  calc_opcode op;
+  int arg;                 /* input index, or argument count of min/max */
+  double value;            /* constant */
+} calc_op;
+
+typedef struct {
+  calc_op *ops;
+  int n, cap;
+  int depth, max_depth;
+} calc_prog;
+
+static void calc_emit(calc_prog *prog, calc_opcode op, int arg, double value,
+                      int pops, int pushes) {
+  if (prog->n == prog->cap) {
+    prog->cap = prog->cap > 0 ? 2 * prog->cap : 32;
+    prog->ops = (calc_op *) CPLRealloc(prog->ops, prog->cap * sizeof(calc_op));
+  }
+  prog->ops[prog->n].op = op;
+  prog->ops[prog->n].arg = arg;
+  prog->ops[prog->n].value = value;
+  prog->n++;
+  prog->depth += pushes - pops;
+  if (prog->depth > prog->max_depth) prog->max_depth = prog->depth;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Parser                                                                    */
+/* -------------------------------------------------------------------------- */
+/*
+ *   expr    := and ('|' and)*
+ *   and     := cmp ('&' cmp)*
+ *   cmp     := add (('<' | '<=' | '>' | '>=' | '==' | '!=') add)?
+ *   add     := mul (('+' | '-') mul)*
+ *   mul     := unary (('*' | '/') unary)*
+ *   unary   := ('-' | '!') unary | power
+ *   power   := primary ('^' unary)?
+ *   primary := number | NA | TRUE | FALSE | name | name '(' args ')' | '(' expr ')'
+ *
+ * `&&` and `||` are accepted as `&` and `|`. Comparisons with NA give NA;
+ * `&` and `|` follow R's three-valued logic.
+ */
+typedef struct {
+  const char *text;
+  const char *p;
+  int n_names;
+  const char **names;
+  calc_prog *prog;
+  int failed;
+  char error[256];
+} calc_parser;
+
+static void calc_fail(calc_parser *ps, const char *what) {
+  if (ps->failed) return;
+  ps->failed = 1;
+  snprintf(ps->error, sizeof(ps->error), "%s at position %d of expression",
+           what, (int) (ps->p - ps->text) + 1);
+}
+
+static void calc_skip(calc_parser *ps) {
+  while (isspace((unsigned char) *ps->p)) ps->p++;
+}
+
+/* Consume `tok` if it comes next (and is not the start of a longer operator) */
+static int calc_accept(calc_parser *ps, const char *tok) {
+  calc_skip(ps);
+  size_t len = strlen(tok);
+  if (strncmp(ps->p, tok, len) != 0) return 0;
+  if (len == 1 && (tok[0] == '<' || tok[0] == '>' || tok[0] == '!') && ps->p[1] == '=')
+    return 0;
+  ps->p += len;
+  return 1;
+}
+
+static void calc_expr(calc_parser *ps);
+
+static int calc_name(calc_parser *ps, char *buf, size_t len) {
+  calc_skip(ps);
+  const char *s = ps->p;
+  if (!(isalpha((unsigned char) *s) || *s == '_' || *s == '.')) return 0;
+  size_t n = 0;
+  while (isalnum((unsigned char) s[n]) || s[n] == '_' || s[n] == '.') n++;
+  if (n >= len) {
+    calc_fail(ps, "Name too long");
+    return 0;
+  }
+  memcpy(buf, s, n);
+  buf[n] = '\0';
+  ps->p += n;
+  return 1;
+}
+
+static void calc_call(calc_parser *ps, const char *fn, const char *start) {
+  int n_args = 0;
+  if (!calc_accept(ps, ")")) {
+    do {
+      calc_expr(ps);
+      n_args++;
+    } while (!ps->failed && calc_accept(ps, ","));
+    if (!ps->failed && !calc_accept(ps, ")")) calc_fail(ps, "Expected ')'");
+  }
+  if (ps->failed) return;
+
+  static const struct { const char *name; calc_opcode op; } unary[] = {
+    { "abs", CALC_ABS }, { "sqrt", CALC_SQRT }, { "log", CALC_LOG },
+    { "exp", CALC_EXP }, { "is.na", CALC_ISNA }
+  };
+  for (size_t i = 0; i < sizeof(unary) / sizeof(unary[0]); i++) {
+    if (strcmp(fn, unary[i].name) == 0) {
+      if (n_args != 1) calc_fail(ps, CPLSPrintf("%s() takes 1 argument", fn));
+      else calc_emit(ps->prog, unary[i].op, 0, 0, 1, 1);
+      return;
+    }
+  }
+  if (strcmp(fn, "ifelse") == 0) {
+    if (n_args != 3) calc_fail(ps, "ifelse() takes 3 arguments");
+    else calc_emit(ps->prog, CALC_IFELSE, 0, 0, 3, 1);
+  } else if (strcmp(fn, "min") == 0 || strcmp(fn, "max") == 0) {
+    if (n_args < 1) calc_fail(ps, CPLSPrintf("%s() needs at least 1 argument", fn));
+    else calc_emit(ps->prog, fn[1] == 'i' ? CALC_MIN : CALC_MAX, n_args, 0, n_args, 1);
+  } else {
+    ps->p = start;
+    calc_fail(ps, CPLSPrintf("Unknown function '%s'", fn));
+  }
+}
+
+static void calc_primary(calc_parser *ps) {
+  calc_skip(ps);
+  char name[128];
+  if (calc_accept(ps, "(")) {
+    calc_expr(ps);
+    if (!ps->failed && !calc_accept(ps, ")")) calc_fail(ps, "Expected ')'");
+    return;
+  }
+  if (isdigit((unsigned char) *ps->p) ||
+      (*ps->p == '.' && isdigit((unsigned char) ps->p[1]))) {
+    char *end;
+    double v = CPLStrtod(ps->p, &end);
+    ps->p = end;
+    calc_emit(ps->prog, CALC_CONST, 0, v, 0, 1);
+    return;
+  }
+  const char *start = ps->p;
+  if (!calc_name(ps, name, sizeof(name))) {
+    calc_fail(ps, *ps->p ? "Unexpected character" : "Unexpected end");
+    return;
+  }
+  if (calc_accept(ps, "(")) {
+    calc_call(ps, name, start);
+    return;
+  }
+  if (strcmp(name, "NA") == 0) {
+    calc_emit(ps->prog, CALC_CONST, 0, NAN, 0, 1);
+    return;
+  }
+  if (strcmp(name, "TRUE") == 0 || strcmp(name, "FALSE") == 0) {
+    calc_emit(ps->prog, CALC_CONST, 0, name[0] == 'T', 0, 1);
+    return;
+  }
+  for (int i = 0; i < ps->n_names; i++) {
+    if (strcmp(name, ps->names[i]) == 0) {
+      calc_emit(ps->prog, CALC_INPUT, i, 0, 0, 1);
+      return;
+    }
+  }
+  ps->p = start;
+  calc_fail(ps, CPLSPrintf("Unknown input '%s'", name));
+}
+
+static void calc_unary(calc_parser *ps);
+
+static void calc_power(calc_parser *ps) {
+  calc_primary(ps);
+  if (!ps->failed && calc_accept(ps, "^")) {
+    calc_unary(ps);  /* right associative */
+    calc_emit(ps->prog, CALC_POW, 0, 0, 2, 1);
+  }
+}
+
+static void calc_unary(calc_parser *ps) {
+  if (calc_accept(ps, "-")) {
+    calc_unary(ps);
+    calc_emit(ps->prog, CALC_NEG, 0, 0, 1, 1);
+  } else if (calc_accept(ps, "!")) {
+    calc_unary(ps);
+    calc_emit(ps->prog, CALC_NOT, 0, 0, 1, 1);
+  } else if (calc_accept(ps, "+")) {
+    calc_unary(ps);
+  } else {
+    calc_power(ps);
+  }
+}
+
+static void calc_mul(calc_parser *ps) {
+  calc_unary(ps);
+  while (!ps->failed) {
+    calc_opcode op;
+    if (calc_accept(ps, "*")) op = CALC_MUL;
+    else if (calc_accept(ps, "/")) op = CALC_DIV;
+    else break;
+    calc_unary(ps);
+    calc_emit(ps->prog, op, 0, 0, 2, 1);
+  }
+}
+
+static void calc_add(calc_parser *ps) {
+  calc_mul(ps);
+  while (!ps->failed) {
+    calc_opcode op;
+    if (calc_accept(ps, "+")) op = CALC_ADD;
+    else if (calc_accept(ps, "-")) op = CALC_SUB;
+    else break;
+    calc_mul(ps);
+    calc_emit(ps->prog, op, 0, 0, 2, 1);
+  }
+}
+
+static void calc_cmp(calc_parser *ps) {
+  calc_add(ps);
+  if (ps->failed) return;
+  calc_opcode op;
+  if (calc_accept(ps, "<=")) op = CALC_LE;
+  else if (calc_accept(ps, ">=")) op = CALC_GE;
+  else if (calc_accept(ps, "==")) op = CALC_EQ;
+  else if (calc_accept(ps, "!=")) op = CALC_NE;
+  else if (calc_accept(ps, "<")) op = CALC_LT;
+  else if (calc_accept(ps, ">")) op = CALC_GT;
+  else return;
+  calc_add(ps);
+  calc_emit(ps->prog, op, 0, 0, 2, 1);
+}
+
+static void calc_and(calc_parser *ps) {
+  calc_cmp(ps);
+  while (!ps->failed && (calc_accept(ps, "&&") || calc_accept(ps, "&"))) {
+    calc_cmp(ps);
+    calc_emit(ps->prog, CALC_AND, 0, 0, 2, 1);
+  }
+}
+
+static void calc_expr(calc_parser *ps) {
+  calc_and(ps);
+  while (!ps->failed && (calc_accept(ps, "||") || calc_accept(ps, "|"))) {
+    calc_and(ps);
+    calc_emit(ps->prog, CALC_OR, 0, 0, 2, 1);
+  }
+}
+
+/* Compile `text`; returns 0 and sets `error` on syntax errors */
+static int calc_compile(const char *text, const char **names, int n_names,
+                        calc_prog *prog, char *error, size_t len) {
+  calc_parser ps;
+  memset(&ps, 0, sizeof(ps));
+  memset(prog, 0, sizeof(*prog));
+  ps.text = ps.p = text;
+  ps.names = names;
+  ps.n_names = n_names;
+  ps.prog = prog;
+  calc_expr(&ps);
+  calc_skip(&ps);
+  if (!ps.failed && *ps.p != '\0') calc_fail(&ps, "Unexpected input");
+  if (ps.failed) {
+    snprintf(error, len, "%s", ps.error);
+    return 0;
+  }
+  return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Evaluator                                                                 */
+/* -------------------------------------------------------------------------- */
+/*
+ * `slot[i]` points at the value of stack entry i: an input buffer (read
+ * only) or `scratch[i]`, which every op writing entry i may overwrite.
+ */
+#define CALC_BOOL(a, b, expr) (ISNAN(a) || ISNAN(b) ? NAN : ((expr) ? 1.0 : 0.0))
+
+static const double *calc_eval(const calc_prog *prog, double **inputs,
+                               double **scratch, const double **slot, size_t n) {
+  int sp = 0;
+  for (int k = 0; k < prog->n; k++) {
+    const calc_op *op = &prog->ops[k];
+    switch (op->op) {
+    case CALC_INPUT:
+      slot[sp++] = inputs[op->arg];
+      continue;
+    case CALC_CONST: {
+      double *o = scratch[sp];
+      for (size_t i = 0; i < n; i++) o[i] = op->value;
+      slot[sp++] = o;
+      continue;
+    }
+    default:
+      break;
+    }
+
+    if (op->op <= CALC_EXP) {
+      const double *a = slot[sp - 1];
+      double *o = scratch[sp - 1];
+      switch (op->op) {
+      case CALC_NEG:  for (size_t i = 0; i < n; i++) o[i] = -a[i]; break;
+      case CALC_NOT:  for (size_t i = 0; i < n; i++) o[i] = ISNAN(a[i]) ? NAN : a[i] == 0; break;
+      case CALC_ISNA: for (size_t i = 0; i < n; i++) o[i] = ISNAN(a[i]) ? 1.0 : 0.0; break;
+      case CALC_ABS:  for (size_t i = 0; i < n; i++) o[i] = fabs(a[i]); break;
+      case CALC_SQRT: for (size_t i = 0; i < n; i++) o[i] = a[i] >= 0 ? sqrt(a[i]) : NAN; break;
+      case CALC_LOG:  for (size_t i = 0; i < n; i++) o[i] = a[i] > 0 ? log(a[i]) : NAN; break;
+      case CALC_EXP:  for (size_t i = 0; i < n; i++) o[i] = exp(a[i]); break;
+      default: break;
+      }
+      slot[sp - 1] = o;
+      continue;
+    }
+
+    if (op->op <= CALC_OR) {
+      const double *a = slot[sp - 2], *b = slot[sp - 1];
+      double *o = scratch[sp - 2];
+      switch (op->op) {
+      case CALC_ADD: for (size_t i = 0; i < n; i++) o[i] = a[i] + b[i]; break;
+      case CALC_SUB: for (size_t i = 0; i < n; i++) o[i] = a[i] - b[i]; break;
+      case CALC_MUL: for (size_t i = 0; i < n; i++) o[i] = a[i] * b[i]; break;
+      case CALC_DIV:
+        /* x / 0 is nodata rather than Inf */
+        for (size_t i = 0; i < n; i++) o[i] = b[i] != 0 ? a[i] / b[i] : NAN;
+        break;
+      case CALC_POW: for (size_t i = 0; i < n; i++) o[i] = pow(a[i], b[i]); break;
+      case CALC_LT:  for (size_t i = 0; i < n; i++) o[i] = CALC_BOOL(a[i], b[i], a[i] < b[i]); break;
+      case CALC_LE:  for (size_t i = 0; i < n; i++) o[i] = CALC_BOOL(a[i], b[i], a[i] <= b[i]); break;
+      case CALC_GT:  for (size_t i = 0; i < n; i++) o[i] = CALC_BOOL(a[i], b[i], a[i] > b[i]); break;
+      case CALC_GE:  for (size_t i = 0; i < n; i++) o[i] = CALC_BOOL(a[i], b[i], a[i] >= b[i]); break;
+      case CALC_EQ:  for (size_t i = 0; i < n; i++) o[i] = CALC_BOOL(a[i], b[i], a[i] == b[i]); break;
+      case CALC_NE:  for (size_t i = 0; i < n; i++) o[i] = CALC_BOOL(a[i], b[i], a[i] != b[i]); break;
+      /* three-valued, as in R: NA & FALSE is FALSE, NA | TRUE is TRUE */
+      case CALC_AND:
+        for (size_t i = 0; i < n; i++) {
+          o[i] = a[i] == 0 || b[i] == 0 ? 0.0 : ISNAN(a[i]) || ISNAN(b[i]) ? NAN : 1.0;
+        }
+        break;
+      case CALC_OR:
+        for (size_t i = 0; i < n; i++) {
+          int ta = !ISNAN(a[i]) && a[i] != 0, tb = !ISNAN(b[i]) && b[i] != 0;
+          o[i] = ta || tb ? 1.0 : ISNAN(a[i]) || ISNAN(b[i]) ? NAN : 0.0;
+        }
+        break;
+      default: break;
+      }
+      slot[sp - 2] = o;
+      sp--;
+      continue;
+    }
+
+    if (op->op == CALC_IFELSE) {
+      const double *c = slot[sp - 3], *a = slot[sp - 2], *b = slot[sp - 1];
+      double *o = scratch[sp - 3];
+      for (size_t i = 0; i < n; i++) o[i] = ISNAN(c[i]) ? NAN : c[i] != 0 ? a[i] : b[i];
+      slot[sp - 3] = o;
+      sp -= 2;
+      continue;
+    }
+
+    /* min / max over op->arg operands, NaN if any is NaN */
+    int m = op->arg, base = sp - m;
+    double *o = scratch[base];
+    const double *first = slot[base];
+    if (o != first) memcpy(o, first, n * sizeof(double));
+    for (int j = 1; j < m; j++) {
+      const double *b = slot[base + j];
+      if (op->op == CALC_MIN) {
+        for (size_t i = 0; i < n; i++) o[i] = ISNAN(o[i]) || ISNAN(b[i]) ? NAN : b[i] < o[i] ? b[i] : o[i];
+      } else {
+        for (size_t i = 0; i < n; i++) o[i] = ISNAN(o[i]) || ISNAN(b[i]) ? NAN : b[i] > o[i] ? b[i] : o[i];
+      }
+    }
+    slot[base] = o;
+    sp = base + 1;
+  }
+  return slot[0];
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Block-parallel job                                                        */
+/* -------------------------------------------------------------------------- */
+/*
+ * Work units are windows of the output grid. Every worker opens its own
+ * handle on each input, evaluates the program on its window and writes the
+ * result to the shared output handle under the mutex.
+ */
+typedef struct {
+  int n_inputs;
+  const char **paths;
+  const int *bands;
+  const int *has_nodata;
+  const double *nodata;
+  const calc_prog *prog;
+  int has_out_nodata;
+  double out_nodata;
+  int bw, bh, nbx, width, height;
+  GIntBig n_units;
+  GDALRasterBandH out_band;
+  CPLMutex *mutex;
+  GIntBig next;
+  int failed;
+  char message[512];
+} calc_job;
+
+static void calc_job_fail(calc_job *job, const char *message) {
+  CPLAcquireMutex(job->mutex, 1000.0);
+  if (!job->failed) {
+    job->failed = 1;
+    snprintf(job->message, sizeof(job->message), "%s", message);
+  }
+  CPLReleaseMutex(job->mutex);
+}
+
+static void calc_worker(void *arg) {
+  calc_job *job = (calc_job *) arg;
+  int n_in = job->n_inputs;
+  int depth = job->prog->max_depth > 0 ? job->prog->max_depth : 1;
+  size_t max_px = (size_t) job->bw * job->bh;
+
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  GDALDatasetH *ds = (GDALDatasetH *) CPLCalloc(n_in, sizeof(GDALDatasetH));
+  double **inputs = (double **) CPLCalloc(n_in, sizeof(double *));
+  double **scratch = (double **) CPLCalloc(depth, sizeof(double *));
+  const double **slot = (const double **) CPLCalloc(depth, sizeof(double *));
+  int ready = 1;
+  for (int j = 0; j < n_in && ready; j++) {
+    ds[j] = GDALOpen(job->paths[j], GA_ReadOnly);
+    inputs[j] = (double *) VSIMalloc2(max_px, sizeof(double));
+    if (ds[j] == NULL || inputs[j] == NULL) {
+      calc_job_fail(job, CPLSPrintf("Failed to open %s", job->paths[j]));
+      ready = 0;
+    }
+  }
+  for (int d = 0; d < depth && ready; d++) {
+    scratch[d] = (double *) VSIMalloc2(max_px, sizeof(double));
+    if (scratch[d] == NULL) {
+      calc_job_fail(job, "Failed to allocate evaluation buffers");
+      ready = 0;
+    }
+  }
+
+  while (ready) {
+    CPLAcquireMutex(job->mutex, 1000.0);
+    GIntBig unit = job->failed || job->next >= job->n_units ? -1 : job->next++;
+    CPLReleaseMutex(job->mutex);
+    if (unit < 0) break;
+
+    int x0 = (int) (unit % job->nbx) * job->bw;
+    int y0 = (int) (unit / job->nbx) * job->bh;
+    int cw = job->width - x0 < job->bw ? job->width - x0 : job->bw;
+    int ch = job->height - y0 < job->bh ? job->height - y0 : job->bh;
+    size_t n = (size_t) cw * ch;
+
+    for (int j = 0; j < n_in && ready; j++) {
+      GDALRasterBandH band = GDALGetRasterBand(ds[j], job->bands[j]);
+      if (band == NULL ||
+          GDALRasterIO(band, GF_Read, x0, y0, cw, ch, inputs[j], cw, ch,
+                       GDT_Float64, 0, 0) != CE_None) {
+        calc_job_fail(job, CPLSPrintf("Failed to read %s: %s", job->paths[j],
+                                      CPLGetLastErrorMsg()));
+        ready = 0;
+        break;
+      }
+      if (job->has_nodata[j]) {
+        double nd = job->nodata[j];
+        double *v = inputs[j];
+        for (size_t i = 0; i < n; i++) if (v[i] == nd) v[i] = NAN;
+      }
+    }
+    if (!ready) break;
+
+    const double *res = calc_eval(job->prog, inputs, scratch, slot, n);
+    double *out = scratch[0];
+    if (res != out) memcpy(out, res, n * sizeof(double));
+    if (job->has_out_nodata) {
+      double nd = job->out_nodata;
+      for (size_t i = 0; i < n; i++) if (!isfinite(out[i])) out[i] = nd;
+    }
+
+    CPLAcquireMutex(job->mutex, 1000.0);
+    CPLErr err = GDALRasterIO(job->out_band, GF_Write, x0, y0, cw, ch, out, cw, ch,
+                              GDT_Float64, 0, 0);
+    if (err != CE_None && !job->failed) {
+      job->failed = 1;
+      snprintf(job->message, sizeof(job->message), "Failed to write block at %d,%d: %s",
+               x0, y0, CPLGetLastErrorMsg());
+    }
+    CPLReleaseMutex(job->mutex);
+    if (err != CE_None) break;
+  }
+
+  for (int d = 0; d < depth; d++) VSIFree(scratch[d]);
+  for (int j = 0; j < n_in; j++) {
+    VSIFree(inputs[j]);
+    if (ds[j] != NULL) GDALClose(ds[j]);
+  }
+  CPLFree(slot);
+  CPLFree(scratch);
+  CPLFree(inputs);
+  CPLFree(ds);
+  CPLPopErrorHandler();
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_calc                                                                */
+/* -------------------------------------------------------------------------- */
+/*
+ * Evaluate an expression over aligned single bands into a new raster.
+ *
+ * @param expr Expression text
+ * @param names Input names used in the expression
+ * @param paths Input raster paths (same length as names)
+ * @param bands Band index per input
+ * @param dst Output path
+ * @param dtype Output data type name
+ * @param nodata Output nodata (NA = NaN for float outputs)
+ * @param format Output driver ("GTiff", "COG", ...)
+ * @param co Creation options
+ * @param threads Worker threads (0 = all CPUs)
+ * @return list(path, ops, elapsed)
+ */
+SEXP _rgio_calc(SEXP expr, SEXP names, SEXP paths, SEXP bands, SEXP dst,
+                SEXP dtype, SEXP nodata, SEXP format, SEXP co, SEXP threads) {
+  const char *expr_str = CHAR(STRING_ELT(expr, 0));
+  const char *dst_file = CHAR(STRING_ELT(dst, 0));
+  const char *dtype_str = CHAR(STRING_ELT(dtype, 0));
+  const char *format_str = CHAR(STRING_ELT(format, 0));
+  int n_in = Rf_length(paths);
+  double t_start = rgio_elapsed_seconds();
+  GDALAllRegister();
+
+  const char **in_names = (const char **) R_alloc(n_in + 1, sizeof(char *));
+  const char **in_paths = (const char **) R_alloc(n_in + 1, sizeof(char *));
+  int *has_nd = (int *) R_alloc(n_in + 1, sizeof(int));
+  double *nd = (double *) R_alloc(n_in + 1, sizeof(double));
+  for (int j = 0; j < n_in; j++) {
+    in_names[j] = CHAR(STRING_ELT(names, j));
+    in_paths[j] = CHAR(STRING_ELT(paths, j));
+  }
+
+  calc_prog prog;
+  char message[256];
+  if (!calc_compile(expr_str, in_names, n_in, &prog, message, sizeof(message))) {
+    CPLFree(prog.ops);
+    error("%s", message);
+  }
+
+  /* Grid of the first input; the others must match it */
+  double gt0[6] = { 0, 1, 0, 0, 0, -1 };
+  int width = 0, height = 0;
+  char *wkt = NULL;
+  for (int j = 0; j < n_in; j++) {
+    GDALDatasetH ds = GDALOpen(in_paths[j], GA_ReadOnly);
+    if (ds == NULL) {
+      CPLFree(prog.ops);
+      CPLFree(wkt);
+      error("Failed to open dataset: %s", in_paths[j]);
+    }
+    int b = INTEGER(bands)[j];
+    if (b < 1 || b > GDALGetRasterCount(ds)) {
+      GDALClose(ds);
+      CPLFree(prog.ops);
+      CPLFree(wkt);
+      error("Band %d does not exist in %s", b, in_paths[j]);
+    }
+    nd[j] = GDALGetRasterNoDataValue(GDALGetRasterBand(ds, b), &has_nd[j]);
+    double gt[6] = { 0, 1, 0, 0, 0, -1 };
+    GDALGetGeoTransform(ds, gt);
+    if (j == 0) {
+      memcpy(gt0, gt, sizeof(gt));
+      width = GDALGetRasterXSize(ds);
+      height = GDALGetRasterYSize(ds);
+      wkt = CPLStrdup(GDALGetProjectionRef(ds));
+    } else {
+      double tol = 1e-6 * (fabs(gt0[1]) + fabs(gt0[5]));
+      int aligned = GDALGetRasterXSize(ds) == width && GDALGetRasterYSize(ds) == height;
+      for (int k = 0; k < 6 && aligned; k++) aligned = fabs(gt[k] - gt0[k]) <= tol;
+      if (!aligned) {
+        GDALClose(ds);
+        CPLFree(prog.ops);
+        CPLFree(wkt);
+        error("Input '%s' is not aligned with '%s' (size or geotransform differ)",
+              in_names[j], in_names[0]);
+      }
+    }
+    GDALClose(ds);
+  }
+
+  calc_job job;
+  memset(&job, 0, sizeof(job));
+  job.n_inputs = n_in;
+  job.paths = in_paths;
+  job.bands = INTEGER(bands);
+  job.has_nodata = has_nd;
+  job.nodata = nd;
+  job.prog = &prog;
+  job.width = width;
+  job.height = height;
+  job.out_nodata = REAL(nodata)[0];
+  job.has_out_nodata = !ISNAN(job.out_nodata);
+
+  char **create_opts = NULL;
+  for (int i = 0; i < Rf_length(co); i++) {
+    create_opts = CSLAddString(create_opts, CHAR(STRING_ELT(co, i)));
+  }
+  rgio_output out;
+  int created = rgio_output_create(&out, dst_file, format_str, dtype_str, gt0,
+                                   width, height, wkt, 1, create_opts);
+  CSLDestroy(create_opts);
+  CPLFree(wkt);
+  if (!created) {
+    CPLFree(prog.ops);
+    error("Failed to create output raster: %s (%s)", dst_file, CPLGetLastErrorMsg());
+  }
+  job.out_band = GDALGetRasterBand(out.ds, 1);
+  if (job.has_out_nodata) {
+    GDALSetRasterNoDataValue(job.out_band, job.out_nodata);
+  } else if (!GDALDataTypeIsInteger(GDALGetRasterDataType(job.out_band))) {
+    GDALSetRasterNoDataValue(job.out_band, NAN);
+  }
+
+  /* Work units follow the output blocks; strips are grouped */
+  GDALGetBlockSize(job.out_band, &job.bw, &job.bh);
+  if (job.bw <= 0 || job.bw > width) job.bw = width;
+  if (job.bh <= 0 || job.bh > height) job.bh = height;
+  if (job.bw == width && (double) job.bw * job.bh < CALC_MIN_UNIT_PIXELS) {
+    int k = CALC_MIN_UNIT_PIXELS / (job.bw * job.bh);
+    job.bh = job.bh * k < height ? job.bh * k : height;
+  }
+  if ((double) job.bw * job.bh > CALC_MAX_BLOCK_PIXELS) {
+    job.bh = CALC_MAX_BLOCK_PIXELS / job.bw > 0 ? CALC_MAX_BLOCK_PIXELS / job.bw : 1;
+  }
+  job.nbx = (width + job.bw - 1) / job.bw;
+  job.n_units = (GIntBig) job.nbx * ((height + job.bh - 1) / job.bh);
+
+  int n_workers = rgio_resolve_threads(INTEGER(threads)[0],
+                                       job.n_units < 65536 ? (int) job.n_units : 65536);
+  job.mutex = CPLCreateMutex();
+  CPLReleaseMutex(job.mutex);
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+  for (int i = 1; i < n_workers; i++) {
+    workers[i] = CPLCreateJoinableThread(calc_worker, &job);
+  }
+  calc_worker(&job);  /* the calling thread takes part too */
+  for (int i = 1; i < n_workers; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLDestroyMutex(job.mutex);
+  int n_ops = prog.n;
+  CPLFree(prog.ops);
+
+  if (!rgio_output_finish(&out, !job.failed)) {
+    if (job.failed) error("%s", job.message);
+    error("Failed to write %s output: %s", format_str, dst_file);
+  }
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 3));
+  SEXP res_names = PROTECT(Rf_allocVector(STRSXP, 3));
+  SET_VECTOR_ELT(result, 0, Rf_mkString(dst_file));
+  SET_STRING_ELT(res_names, 0, Rf_mkChar("path"));
+  SET_VECTOR_ELT(result, 1, Rf_ScalarInteger(n_ops));
+  SET_STRING_ELT(res_names, 1, Rf_mkChar("ops"));
+  SET_VECTOR_ELT(result, 2, Rf_ScalarReal(rgio_elapsed_seconds() - t_start));
+  SET_STRING_ELT(res_names, 2, Rf_mkChar("elapsed"));
+  Rf_setAttrib(result, R_NamesSymbol, res_names);
+  UNPROTECT(2);
+  return result;
+}
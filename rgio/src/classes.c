@@ -0,0 +1,482 @@
+/*
+ * classes.c
+ * Per class pixel counts and areas of categorical rasters
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <gdal.h>
+#include <ogr_srs_api.h>
+#include <cpl_conv.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/* Largest block area read at once; bigger strips are split across workers */
+#define CL_MAX_BLOCK_PIXELS 4194304
+
+/* -------------------------------------------------------------------------- */
+/*  Per-thread class tables                                                   */
+/* -------------------------------------------------------------------------- */
+/*
+ * Types of up to 16 bits count into a direct array indexed by value - offset;
+ * 32-bit types use an open addressing hash table keyed by value.
+ */
+typedef struct {
+  int direct;
+  GIntBig offset;
+  size_t cap;              /* array size, or hash slots (power of two) */
+  size_t n;                /* occupied hash slots */
+  GIntBig *keys;           /* hash keys, NULL for direct tables */
+  unsigned char *used;     /* hash slot flags */
+  double *count;
+  double *area;
+} cl_table;
+
+static int cl_table_init(cl_table *t, int direct, GIntBig offset, size_t cap) {
+  memset(t, 0, sizeof(*t));
+  t->direct = direct;
+  t->offset = offset;
+  t->cap = cap;
+  t->count = (double *) VSICalloc(cap, sizeof(double));
+  t->area = (double *) VSICalloc(cap, sizeof(double));
+  if (!direct) {
+    t->keys = (GIntBig *) VSICalloc(cap, sizeof(GIntBig));
+    t->used = (unsigned char *) VSICalloc(cap, 1);
+  }
+  return t->count != NULL && t->area != NULL &&
+         (direct || (t->keys != NULL && t->used != NULL));
+}
+
+static void cl_table_free(cl_table *t) {
+  VSIFree(t->count);
+  VSIFree(t->area);
+  VSIFree(t->keys);
+  VSIFree(t->used);
+  memset(t, 0, sizeof(*t));
+}
+
+static size_t cl_hash_slot(const cl_table *t, GIntBig key) {
+  GUIntBig h = (GUIntBig) key * 0x9E3779B97F4A7C15ULL;
+  size_t i = (size_t) (h >> 32) & (t->cap - 1);
+  while (t->used[i] && t->keys[i] != key) i = (i + 1) & (t->cap - 1);
+  return i;
+}
+
+/* Double the hash table once it is half full; returns 0 when out of memory */
+static int cl_hash_grow(cl_table *t) {
+  cl_table bigger;
+  if (!cl_table_init(&bigger, 0, 0, t->cap * 2)) {
+    cl_table_free(&bigger);
+    return 0;
+  }
+  for (size_t i = 0; i < t->cap; i++) {
+    if (!t->used[i]) continue;
+    size_t j = cl_hash_slot(&bigger, t->keys[i]);
+    bigger.used[j] = 1;
+    bigger.keys[j] = t->keys[i];
+    bigger.count[j] = t->count[i];
+    bigger.area[j] = t->area[i];
+    bigger.n++;
+  }
+  cl_table_free(t);
+  *t = bigger;
+  return 1;
+}
+
+static int cl_add(cl_table *t, GIntBig key, double count, double area) {
+  if (t->direct) {
+    t->count[key - t->offset] += count;
+    t->area[key - t->offset] += area;
+    return 1;
+  }
+  size_t i = cl_hash_slot(t, key);
+  if (!t->used[i]) {
+    if (2 * (t->n + 1) > t->cap) {
+      if (!cl_hash_grow(t)) return 0;
+      i = cl_hash_slot(t, key);
+    }
+    t->used[i] = 1;
+    t->keys[i] = key;
+    t->n++;
+  }
+  t->count[i] += count;
+  t->area[i] += area;
+  return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Block-parallel count                                                      */
+/* -------------------------------------------------------------------------- */
+/*
+ * Work units are blocks of the band. Every worker opens its own dataset
+ * handle, claims blocks under the mutex and counts into its own table.
+ * Blocks are read as Int32 (UInt32 for UInt32 bands) so that values keep
+ * their integer identity. With `row_area` set, each pixel also adds the area
+ * of its row; otherwise areas are derived from counts after the merge.
+ */
+typedef struct {
+  const char *path;
+  int band;
+  GDALDataType read_type;
+  int bw, bh, nbx, nby, width, height;
+  int has_nodata;
+  GIntBig nodata;
+  const double *row_area;
+  cl_table *tables;        /* one per thread */
+  CPLMutex *mutex;
+  GIntBig next, n_units;
+  int failed;
+  char message[512];
+} cl_job;
+
+typedef struct {
+  cl_job *job;
+  int tid;
+} cl_worker_arg;
+
+static void cl_fail(cl_job *job, const char *message) {
+  CPLAcquireMutex(job->mutex, 1000.0);
+  if (!job->failed) {
+    job->failed = 1;
+    snprintf(job->message, sizeof(job->message), "%s", message);
+  }
+  CPLReleaseMutex(job->mutex);
+}
+
+static void cl_worker(void *arg) {
+  cl_worker_arg *wa = (cl_worker_arg *) arg;
+  cl_job *job = wa->job;
+  cl_table *table = &job->tables[wa->tid];
+  int is_u32 = job->read_type == GDT_UInt32;
+
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  GDALDatasetH ds = GDALOpen(job->path, GA_ReadOnly);
+  GDALRasterBandH band = ds != NULL ? GDALGetRasterBand(ds, job->band) : NULL;
+  void *buf = VSIMalloc2((size_t) job->bw * job->bh, 4);
+  if (band == NULL || buf == NULL) {
+    char message[512];
+    snprintf(message, sizeof(message), "Failed to open %s", job->path);
+    cl_fail(job, message);
+  }
+
+  while (band != NULL && buf != NULL) {
+    CPLAcquireMutex(job->mutex, 1000.0);
+    GIntBig unit = job->failed || job->next >= job->n_units ? -1 : job->next++;
+    CPLReleaseMutex(job->mutex);
+    if (unit < 0) break;
+
+    int x0 = (int) (unit % job->nbx) * job->bw;
+    int y0 = (int) (unit / job->nbx) * job->bh;
+    int cw = job->width - x0 < job->bw ? job->width - x0 : job->bw;
+    int ch = job->height - y0 < job->bh ? job->height - y0 : job->bh;
+
+    if (GDALRasterIO(band, GF_Read, x0, y0, cw, ch, buf, cw, ch,
+                     job->read_type, 0, 0) != CE_None) {
+      char message[512];
+      snprintf(message, sizeof(message), "Failed to read block at %d,%d: %s",
+               x0, y0, CPLGetLastErrorMsg());
+      cl_fail(job, message);
+      break;
+    }
+
+    const GInt32 *s32 = (const GInt32 *) buf;
+    const GUInt32 *u32 = (const GUInt32 *) buf;
+    int ok = 1;
+    for (int r = 0; r < ch && ok; r++) {
+      double cell = job->row_area != NULL ? job->row_area[y0 + r] : 0;
+      size_t row = (size_t) r * cw;
+      if (table->direct) {
+        /* hot path for Byte/Int8/UInt16/Int16 */
+        double *count = table->count - table->offset;
+        double *area = table->area - table->offset;
+        for (int c = 0; c < cw; c++) {
+          GIntBig v = s32[row + c];
+          if (job->has_nodata && v == job->nodata) continue;
+          count[v] += 1;
+          area[v] += cell;
+        }
+        continue;
+      }
+      for (int c = 0; c < cw && ok; c++) {
+        GIntBig v = is_u32 ? (GIntBig) u32[row + c] : (GIntBig) s32[row + c];
+        if (job->has_nodata && v == job->nodata) continue;
+        ok = cl_add(table, v, 1, cell);
+      }
+    }
+    if (!ok) {
+      cl_fail(job, "Out of memory while counting classes");
+      break;
+    }
+  }
+
+  VSIFree(buf);
+  if (ds != NULL) GDALClose(ds);
+  CPLPopErrorHandler();
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Cell areas                                                                */
+/* -------------------------------------------------------------------------- */
+/*
+ * Area on the ellipsoid of each row of a north-up geographic grid:
+ * dlambda * b^2 / 2 * |q(phi1) - q(phi2)|, with q the authalic latitude
+ * function. Returns 0 if the CRS is not geographic or the grid is rotated.
+ */
+static double cl_q(double sin_phi, double e) {
+  if (e < 1e-12) return 2 * sin_phi;
+  double es = e * sin_phi;
+  return sin_phi / (1 - es * es) + log((1 + es) / (1 - es)) / (2 * e);
+}
+
+static int cl_row_areas(GDALDatasetH ds, const double *gt, int height, double *row_area) {
+  const char *wkt = GDALGetProjectionRef(ds);
+  if (wkt == NULL || wkt[0] == '\0' || gt[2] != 0 || gt[4] != 0) return 0;
+
+  OGRSpatialReferenceH srs = OSRNewSpatialReference(wkt);
+  if (srs == NULL) return 0;
+  if (!OSRIsGeographic(srs)) {
+    OSRDestroySpatialReference(srs);
+    return 0;
+  }
+  OGRErr err;
+  double a = OSRGetSemiMajor(srs, &err);
+  double inv_f = OSRGetInvFlattening(srs, &err);
+  double to_rad = OSRGetAngularUnits(srs, NULL);
+  OSRDestroySpatialReference(srs);
+  if (to_rad <= 0) to_rad = M_PI / 180;
+
+  double f = inv_f > 0 ? 1 / inv_f : 0;
+  double e = sqrt(f * (2 - f));
+  double b2 = a * a * (1 - e * e);
+  double dlambda = fabs(gt[1]) * to_rad;
+  for (int y = 0; y < height; y++) {
+    double phi1 = (gt[3] + y * gt[5]) * to_rad;
+    double phi2 = (gt[3] + (y + 1) * gt[5]) * to_rad;
+    if (phi1 > M_PI / 2) phi1 = M_PI / 2;
+    if (phi1 < -M_PI / 2) phi1 = -M_PI / 2;
+    if (phi2 > M_PI / 2) phi2 = M_PI / 2;
+    if (phi2 < -M_PI / 2) phi2 = -M_PI / 2;
+    row_area[y] = dlambda * b2 / 2 * fabs(cl_q(sin(phi1), e) - cl_q(sin(phi2), e));
+  }
+  return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_class_area                                                          */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  GIntBig value;
+  double count, area;
+} cl_entry;
+
+static int cl_entry_cmp(const void *a, const void *b) {
+  GIntBig x = ((const cl_entry *) a)->value, y = ((const cl_entry *) b)->value;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Pixel count and area per class value of an integer band, with the
+ * category name and color table entry of each value.
+ *
+ * @param path Raster path
+ * @param band Band index
+ * @param mode Area mode: 0 = geodesic for geographic CRSs, else planar;
+ *        1 = planar (CRS units squared); 2 = geodesic (fails if the CRS
+ *        is not geographic)
+ * @param threads Worker threads (0 = all CPUs)
+ * @return list(value, count, area, label, color = n x 4 integer matrix,
+ *         geodesic); label and color are NA where the band has none
+ */
+SEXP _rgio_class_area(SEXP path, SEXP band, SEXP mode, SEXP threads) {
+  const char *file = CHAR(STRING_ELT(path, 0));
+  int band_idx = INTEGER(band)[0];
+  int area_mode = INTEGER(mode)[0];
+  GDALAllRegister();
+
+  GDALDatasetH ds = GDALOpen(file, GA_ReadOnly);
+  if (ds == NULL) {
+    error("Failed to open dataset: %s", file);
+  }
+  if (band_idx < 1 || band_idx > GDALGetRasterCount(ds)) {
+    GDALClose(ds);
+    error("Band %d does not exist in %s", band_idx, file);
+  }
+  GDALRasterBandH hband = GDALGetRasterBand(ds, band_idx);
+  GDALDataType dt = GDALGetRasterDataType(hband);
+
+  cl_job job;
+  memset(&job, 0, sizeof(job));
+  job.path = file;
+  job.band = band_idx;
+
+  int direct = 1;
+  GIntBig offset = 0;
+  size_t cap = 0;
+  switch (dt) {
+  case GDT_Byte:   cap = 256;                     break;
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 7, 0)
+  case GDT_Int8:   cap = 256;   offset = -128;    break;
+#endif
+  case GDT_UInt16: cap = 65536;                   break;
+  case GDT_Int16:  cap = 65536; offset = -32768;  break;
+  case GDT_Int32:  direct = 0;  cap = 1024;       break;
+  case GDT_UInt32: direct = 0;  cap = 1024;       break;
+  default:
+    GDALClose(ds);
+    error("Band %d of %s is %s; class areas need an integer band of up to 32 bits",
+          band_idx, file, GDALGetDataTypeName(dt));
+  }
+  job.read_type = dt == GDT_UInt32 ? GDT_UInt32 : GDT_Int32;
+
+  double nd = GDALGetRasterNoDataValue(hband, &job.has_nodata);
+  if (job.has_nodata && (ISNAN(nd) || nd != floor(nd))) job.has_nodata = 0;
+  job.nodata = job.has_nodata ? (GIntBig) nd : 0;
+
+  job.width = GDALGetRasterXSize(ds);
+  job.height = GDALGetRasterYSize(ds);
+  GDALGetBlockSize(hband, &job.bw, &job.bh);
+  if (job.bw <= 0 || job.bw > job.width) job.bw = job.width;
+  if (job.bh <= 0 || job.bh > job.height) job.bh = job.height;
+  if ((double) job.bw * job.bh > CL_MAX_BLOCK_PIXELS) {
+    job.bh = CL_MAX_BLOCK_PIXELS / job.bw > 0 ? CL_MAX_BLOCK_PIXELS / job.bw : 1;
+  }
+  job.nbx = job.width > 0 ? (job.width + job.bw - 1) / job.bw : 0;
+  job.nby = job.height > 0 ? (job.height + job.bh - 1) / job.bh : 0;
+  job.n_units = (GIntBig) job.nbx * job.nby;
+
+  double gt[6] = { 0, 1, 0, 0, 0, -1 };
+  GDALGetGeoTransform(ds, gt);
+  double *row_area = (double *) R_alloc(job.height > 0 ? job.height : 1, sizeof(double));
+  int geodesic = area_mode != 1 && cl_row_areas(ds, gt, job.height, row_area);
+  if (area_mode == 2 && !geodesic) {
+    GDALClose(ds);
+    error("Geodesic areas need a north-up raster in a geographic CRS: %s", file);
+  }
+  job.row_area = geodesic ? row_area : NULL;
+
+  int n_workers = rgio_resolve_threads(INTEGER(threads)[0],
+                                       job.n_units > 0 && job.n_units < 65536 ? (int) job.n_units : 65536);
+  job.tables = (cl_table *) CPLCalloc(n_workers, sizeof(cl_table));
+  for (int t = 0; t < n_workers; t++) {
+    if (!cl_table_init(&job.tables[t], direct, offset, cap)) {
+      for (int k = 0; k <= t; k++) cl_table_free(&job.tables[k]);
+      CPLFree(job.tables);
+      GDALClose(ds);
+      error("Failed to allocate class tables");
+    }
+  }
+  job.mutex = CPLCreateMutex();
+  CPLReleaseMutex(job.mutex);
+
+  if (job.n_units > 0) {
+    cl_worker_arg *args = (cl_worker_arg *) CPLCalloc(n_workers, sizeof(cl_worker_arg));
+    CPLJoinableThread **workers =
+      (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+    for (int i = 0; i < n_workers; i++) {
+      args[i].job = &job;
+      args[i].tid = i;
+    }
+    for (int i = 1; i < n_workers; i++) {
+      workers[i] = CPLCreateJoinableThread(cl_worker, &args[i]);
+    }
+    cl_worker(&args[0]);  /* the calling thread takes part too */
+    for (int i = 1; i < n_workers; i++) {
+      if (workers[i]) CPLJoinThread(workers[i]);
+    }
+    CPLFree(workers);
+    CPLFree(args);
+  }
+  CPLDestroyMutex(job.mutex);
+
+  /* Merge the thread tables into the first one */
+  cl_table *total = &job.tables[0];
+  for (int t = 1; t < n_workers && !job.failed; t++) {
+    cl_table *tb = &job.tables[t];
+    for (size_t i = 0; i < tb->cap && !job.failed; i++) {
+      if (tb->direct ? tb->count[i] == 0 : !tb->used[i]) continue;
+      GIntBig key = tb->direct ? (GIntBig) i + tb->offset : tb->keys[i];
+      if (!cl_add(total, key, tb->count[i], tb->area[i])) {
+        job.failed = 1;
+        snprintf(job.message, sizeof(job.message), "Out of memory while merging classes");
+      }
+    }
+  }
+  for (int t = 1; t < n_workers; t++) cl_table_free(&job.tables[t]);
+  if (job.failed) {
+    cl_table_free(total);
+    CPLFree(job.tables);
+    GDALClose(ds);
+    error("%s", job.message);
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < total->cap; i++) {
+    if (total->direct ? total->count[i] > 0 : total->used[i]) n++;
+  }
+  cl_entry *entries = (cl_entry *) R_alloc(n > 0 ? n : 1, sizeof(cl_entry));
+  n = 0;
+  for (size_t i = 0; i < total->cap; i++) {
+    if (total->direct ? total->count[i] == 0 : !total->used[i]) continue;
+    entries[n].value = total->direct ? (GIntBig) i + total->offset : total->keys[i];
+    entries[n].count = total->count[i];
+    entries[n].area = total->area[i];
+    n++;
+  }
+  cl_table_free(total);
+  CPLFree(job.tables);
+  qsort(entries, n, sizeof(cl_entry), cl_entry_cmp);
+
+  double cell = fabs(gt[1] * gt[5] - gt[2] * gt[4]);
+  GDALColorTableH ct = GDALGetRasterColorTable(hband);
+  int n_colors = ct != NULL ? GDALGetColorEntryCount(ct) : 0;
+  char **categories = GDALGetRasterCategoryNames(hband);
+  int n_categories = CSLCount((CSLConstList) categories);
+
+  SEXP r_value = PROTECT(Rf_allocVector(REALSXP, n));
+  SEXP r_count = PROTECT(Rf_allocVector(REALSXP, n));
+  SEXP r_area = PROTECT(Rf_allocVector(REALSXP, n));
+  SEXP r_label = PROTECT(Rf_allocVector(STRSXP, n));
+  SEXP r_color = PROTECT(Rf_allocMatrix(INTSXP, n, 4));
+  int *color = INTEGER(r_color);
+
+  for (size_t i = 0; i < n; i++) {
+    GIntBig v = entries[i].value;
+    REAL(r_value)[i] = (double) v;
+    REAL(r_count)[i] = entries[i].count;
+    REAL(r_area)[i] = geodesic ? entries[i].area : entries[i].count * cell;
+
+    const char *label = v >= 0 && v < n_categories ? categories[v] : NULL;
+    SET_STRING_ELT(r_label, i, label != NULL && label[0] != '\0' ? Rf_mkChar(label) : NA_STRING);
+
+    const GDALColorEntry *ce = v >= 0 && v < n_colors ? GDALGetColorEntry(ct, (int) v) : NULL;
+    color[i] = ce != NULL ? ce->c1 : NA_INTEGER;
+    color[i + n] = ce != NULL ? ce->c2 : NA_INTEGER;
+    color[i + 2 * n] = ce != NULL ? ce->c3 : NA_INTEGER;
+    color[i + 3 * n] = ce != NULL ? ce->c4 : NA_INTEGER;
+  }
+  GDALClose(ds);
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 6));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 6));
+  SET_VECTOR_ELT(result, 0, r_value);
+  SET_STRING_ELT(names, 0, Rf_mkChar("value"));
+  SET_VECTOR_ELT(result, 1, r_count);
+  SET_STRING_ELT(names, 1, Rf_mkChar("count"));
+  SET_VECTOR_ELT(result, 2, r_area);
+  SET_STRING_ELT(names, 2, Rf_mkChar("area"));
+  SET_VECTOR_ELT(result, 3, r_label);
+  SET_STRING_ELT(names, 3, Rf_mkChar("label"));
+  SET_VECTOR_ELT(result, 4, r_color);
+  SET_STRING_ELT(names, 4, Rf_mkChar("color"));
+  SET_VECTOR_ELT(result, 5, Rf_ScalarLogical(geodesic));
+  SET_STRING_ELT(names, 5, Rf_mkChar("geodesic"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  UNPROTECT(7);
+  return result;
+}
@@ -0,0 +1,249 @@
+/*
+ * codec.c
+ * Trial compression of sample tiles for choosing GeoTIFF/COG codecs
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/* -------------------------------------------------------------------------- */
+/*  Sample tiles                                                              */
+/* -------------------------------------------------------------------------- */
+/*
+ * Copy a source window (all bands, native type) into a MEM dataset, so that
+ * every candidate compresses exactly the same pixels without touching the
+ * source again.
+ */
+static GDALDatasetH codec_read_tile(GDALDatasetH src, const int *win,
+                                    GDALDataType dtype, int n_bands) {
+  GDALDriverH mem_drv = GDALGetDriverByName("MEM");
+  if (mem_drv == NULL) return NULL;
+
+  GDALDatasetH mem = GDALCreate(mem_drv, "", win[2], win[3], n_bands, dtype, NULL);
+  if (mem == NULL) return NULL;
+
+  size_t n = (size_t) win[2] * win[3] * n_bands;
+  void *buf = VSIMalloc2(n, GDALGetDataTypeSizeBytes(dtype));
+  if (buf == NULL) {
+    GDALClose(mem);
+    return NULL;
+  }
+
+  CPLErr err = GDALDatasetRasterIO(src, GF_Read, win[0], win[1], win[2], win[3],
+                                   buf, win[2], win[3], dtype, n_bands, NULL,
+                                   0, 0, 0);
+  if (err == CE_None) {
+    err = GDALDatasetRasterIO(mem, GF_Write, 0, 0, win[2], win[3],
+                              buf, win[2], win[3], dtype, n_bands, NULL,
+                              0, 0, 0);
+  }
+  VSIFree(buf);
+  if (err != CE_None) {
+    GDALClose(mem);
+    return NULL;
+  }
+  return mem;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  One candidate on one tile                                                 */
+/* -------------------------------------------------------------------------- */
+/*
+ * Encode `tile` to a tiled GeoTIFF in /vsimem/ with creation options `co`,
+ * then reopen it and decode every pixel. Returns 0 on success and adds the
+ * compressed size and both timings to the accumulators; on failure the
+ * GDAL message (or a short reason) is copied to `message`.
+ */
+static int codec_trial(GDALDatasetH tile, char **co, const char *path,
+                       void *buf, double *bytes, double *encode,
+                       double *decode, char *message, size_t len) {
+  GDALDriverH gtiff = GDALGetDriverByName("GTiff");
+  int w = GDALGetRasterXSize(tile), h = GDALGetRasterYSize(tile);
+  int n_bands = GDALGetRasterCount(tile);
+  GDALDataType dtype = GDALGetRasterDataType(GDALGetRasterBand(tile, 1));
+
+  CPLErrorReset();
+  double t0 = rgio_elapsed_seconds();
+  GDALDatasetH out = GDALCreateCopy(gtiff, path, tile, FALSE, co, NULL, NULL);
+  if (out == NULL) {
+    snprintf(message, len, "%s", CPLGetLastErrorMsg()[0] ? CPLGetLastErrorMsg()
+                                                          : "encoding failed");
+    return 1;
+  }
+  GDALClose(out);
+  double t1 = rgio_elapsed_seconds();
+
+  VSIStatBufL st;
+  if (VSIStatL(path, &st) != 0) {
+    snprintf(message, len, "encoded file not found");
+    VSIUnlink(path);
+    return 1;
+  }
+
+  GDALDatasetH in = GDALOpen(path, GA_ReadOnly);
+  if (in == NULL) {
+    snprintf(message, len, "%s", CPLGetLastErrorMsg());
+    VSIUnlink(path);
+    return 1;
+  }
+
+  /* GTiff only warns about unknown or unavailable codecs and then writes
+   * uncompressed tiles, which must not be reported as a result */
+  const char *want = CSLFetchNameValue((CSLConstList) co, "COMPRESS");
+  const char *got = GDALGetMetadataItem(in, "COMPRESSION", "IMAGE_STRUCTURE");
+  if (want != NULL && !EQUAL(want, "NONE") && (got == NULL || !EQUAL(want, got))) {
+    snprintf(message, len, "codec %s is not available in this GDAL build", want);
+    GDALClose(in);
+    VSIUnlink(path);
+    return 1;
+  }
+
+  double t2 = rgio_elapsed_seconds();
+  CPLErr err = GDALDatasetRasterIO(in, GF_Read, 0, 0, w, h, buf, w, h,
+                                   dtype, n_bands, NULL, 0, 0, 0);
+  double t3 = rgio_elapsed_seconds();
+  GDALClose(in);
+  VSIUnlink(path);
+
+  if (err != CE_None) {
+    snprintf(message, len, "%s", CPLGetLastErrorMsg()[0] ? CPLGetLastErrorMsg()
+                                                          : "decoding failed");
+    return 1;
+  }
+
+  *bytes += (double) st.st_size;
+  *encode += t1 - t0;
+  *decode += t3 - t2;
+  return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_codec_bench                                                         */
+/* -------------------------------------------------------------------------- */
+/*
+ * Trial-compress sample tiles of a raster under several creation option sets.
+ *
+ * Tiles are written as single-tile GeoTIFFs (TILED=YES with the tile as
+ * block size) to /vsimem/, with GDAL_NUM_THREADS=1 on the calling thread so
+ * timings reflect one core per tile, as in a tile-parallel writer.
+ *
+ * @param src Source raster path
+ * @param windows Integer matrix n x 4 (xoff, yoff, xsize, ysize) of tiles
+ * @param candidates List of character vectors of GTiff creation options
+ * @return list(raw_bytes, bytes, encode, decode, error), one element of
+ *         each vector per candidate; timings in seconds over all tiles
+ */
+SEXP _rgio_codec_bench(SEXP src, SEXP windows, SEXP candidates) {
+  const char *src_file = CHAR(STRING_ELT(src, 0));
+  GDALAllRegister();
+
+  GDALDatasetH src_ds = GDALOpen(src_file, GA_ReadOnly);
+  if (src_ds == NULL) {
+    error("Failed to open source file: %s", src_file);
+  }
+  int n_bands = GDALGetRasterCount(src_ds);
+  if (n_bands < 1) {
+    GDALClose(src_ds);
+    error("Source has no raster bands: %s", src_file);
+  }
+  GDALDataType dtype = GDALGetRasterDataType(GDALGetRasterBand(src_ds, 1));
+
+  int n_tiles = Rf_nrows(windows);
+  int n_cand = Rf_length(candidates);
+  const int *w = INTEGER(windows);
+
+  GDALDatasetH *tiles = (GDALDatasetH *) CPLCalloc(n_tiles > 0 ? n_tiles : 1,
+                                                   sizeof(GDALDatasetH));
+  double raw_bytes = 0;
+  size_t max_px = 0;
+  for (int t = 0; t < n_tiles; t++) {
+    int win[4] = { w[t], w[t + n_tiles], w[t + 2 * n_tiles], w[t + 3 * n_tiles] };
+    tiles[t] = codec_read_tile(src_ds, win, dtype, n_bands);
+    if (tiles[t] == NULL) {
+      for (int k = 0; k < t; k++) GDALClose(tiles[k]);
+      CPLFree(tiles);
+      GDALClose(src_ds);
+      error("Failed to read sample tile %d of %s", t + 1, src_file);
+    }
+    size_t px = (size_t) win[2] * win[3];
+    raw_bytes += (double) px * n_bands * GDALGetDataTypeSizeBytes(dtype);
+    if (px > max_px) max_px = px;
+  }
+  GDALClose(src_ds);
+
+  void *buf = VSIMalloc2(max_px > 0 ? max_px * n_bands : 1,
+                         GDALGetDataTypeSizeBytes(dtype));
+  if (buf == NULL) {
+    for (int t = 0; t < n_tiles; t++) GDALClose(tiles[t]);
+    CPLFree(tiles);
+    error("Failed to allocate decode buffer");
+  }
+
+  SEXP r_bytes = PROTECT(Rf_allocVector(REALSXP, n_cand));
+  SEXP r_encode = PROTECT(Rf_allocVector(REALSXP, n_cand));
+  SEXP r_decode = PROTECT(Rf_allocVector(REALSXP, n_cand));
+  SEXP r_error = PROTECT(Rf_allocVector(STRSXP, n_cand));
+
+  char path[128];
+  snprintf(path, sizeof(path), "/vsimem/rgio_codec_bench_%p.tif", (void *) tiles);
+  CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", "1");
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+
+  for (int c = 0; c < n_cand; c++) {
+    SEXP cand = VECTOR_ELT(candidates, c);
+    char **co = NULL;
+    for (int i = 0; i < Rf_length(cand); i++) {
+      co = CSLAddString(co, CHAR(STRING_ELT(cand, i)));
+    }
+    co = CSLSetNameValue(co, "TILED", "YES");
+
+    double bytes = 0, encode = 0, decode = 0;
+    char message[512] = "";
+    int failed = 0;
+    for (int t = 0; t < n_tiles && !failed; t++) {
+      /* one block per tile; GTiff wants multiples of 16 */
+      char bx[32], by[32];
+      snprintf(bx, sizeof(bx), "%d", (GDALGetRasterXSize(tiles[t]) + 15) / 16 * 16);
+      snprintf(by, sizeof(by), "%d", (GDALGetRasterYSize(tiles[t]) + 15) / 16 * 16);
+      co = CSLSetNameValue(co, "BLOCKXSIZE", bx);
+      co = CSLSetNameValue(co, "BLOCKYSIZE", by);
+      failed = codec_trial(tiles[t], co, path, buf, &bytes, &encode, &decode,
+                           message, sizeof(message));
+    }
+    CSLDestroy(co);
+
+    REAL(r_bytes)[c] = failed ? NA_REAL : bytes;
+    REAL(r_encode)[c] = failed ? NA_REAL : encode;
+    REAL(r_decode)[c] = failed ? NA_REAL : decode;
+    SET_STRING_ELT(r_error, c, failed ? Rf_mkChar(message) : NA_STRING);
+  }
+
+  CPLPopErrorHandler();
+  CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", NULL);
+  VSIFree(buf);
+  for (int t = 0; t < n_tiles; t++) GDALClose(tiles[t]);
+  CPLFree(tiles);
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 5));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 5));
+  SET_VECTOR_ELT(result, 0, Rf_ScalarReal(raw_bytes));
+  SET_STRING_ELT(names, 0, Rf_mkChar("raw_bytes"));
+  SET_VECTOR_ELT(result, 1, r_bytes);
+  SET_STRING_ELT(names, 1, Rf_mkChar("bytes"));
+  SET_VECTOR_ELT(result, 2, r_encode);
+  SET_STRING_ELT(names, 2, Rf_mkChar("encode"));
+  SET_VECTOR_ELT(result, 3, r_decode);
+  SET_STRING_ELT(names, 3, Rf_mkChar("decode"));
+  SET_VECTOR_ELT(result, 4, r_error);
+  SET_STRING_ELT(names, 4, Rf_mkChar("error"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  UNPROTECT(6);
+  return result;
+}
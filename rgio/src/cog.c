@@ -9,7 +9,49 @@
 #include <gdal_utils.h>
 #include <cpl_conv.h>
 #include <cpl_string.h>
+#include <math.h>
 #include <string.h>
+#include <cpl_multiproc.h>
+#include <cpl_vsi.h>
+#include "gdal_utils.h"
+
+/*
+ * gdal_translate argument list shared by _rgio_tr() and _rgio_tr_batch()
+ */
+static char **tr_build_argv(const char *format_str, const char *resample_str,
+                            double nodata_val, SEXP options, SEXP co) {
+  char **translate_argv = NULL;
+
+  if (format_str != NULL && strlen(format_str) > 0) {
+    translate_argv = CSLAddString(translate_argv, "-of");
+    translate_argv = CSLAddString(translate_argv, format_str);
+  }
+
+  if (resample_str != NULL && strlen(resample_str) > 0) {
+    translate_argv = CSLAddString(translate_argv, "-r");
+    translate_argv = CSLAddString(translate_argv, resample_str);
+  }
+
+  if (!CPLIsNan(nodata_val)) {
+    translate_argv = CSLAddString(translate_argv, "-a_nodata");
+    char nodata_buf[64];
+    snprintf(nodata_buf, sizeof(nodata_buf), "%.15g", nodata_val);
+    translate_argv = CSLAddString(translate_argv, nodata_buf);
+  }
+
+  int co_len = length(co);
+  for (int i = 0; i < co_len; i++) {
+    translate_argv = CSLAddString(translate_argv, "-co");
+    translate_argv = CSLAddString(translate_argv, CHAR(STRING_ELT(co, i)));
+  }
+
+  int opt_len = length(options);
+  for (int i = 0; i < opt_len; i++) {
+    translate_argv = CSLAddString(translate_argv, CHAR(STRING_ELT(options, i)));
+  }
+
+  return translate_argv;
+}
 
 /*
  * Entry point for translate function
@@ -56,35 +98,8 @@ SEXP _rgio_tr(SEXP src, SEXP dst, SEXP format,
     CPLSetConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
   }
 
-  char **translate_argv = NULL;
-
-  if (format_str != NULL && strlen(format_str) > 0) {
-    translate_argv = CSLAddString(translate_argv, "-of");
-    translate_argv = CSLAddString(translate_argv, format_str);
-  }
-
-  if (resample_str != NULL && strlen(resample_str) > 0) {
-    translate_argv = CSLAddString(translate_argv, "-r");
-    translate_argv = CSLAddString(translate_argv, resample_str);
-  }
-
-  if (!CPLIsNan(nodata_val)) {
-    translate_argv = CSLAddString(translate_argv, "-a_nodata");
-    char nodata_buf[64];
-    snprintf(nodata_buf, sizeof(nodata_buf), "%.15g", nodata_val);
-    translate_argv = CSLAddString(translate_argv, nodata_buf);
-  }
-
-  int co_len = length(co);
-  for (int i = 0; i < co_len; i++) {
-    translate_argv = CSLAddString(translate_argv, "-co");
-    translate_argv = CSLAddString(translate_argv, CHAR(STRING_ELT(co, i)));
-  }
-
-  int opt_len = length(options);
-  for (int i = 0; i < opt_len; i++) {
-    translate_argv = CSLAddString(translate_argv, CHAR(STRING_ELT(options, i)));
-  }
+  char **translate_argv = tr_build_argv(format_str, resample_str, nodata_val,
+                                        options, co);
 
   GDALTranslateOptions *translate_options = GDALTranslateOptionsNew(translate_argv, NULL);
   CSLDestroy(translate_argv);
@@ -121,3 +136,211 @@ SEXP _rgio_tr(SEXP src, SEXP dst, SEXP format,
 
   return dst;
 }
+
+/* -------------------------------------------------------------------------- */
+/*  Batch translate                                                           */
+/* -------------------------------------------------------------------------- */
+/*
+ * Files are converted by a pool of worker threads, largest first. Each
+ * worker sets GDAL_NUM_THREADS as a thread-local option for the file it
+ * converts, so the process-wide setting is never touched. A file gets a
+ * share of the thread budget proportional to its size among the files
+ * expected to be in flight with it: a single large file uses every thread,
+ * many small files run one thread each.
+ */
+typedef struct {
+  int n_files;
+  char **src;
+  char **dst;
+  double *size;
+  int *order;         /* jobs sorted by decreasing size */
+  char **argv;
+  int budget;         /* total threads */
+  int n_workers;
+  /* results */
+  double *elapsed;
+  int *threads;
+  char **error;
+  /* scheduler state */
+  CPLMutex *mutex;
+  int next;
+  int running;
+  double running_bytes;
+} tr_batch;
+
+typedef struct {
+  double size;
+  int index;
+} tr_job_size;
+
+/* Decreasing size, ties in input order */
+static int tr_cmp_size_desc(const void *a, const void *b) {
+  const tr_job_size *x = (const tr_job_size *) a, *y = (const tr_job_size *) b;
+  if (x->size != y->size) return (x->size < y->size) - (x->size > y->size);
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+/* Called with the mutex held: inner threads for the job about to start */
+static int tr_inner_threads(const tr_batch *b, int job) {
+  int queued = b->n_files - b->next;  /* after this job was taken */
+  int slots = b->n_workers - b->running - 1;
+  if (slots > queued) slots = queued;
+
+  double bytes = b->running_bytes + b->size[job];
+  for (int k = 0; k < slots; k++) bytes += b->size[b->order[b->next + k]];
+
+  int inner = bytes > 0 ? (int) floor(b->budget * b->size[job] / bytes + 0.5) : 1;
+  if (inner < 1) inner = 1;
+  if (inner > b->budget) inner = b->budget;
+  return inner;
+}
+
+static void tr_batch_worker(void *arg) {
+  tr_batch *b = (tr_batch *) arg;
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+
+  for (;;) {
+    CPLAcquireMutex(b->mutex, 1000.0);
+    if (b->next >= b->n_files) {
+      CPLReleaseMutex(b->mutex);
+      break;
+    }
+    int job = b->order[b->next++];
+    int inner = tr_inner_threads(b, job);
+    b->running++;
+    b->running_bytes += b->size[job];
+    CPLReleaseMutex(b->mutex);
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d", inner);
+    CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", buf);
+    CPLErrorReset();
+
+    double t0 = rgio_elapsed_seconds();
+    GDALDatasetH src_ds = GDALOpen(b->src[job], GA_ReadOnly);
+    if (src_ds == NULL) {
+      b->error[job] = CPLStrdup(CPLGetLastErrorMsg()[0] ? CPLGetLastErrorMsg()
+                                                        : "Failed to open source file");
+    } else {
+      GDALTranslateOptions *opts = GDALTranslateOptionsNew(b->argv, NULL);
+      int err_flag = 0;
+      GDALDatasetH out = opts ? GDALTranslate(b->dst[job], src_ds, opts, &err_flag) : NULL;
+      if (out == NULL || err_flag != 0) {
+        b->error[job] = CPLStrdup(CPLGetLastErrorMsg()[0] ? CPLGetLastErrorMsg()
+                                                          : "Translate operation failed");
+      }
+      if (out != NULL) GDALClose(out);
+      if (opts != NULL) GDALTranslateOptionsFree(opts);
+      GDALClose(src_ds);
+    }
+    b->elapsed[job] = rgio_elapsed_seconds() - t0;
+    b->threads[job] = inner;
+    CPLSetThreadLocalConfigOption("GDAL_NUM_THREADS", NULL);
+
+    CPLAcquireMutex(b->mutex, 1000.0);
+    b->running--;
+    b->running_bytes -= b->size[job];
+    CPLReleaseMutex(b->mutex);
+  }
+
+  CPLPopErrorHandler();
+}
+
+/*
+ * Entry point for batch translate
+ *
+ * @param src, dst Source and destination paths (same length)
+ * @param format, resample, nodata, options, co As in _rgio_tr()
+ * @param threads Total thread budget (0 = all CPUs)
+ * @return list(size, threads, elapsed, error) with one element per file
+ */
+SEXP _rgio_tr_batch(SEXP src, SEXP dst, SEXP format,
+                    SEXP resample, SEXP nodata, SEXP options,
+                    SEXP co, SEXP threads) {
+
+  GDALAllRegister();
+
+  int n = Rf_length(src);
+  tr_batch b;
+  memset(&b, 0, sizeof(b));
+  b.n_files = n;
+  b.budget = rgio_resolve_threads(INTEGER(threads)[0], 1 << 16);
+  b.n_workers = b.budget < n ? b.budget : n;
+  if (b.n_workers < 1) b.n_workers = 1;
+  b.argv = tr_build_argv(CHAR(STRING_ELT(format, 0)), CHAR(STRING_ELT(resample, 0)),
+                         REAL(nodata)[0], options, co);
+
+  int n_alloc = n > 0 ? n : 1;
+  b.src = (char **) CPLCalloc(n_alloc, sizeof(char *));
+  b.dst = (char **) CPLCalloc(n_alloc, sizeof(char *));
+  b.size = (double *) CPLCalloc(n_alloc, sizeof(double));
+  b.order = (int *) CPLMalloc(n_alloc * sizeof(int));
+  b.elapsed = (double *) CPLCalloc(n_alloc, sizeof(double));
+  b.threads = (int *) CPLCalloc(n_alloc, sizeof(int));
+  b.error = (char **) CPLCalloc(n_alloc, sizeof(char *));
+
+  tr_job_size *by_size = (tr_job_size *) CPLMalloc(n_alloc * sizeof(tr_job_size));
+  for (int i = 0; i < n; i++) {
+    VSIStatBufL st;
+    b.src[i] = CPLStrdup(CHAR(STRING_ELT(src, i)));
+    b.dst[i] = CPLStrdup(CHAR(STRING_ELT(dst, i)));
+    b.size[i] = VSIStatL(b.src[i], &st) == 0 ? (double) st.st_size : 0.0;
+    by_size[i].size = b.size[i];
+    by_size[i].index = i;
+  }
+  qsort(by_size, n, sizeof(tr_job_size), tr_cmp_size_desc);
+  for (int i = 0; i < n; i++) b.order[i] = by_size[i].index;
+  CPLFree(by_size);
+
+  b.mutex = CPLCreateMutex();
+  CPLReleaseMutex(b.mutex);
+
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(b.n_workers, sizeof(CPLJoinableThread *));
+  for (int i = 1; i < b.n_workers; i++) {
+    workers[i] = CPLCreateJoinableThread(tr_batch_worker, &b);
+  }
+  tr_batch_worker(&b);  /* the calling thread converts files too */
+  for (int i = 1; i < b.n_workers; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLDestroyMutex(b.mutex);
+  CSLDestroy(b.argv);
+
+  SEXP r_size = PROTECT(Rf_allocVector(REALSXP, n));
+  SEXP r_threads = PROTECT(Rf_allocVector(INTSXP, n));
+  SEXP r_elapsed = PROTECT(Rf_allocVector(REALSXP, n));
+  SEXP r_error = PROTECT(Rf_allocVector(STRSXP, n));
+  for (int i = 0; i < n; i++) {
+    REAL(r_size)[i] = b.size[i];
+    INTEGER(r_threads)[i] = b.threads[i];
+    REAL(r_elapsed)[i] = b.elapsed[i];
+    SET_STRING_ELT(r_error, i, b.error[i] ? Rf_mkChar(b.error[i]) : NA_STRING);
+    CPLFree(b.error[i]);
+    CPLFree(b.src[i]);
+    CPLFree(b.dst[i]);
+  }
+  CPLFree(b.src);
+  CPLFree(b.dst);
+  CPLFree(b.size);
+  CPLFree(b.order);
+  CPLFree(b.elapsed);
+  CPLFree(b.threads);
+  CPLFree(b.error);
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 4));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 4));
+  SET_VECTOR_ELT(result, 0, r_size);
+  SET_STRING_ELT(names, 0, Rf_mkChar("size"));
+  SET_VECTOR_ELT(result, 1, r_threads);
+  SET_STRING_ELT(names, 1, Rf_mkChar("threads"));
+  SET_VECTOR_ELT(result, 2, r_elapsed);
+  SET_STRING_ELT(names, 2, Rf_mkChar("elapsed"));
+  SET_VECTOR_ELT(result, 3, r_error);
+  SET_STRING_ELT(names, 3, Rf_mkChar("error"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  UNPROTECT(6);
+  return result;
+}
@@ -0,0 +1,468 @@
+/*
+ * cog_check.c
+ * Cloud Optimized GeoTIFF layout validation from TIFF header bytes
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <stdint.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/*
+ * Bytes a /vsicurl/ client fetches when opening a file (GDAL's default
+ * GDAL_INGESTED_BYTES_AT_OPEN); structures beyond it cost extra requests.
+ */
+#define CC_INITIAL_FETCH 16384
+#define CC_MAX_IFDS 1024
+
+/* TIFF tags used by the checks */
+#define TAG_SUBFILE_TYPE      254
+#define TAG_IMAGE_WIDTH       256
+#define TAG_IMAGE_LENGTH      257
+#define TAG_COMPRESSION       259
+#define TAG_STRIP_OFFSETS     273
+#define TAG_ROWS_PER_STRIP    278
+#define TAG_STRIP_BYTE_COUNTS 279
+#define TAG_TILE_WIDTH        322
+#define TAG_TILE_LENGTH       323
+#define TAG_TILE_OFFSETS      324
+#define TAG_TILE_BYTE_COUNTS  325
+
+/* -------------------------------------------------------------------------- */
+/*  Tag entries                                                               */
+/* -------------------------------------------------------------------------- */
+
+static int cc_type_size(int type) {
+  switch (type) {
+  case 1: case 2: case 6: case 7: return 1;
+  case 3: case 8: return 2;
+  case 4: case 9: case 11: case 13: return 4;
+  case 5: case 10: case 12: case 16: case 17: case 18: return 8;
+  default: return 0;
+  }
+}
+
+typedef struct {
+  int type;
+  uint64_t count;
+  unsigned char value[8];   /* inline value or offset, file byte order */
+} cc_entry;
+
+/* Offset of the entry's out-of-line data, or 0 when stored inline */
+static uint64_t cc_entry_offset(const rgio_tiff *rd, const cc_entry *e) {
+  uint64_t bytes = e->count * (uint64_t) cc_type_size(e->type);
+  if (bytes <= (uint64_t) (rd->big ? 8 : 4)) return 0;
+  return rgio_tiff_get(rd, e->value, rd->big ? 8 : 4);
+}
+
+static uint64_t cc_entry_end(const rgio_tiff *rd, const cc_entry *e) {
+  uint64_t off = cc_entry_offset(rd, e);
+  return off ? off + e->count * (uint64_t) cc_type_size(e->type) : 0;
+}
+
+/* First value of an integer entry */
+static uint64_t cc_entry_scalar(rgio_tiff *rd, const cc_entry *e) {
+  int size = cc_type_size(e->type);
+  if (size == 0 || size > 8 || e->count == 0) return 0;
+  uint64_t off = cc_entry_offset(rd, e);
+  if (off == 0) return rgio_tiff_get(rd, e->value, size);
+  unsigned char buf[8];
+  return rgio_tiff_read(rd, off, buf, size) ? rgio_tiff_get(rd, buf, size) : 0;
+}
+
+/*
+ * Scan an integer array entry (block offsets or byte counts) in chunks,
+ * returning min, max and sum of its non-zero values.
+ */
+static int cc_entry_scan(rgio_tiff *rd, const cc_entry *e, uint64_t *vmin,
+                         uint64_t *vmax, double *sum) {
+  int size = cc_type_size(e->type);
+  *vmin = UINT64_MAX;
+  *vmax = 0;
+  *sum = 0;
+  if (size == 0 || e->count == 0) return 0;
+
+  uint64_t off = cc_entry_offset(rd, e);
+  unsigned char chunk[8192];
+  uint64_t per_chunk = sizeof(chunk) / size;
+  for (uint64_t i = 0; i < e->count; i += per_chunk) {
+    uint64_t n = e->count - i < per_chunk ? e->count - i : per_chunk;
+    const unsigned char *p;
+    if (off == 0) {
+      p = e->value;
+    } else {
+      if (!rgio_tiff_read(rd, off + i * size, chunk, (size_t) (n * size))) return 0;
+      p = chunk;
+    }
+    for (uint64_t k = 0; k < n; k++) {
+      uint64_t v = rgio_tiff_get(rd, p + k * size, size);
+      if (v == 0) continue;
+      if (v < *vmin) *vmin = v;
+      if (v > *vmax) *vmax = v;
+      *sum += (double) v;
+    }
+  }
+  return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  IFD summary                                                               */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  uint64_t offset;        /* IFD position */
+  uint64_t struct_end;    /* end of the IFD entry table */
+  uint64_t arrays_end;    /* end of out-of-line tag data (0 if none) */
+  uint64_t index_end;     /* end of the block offset/count arrays */
+  uint64_t subfile;
+  int width, height;
+  int tiled;
+  int block_w, block_h;
+  int compression;
+  uint64_t n_blocks;
+  uint64_t data_min;      /* first block data offset */
+  uint64_t data_max;      /* last block data offset */
+  double data_bytes;      /* sum of block byte counts */
+} cc_ifd;
+
+static const char *cc_compression_name(int code) {
+  switch (code) {
+  case 1: return "NONE";
+  case 5: return "LZW";
+  case 6: case 7: return "JPEG";
+  case 8: case 32946: return "DEFLATE";
+  case 32773: return "PACKBITS";
+  case 34887: return "LERC";
+  case 34925: return "LZMA";
+  case 50000: return "ZSTD";
+  case 50001: return "WEBP";
+  case 50002: return "JXL";
+  default: return "UNKNOWN";
+  }
+}
+
+/* Parse the IFD at `off`, returning its successor's offset in `next` */
+static int cc_parse_ifd(rgio_tiff *rd, uint64_t off, cc_ifd *ifd, uint64_t *next) {
+  int count_size = rd->big ? 8 : 2;
+  int entry_size = rd->big ? 20 : 12;
+  int offset_size = rd->big ? 8 : 4;
+  unsigned char buf[20];
+
+  memset(ifd, 0, sizeof(*ifd));
+  ifd->offset = off;
+  if (!rgio_tiff_read(rd, off, buf, count_size)) return 0;
+  uint64_t n_entries = rgio_tiff_get(rd, buf, count_size);
+  if (n_entries == 0 || n_entries > 4096) return 0;
+
+  size_t table_bytes = (size_t) n_entries * entry_size;
+  unsigned char *table = (unsigned char *) CPLMalloc(table_bytes + offset_size);
+  if (!rgio_tiff_read(rd, off + count_size, table, table_bytes + offset_size)) {
+    CPLFree(table);
+    return 0;
+  }
+  ifd->struct_end = off + count_size + table_bytes + offset_size;
+  *next = rgio_tiff_get(rd, table + table_bytes, offset_size);
+
+  cc_entry offsets = {0}, counts = {0};
+  int rows_per_strip = 0;
+  for (uint64_t i = 0; i < n_entries; i++) {
+    const unsigned char *p = table + i * entry_size;
+    int tag = (int) rgio_tiff_get(rd, p, 2);
+    cc_entry e;
+    e.type = (int) rgio_tiff_get(rd, p + 2, 2);
+    e.count = rgio_tiff_get(rd, p + 4, rd->big ? 8 : 4);
+    memcpy(e.value, p + (rd->big ? 12 : 8), offset_size);
+
+    uint64_t end = cc_entry_end(rd, &e);
+    switch (tag) {
+    case TAG_SUBFILE_TYPE:  ifd->subfile = cc_entry_scalar(rd, &e); break;
+    case TAG_IMAGE_WIDTH:   ifd->width = (int) cc_entry_scalar(rd, &e); break;
+    case TAG_IMAGE_LENGTH:  ifd->height = (int) cc_entry_scalar(rd, &e); break;
+    case TAG_COMPRESSION:   ifd->compression = (int) cc_entry_scalar(rd, &e); break;
+    case TAG_ROWS_PER_STRIP: rows_per_strip = (int) cc_entry_scalar(rd, &e); break;
+    case TAG_TILE_WIDTH:    ifd->tiled = 1; ifd->block_w = (int) cc_entry_scalar(rd, &e); break;
+    case TAG_TILE_LENGTH:   ifd->block_h = (int) cc_entry_scalar(rd, &e); break;
+    case TAG_TILE_OFFSETS:
+    case TAG_STRIP_OFFSETS: offsets = e; break;
+    case TAG_TILE_BYTE_COUNTS:
+    case TAG_STRIP_BYTE_COUNTS: counts = e; break;
+    default: break;
+    }
+    if (tag == TAG_TILE_OFFSETS || tag == TAG_STRIP_OFFSETS ||
+        tag == TAG_TILE_BYTE_COUNTS || tag == TAG_STRIP_BYTE_COUNTS) {
+      if (end > ifd->index_end) ifd->index_end = end;
+    } else if (end > ifd->arrays_end) {
+      ifd->arrays_end = end;
+    }
+  }
+  CPLFree(table);
+
+  if (!ifd->tiled) {
+    ifd->block_w = ifd->width;
+    ifd->block_h = rows_per_strip > 0 && rows_per_strip < ifd->height
+      ? rows_per_strip : ifd->height;
+  }
+  if (ifd->compression == 0) ifd->compression = 1;
+  ifd->n_blocks = offsets.count;
+
+  uint64_t cmin, cmax;
+  double offset_sum;
+  if (!cc_entry_scan(rd, &offsets, &ifd->data_min, &ifd->data_max, &offset_sum) ||
+      !cc_entry_scan(rd, &counts, &cmin, &cmax, &ifd->data_bytes)) {
+    return 0;
+  }
+  return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_cog_check                                                           */
+/* -------------------------------------------------------------------------- */
+/*
+ * Validate the COG layout of a GeoTIFF by reading only its header: the
+ * ghost header, the IFD chain and the block offset/byte count arrays. No
+ * image data is read, so remote files (/vsicurl/, /vsis3/) cost a few range
+ * requests.
+ *
+ * Per level, the cost of reading one block from a cold /vsicurl/ client is
+ * estimated as the initial CC_INITIAL_FETCH bytes (plus one request if the
+ * IFDs extend past it), one request for the block index when it lies
+ * beyond the bytes already fetched, and one request for the block itself.
+ *
+ * @param path File path (any GDAL virtual file system path)
+ * @return list(bigtiff, ghost_header, header_bytes, file_bytes, errors,
+ *         warnings, levels) where levels is a list of per-IFD vectors
+ *         (mask IFDs excluded)
+ */
+SEXP _rgio_cog_check(SEXP path) {
+  const char *file = CHAR(STRING_ELT(path, 0));
+
+  VSIStatBufL st;
+  int stat_ok = VSIStatL(file, &st) == 0;
+  double file_bytes = stat_ok ? (double) st.st_size : NA_REAL;
+
+  rgio_tiff rd;
+  if (!rgio_tiff_open(&rd, file)) {
+    if (!stat_ok) error("Failed to open file: %s", file);
+    error("Not a TIFF file: %s", file);
+  }
+  uint64_t first_ifd = rd.first_ifd;
+  int header_size = rd.header_size;
+
+  /* Ghost header: GDAL_STRUCTURAL_METADATA_SIZE=XXXXXX bytes\n<options> */
+  char *ghost = NULL;
+  {
+    char buf[64];
+    const char *key = "GDAL_STRUCTURAL_METADATA_SIZE=";
+    size_t key_len = strlen(key);
+    if (first_ifd > (uint64_t) header_size + key_len &&
+        rgio_tiff_read(&rd, header_size, buf, key_len + 6) &&
+        strncmp(buf, key, key_len) == 0) {
+      buf[key_len + 6] = '\0';
+      int size = atoi(buf + key_len);
+      uint64_t start = header_size + key_len + 6 + strlen(" bytes\n");
+      if (size > 0 && size < 65536) {
+        ghost = (char *) CPLCalloc(size + 1, 1);
+        if (!rgio_tiff_read(&rd, start, ghost, size)) {
+          CPLFree(ghost);
+          ghost = NULL;
+        }
+      }
+    }
+  }
+
+  /* IFD chain */
+  cc_ifd *ifds = (cc_ifd *) CPLCalloc(CC_MAX_IFDS, sizeof(cc_ifd));
+  int n_ifds = 0;
+  int chain_ok = 1;
+  uint64_t off = first_ifd;
+  while (off != 0 && n_ifds < CC_MAX_IFDS) {
+    for (int i = 0; i < n_ifds; i++) {
+      if (ifds[i].offset == off) off = 0;   /* loop in the chain */
+    }
+    if (off == 0) break;
+    uint64_t next = 0;
+    if (!cc_parse_ifd(&rd, off, &ifds[n_ifds], &next)) {
+      chain_ok = 0;
+      break;
+    }
+    n_ifds++;
+    off = next;
+  }
+  rgio_tiff_close(&rd);
+
+  if (n_ifds == 0) {
+    CPLFree(ifds);
+    CPLFree(ghost);
+    error("Failed to read the first IFD of %s", file);
+  }
+
+  char **errors = NULL;
+  char **warnings = NULL;
+  if (!chain_ok) {
+    errors = CSLAddString(errors, "IFD chain is truncated or corrupt");
+  }
+
+  /* Header extent and first image byte */
+  uint64_t ifds_end = 0, header_end = 0, data_start = UINT64_MAX;
+  for (int i = 0; i < n_ifds; i++) {
+    cc_ifd *d = &ifds[i];
+    uint64_t end = d->struct_end;
+    if (d->arrays_end > end) end = d->arrays_end;
+    if (end > ifds_end) ifds_end = end;
+    if (d->index_end > end) end = d->index_end;
+    if (end > header_end) header_end = end;
+    if (d->data_min > 0 && d->data_min < data_start) data_start = d->data_min;
+  }
+
+  const cc_ifd *main_ifd = &ifds[0];
+  if (!main_ifd->tiled) {
+    errors = CSLAddString(errors, "Main image is not tiled");
+  } else {
+    int bw = main_ifd->block_w, bh = main_ifd->block_h;
+    if (bw < 128 || bh < 128 || bw > 2048 || bh > 2048) {
+      warnings = CSLAddString(warnings, CPLSPrintf(
+        "Tile size %dx%d is outside the usual 128-2048 range", bw, bh));
+    }
+  }
+  if (data_start != UINT64_MAX && header_end > data_start) {
+    errors = CSLAddString(errors, "IFDs and block indices are not all located before image data");
+  }
+  for (int i = 1; i < n_ifds; i++) {
+    if (ifds[i].offset < ifds[i - 1].offset) {
+      errors = CSLAddString(errors, "IFDs are not stored in increasing file order");
+      break;
+    }
+  }
+
+  /* Overviews: reduced resolution IFDs, decreasing in size, with data in
+   * the reverse order (smallest overview first, full resolution last) */
+  int n_levels = 0;
+  int prev = -1;
+  for (int i = 0; i < n_ifds; i++) {
+    cc_ifd *d = &ifds[i];
+    if (d->subfile & 4) continue;   /* mask */
+    if (prev >= 0) {
+      const cc_ifd *p = &ifds[prev];
+      if (!(d->subfile & 1)) {
+        warnings = CSLAddString(warnings, CPLSPrintf(
+          "IFD %d is a full resolution image, not an overview", i));
+      }
+      if (d->width >= p->width || d->height >= p->height) {
+        errors = CSLAddString(errors, CPLSPrintf(
+          "Overview IFD %d is not smaller than the level before it", i));
+      }
+      if (!d->tiled) {
+        errors = CSLAddString(errors, CPLSPrintf("Overview IFD %d is not tiled", i));
+      }
+      /* Levels without data blocks (sparse files) have no data position */
+      if (d->data_min != UINT64_MAX && p->data_min != UINT64_MAX &&
+          d->data_min > p->data_min) {
+        errors = CSLAddString(errors, CPLSPrintf(
+          "Image data of overview IFD %d is stored after the level before it", i));
+      }
+    }
+    prev = i;
+    n_levels++;
+  }
+  if (n_levels == 1 && (main_ifd->width > 512 || main_ifd->height > 512)) {
+    warnings = CSLAddString(warnings, "No overviews for an image larger than 512 pixels");
+  }
+  if (main_ifd->compression == 1) {
+    warnings = CSLAddString(warnings, "Image data is not compressed");
+  }
+  if (ghost == NULL) {
+    warnings = CSLAddString(warnings, "No GDAL ghost header; block layout cannot be trusted");
+  } else if (strstr(ghost, "KNOWN_INCOMPATIBLE_EDITION=YES") != NULL) {
+    errors = CSLAddString(errors, "File was modified after creation (KNOWN_INCOMPATIBLE_EDITION=YES)");
+  }
+
+  /* Per level report */
+  SEXP r_level = PROTECT(Rf_allocVector(INTSXP, n_levels));
+  SEXP r_width = PROTECT(Rf_allocVector(INTSXP, n_levels));
+  SEXP r_height = PROTECT(Rf_allocVector(INTSXP, n_levels));
+  SEXP r_tiled = PROTECT(Rf_allocVector(LGLSXP, n_levels));
+  SEXP r_bw = PROTECT(Rf_allocVector(INTSXP, n_levels));
+  SEXP r_bh = PROTECT(Rf_allocVector(INTSXP, n_levels));
+  SEXP r_blocks = PROTECT(Rf_allocVector(REALSXP, n_levels));
+  SEXP r_comp = PROTECT(Rf_allocVector(STRSXP, n_levels));
+  SEXP r_mean = PROTECT(Rf_allocVector(REALSXP, n_levels));
+  SEXP r_requests = PROTECT(Rf_allocVector(INTSXP, n_levels));
+  SEXP r_bytes = PROTECT(Rf_allocVector(REALSXP, n_levels));
+
+  uint64_t fetched = ifds_end > CC_INITIAL_FETCH ? ifds_end : CC_INITIAL_FETCH;
+  int open_requests = ifds_end > CC_INITIAL_FETCH ? 2 : 1;
+  int k = 0;
+  for (int i = 0; i < n_ifds; i++) {
+    cc_ifd *d = &ifds[i];
+    if (d->subfile & 4) continue;
+    double mean = d->n_blocks > 0 ? d->data_bytes / (double) d->n_blocks : 0;
+    int requests = open_requests + 1;
+    double bytes = (double) fetched + mean;
+    if (d->index_end > fetched) {
+      requests++;
+      bytes += CC_INITIAL_FETCH;
+    }
+    INTEGER(r_level)[k] = k;
+    INTEGER(r_width)[k] = d->width;
+    INTEGER(r_height)[k] = d->height;
+    LOGICAL(r_tiled)[k] = d->tiled;
+    INTEGER(r_bw)[k] = d->block_w;
+    INTEGER(r_bh)[k] = d->block_h;
+    REAL(r_blocks)[k] = (double) d->n_blocks;
+    SET_STRING_ELT(r_comp, k, Rf_mkChar(cc_compression_name(d->compression)));
+    REAL(r_mean)[k] = mean;
+    INTEGER(r_requests)[k] = requests;
+    REAL(r_bytes)[k] = R_FINITE(file_bytes) && bytes > file_bytes ? file_bytes : bytes;
+    k++;
+  }
+
+  const char *level_names[] = { "level", "width", "height", "tiled", "block_width",
+                                "block_height", "blocks", "compression",
+                                "mean_block_bytes", "requests", "bytes" };
+  SEXP levels = PROTECT(Rf_allocVector(VECSXP, 11));
+  SEXP level_nm = PROTECT(Rf_allocVector(STRSXP, 11));
+  SEXP cols[] = { r_level, r_width, r_height, r_tiled, r_bw, r_bh, r_blocks,
+                  r_comp, r_mean, r_requests, r_bytes };
+  for (int i = 0; i < 11; i++) {
+    SET_VECTOR_ELT(levels, i, cols[i]);
+    SET_STRING_ELT(level_nm, i, Rf_mkChar(level_names[i]));
+  }
+  Rf_setAttrib(levels, R_NamesSymbol, level_nm);
+
+  int n_err = CSLCount((CSLConstList) errors);
+  int n_warn = CSLCount((CSLConstList) warnings);
+  SEXP r_errors = PROTECT(Rf_allocVector(STRSXP, n_err));
+  for (int i = 0; i < n_err; i++) SET_STRING_ELT(r_errors, i, Rf_mkChar(errors[i]));
+  SEXP r_warnings = PROTECT(Rf_allocVector(STRSXP, n_warn));
+  for (int i = 0; i < n_warn; i++) SET_STRING_ELT(r_warnings, i, Rf_mkChar(warnings[i]));
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 7));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 7));
+  SET_VECTOR_ELT(result, 0, Rf_ScalarLogical(rd.big));
+  SET_STRING_ELT(names, 0, Rf_mkChar("bigtiff"));
+  SET_VECTOR_ELT(result, 1, ghost ? Rf_mkString(ghost) : Rf_ScalarString(NA_STRING));
+  SET_STRING_ELT(names, 1, Rf_mkChar("ghost_header"));
+  SET_VECTOR_ELT(result, 2, Rf_ScalarReal((double) header_end));
+  SET_STRING_ELT(names, 2, Rf_mkChar("header_bytes"));
+  SET_VECTOR_ELT(result, 3, Rf_ScalarReal(file_bytes));
+  SET_STRING_ELT(names, 3, Rf_mkChar("file_bytes"));
+  SET_VECTOR_ELT(result, 4, r_errors);
+  SET_STRING_ELT(names, 4, Rf_mkChar("errors"));
+  SET_VECTOR_ELT(result, 5, r_warnings);
+  SET_STRING_ELT(names, 5, Rf_mkChar("warnings"));
+  SET_VECTOR_ELT(result, 6, levels);
+  SET_STRING_ELT(names, 6, Rf_mkChar("levels"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  CSLDestroy(errors);
+  CSLDestroy(warnings);
+  CPLFree(ghost);
+  CPLFree(ifds);
+
+  UNPROTECT(17);
+  return result;
+}
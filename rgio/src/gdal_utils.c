@@ -9,8 +9,15 @@
 #include <cpl_string.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
 #include "gdal_utils.h"
 
+/* Share of usable RAM a CreateCopy-only output may be staged in (MEM) */
+#define RGIO_STAGE_MEM_FRACTION 0.25
+
 /*
  * Initialize GDAL - call once at package load (R_init_rgio)
  */
@@ -18,6 +25,7 @@ void rgio_gdal_init(void) {
   GDALAllRegister();
   CPLSetConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
   CPLSetConfigOption("GDAL_CACHEMAX", "256"); /* MB */
+  rgio_register_pixel_functions();
 }
 
 /*
@@ -27,6 +35,53 @@ void rgio_gdal_cleanup(void) {
   GDALDestroyDriverManager();
 }
 
+/* -------------------------------------------------------------------------- */
+/*  rgio_elapsed_seconds()                                                    */
+/* -------------------------------------------------------------------------- */
+/*
+ * Monotonic wall-clock time in seconds, for timing phases of an operation.
+ * Only differences between two calls are meaningful.
+ */
+double rgio_elapsed_seconds(void) {
+#ifdef _WIN32
+  LARGE_INTEGER freq, count;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+  return (double) count.QuadPart / (double) freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_resolve_threads()                                                    */
+/* -------------------------------------------------------------------------- */
+/*
+ * Number of worker threads for `n_tasks` independent tasks: `requested`
+ * (0 = all CPUs), never more than there are tasks and at least one.
+ */
+int rgio_resolve_threads(int requested, int n_tasks) {
+  int n = requested > 0 ? requested : CPLGetNumCPUs();
+  if (n > n_tasks) n = n_tasks;
+  if (n < 1) n = 1;
+  return n;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_mem_vector_driver()                                                  */
+/* -------------------------------------------------------------------------- */
+/*
+ * In-memory vector driver: "Memory", or "MEM" from GDAL 3.11 on, where the
+ * two were merged.
+ */
+GDALDriverH rgio_mem_vector_driver(void) {
+  GDALDriverH drv = GDALGetDriverByName("Memory");
+  if (drv == NULL) drv = GDALGetDriverByName("MEM");
+  return drv;
+}
+
 /* -------------------------------------------------------------------------- */
 /*  dtype_from_string()                                                       */
 /* -------------------------------------------------------------------------- */
@@ -153,3 +208,153 @@ GDALDatasetH create_raster_dataset(const char *path,
   return ds;
 }
 
+/* -------------------------------------------------------------------------- */
+/*  rgio_output_create() / rgio_output_finish()                               */
+/* -------------------------------------------------------------------------- */
+/*
+ * Open an output raster to be filled block by block with GDALRasterIO().
+ *
+ * Drivers with Create() (e.g. "GTiff") are written in place through
+ * create_raster_dataset(). Drivers that only implement CreateCopy() (e.g.
+ * "COG") are staged in a MEM dataset when the raster fits in
+ * RGIO_STAGE_MEM_FRACTION of usable RAM (`mem_bytes` then reports its
+ * size), or else in a tiled, uncompressed GTiff next to `path`;
+ * rgio_output_finish() copies the stage to the final driver (building
+ * overviews there) and deletes it. TILED= options are dropped for those
+ * drivers.
+ *
+ * `gt` is the geotransform of the output grid and `crs` any CRS string
+ * accepted by create_raster_dataset() (WKT included).
+ *
+ * Returns 1 on success; on failure the CPL error is set and `out` is empty.
+ */
+int rgio_output_create(rgio_output *out, const char *path, const char *format,
+                       const char *dtype_str, const double *gt,
+                       int width, int height, const char *crs,
+                       int n_bands, char **co) {
+  memset(out, 0, sizeof(*out));
+  out->driver = GDALGetDriverByName(format);
+  if (out->driver == NULL) {
+    CPLError(CE_Failure, CPLE_AppDefined, "Driver not found: %s", format);
+    return 0;
+  }
+  out->path = CPLStrdup(path);
+  out->staged = GDALGetMetadataItem(out->driver, GDAL_DCAP_CREATE, NULL) == NULL &&
+                GDALGetMetadataItem(out->driver, GDAL_DCAP_CREATECOPY, NULL) != NULL;
+
+  double bbox[4] = {
+    gt[0], gt[3] + height * gt[5], gt[0] + width * gt[1], gt[3]
+  };
+  if (out->staged) {
+    for (int i = 0; co != NULL && co[i] != NULL; i++) {
+      if (!EQUALN(co[i], "TILED=", 6)) out->co = CSLAddString(out->co, co[i]);
+    }
+  }
+  double n_bytes = (double) width * height * n_bands *
+                   GDALGetDataTypeSizeBytes(ftype_from_string(dtype_str));
+  GIntBig ram = CPLGetUsablePhysicalRAM();
+  if (out->staged && ram > 0 && n_bytes <= (double) ram * RGIO_STAGE_MEM_FRACTION) {
+    out->mem_bytes = n_bytes;
+    out->ds = create_raster_dataset("", "MEM", dtype_str, bbox,
+                                    width, height, 0.0, 0.0, crs, n_bands, NULL);
+  } else if (out->staged) {
+    out->stage = CPLStrdup(CPLSPrintf("%s.rgio_stage.tif", path));
+    char **stage_co = NULL;
+    stage_co = CSLAddString(stage_co, "TILED=YES");
+    stage_co = CSLAddString(stage_co, "BIGTIFF=IF_SAFER");
+    out->ds = create_raster_dataset(out->stage, "GTiff", dtype_str, bbox,
+                                    width, height, 0.0, 0.0, crs, n_bands, stage_co);
+    CSLDestroy(stage_co);
+  } else {
+    out->ds = create_raster_dataset(path, format, dtype_str, bbox,
+                                    width, height, 0.0, 0.0, crs, n_bands, co);
+  }
+  if (out->ds == NULL) {
+    rgio_output_finish(out, 0);
+    return 0;
+  }
+  GDALSetGeoTransform(out->ds, (double *) gt);
+  return 1;
+}
+
+/*
+ * Close the output. With `ok` set, a staged output is copied to its final
+ * driver; otherwise (or if the copy fails) the partial output is deleted.
+ * Returns 1 on success.
+ */
+int rgio_output_finish(rgio_output *out, int ok) {
+  if (out->staged && out->ds != NULL && ok) {
+    GDALDatasetH final_ds = GDALCreateCopy(out->driver, out->path, out->ds,
+                                           FALSE, out->co, NULL, NULL);
+    if (final_ds != NULL) GDALClose(final_ds);
+    else ok = 0;
+  }
+  if (out->ds != NULL) {
+    GDALClose(out->ds);
+    if (out->staged) {
+      if (out->stage != NULL) GDALDeleteDataset(GDALGetDriverByName("GTiff"), out->stage);
+      if (!ok) VSIUnlink(out->path);
+    } else if (!ok) {
+      GDALDeleteDataset(out->driver, out->path);
+    }
+  }
+  CPLFree(out->stage);
+  CPLFree(out->path);
+  CSLDestroy(out->co);
+  memset(out, 0, sizeof(*out));
+  return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_tiff_open()                                                          */
+/* -------------------------------------------------------------------------- */
+/*
+ * Open a (Big)TIFF file and parse its header: byte order, BigTIFF flag and
+ * first IFD offset. Returns 1 with `tf->fp` open (close it with
+ * rgio_tiff_close()), or 0 when the file cannot be opened or is not a TIFF.
+ */
+int rgio_tiff_open(rgio_tiff *tf, const char *path) {
+  memset(tf, 0, sizeof(*tf));
+  tf->fp = VSIFOpenL(path, "rb");
+  if (tf->fp == NULL) return 0;
+
+  unsigned char hdr[16];
+  if (rgio_tiff_read(tf, 0, hdr, 8) &&
+      ((hdr[0] == 'I' && hdr[1] == 'I') || (hdr[0] == 'M' && hdr[1] == 'M'))) {
+    tf->little = hdr[0] == 'I';
+    int version = (int) rgio_tiff_get(tf, hdr + 2, 2);
+    if (version == 42) {
+      tf->header_size = 8;
+      tf->first_ifd = rgio_tiff_get(tf, hdr + 4, 4);
+      return 1;
+    }
+    if (version == 43 && rgio_tiff_read(tf, 8, hdr + 8, 8)) {
+      tf->big = 1;
+      tf->header_size = 16;
+      tf->first_ifd = rgio_tiff_get(tf, hdr + 8, 8);
+      return 1;
+    }
+  }
+  rgio_tiff_close(tf);
+  return 0;
+}
+
+void rgio_tiff_close(rgio_tiff *tf) {
+  if (tf->fp != NULL) VSIFCloseL(tf->fp);
+  tf->fp = NULL;
+}
+
+int rgio_tiff_read(rgio_tiff *tf, uint64_t off, void *buf, size_t n) {
+  if (VSIFSeekL(tf->fp, (vsi_l_offset) off, SEEK_SET) != 0) return 0;
+  return VSIFReadL(buf, 1, n, tf->fp) == n;
+}
+
+/* Integer of `size` bytes in the file's byte order, independent of the host */
+uint64_t rgio_tiff_get(const rgio_tiff *tf, const unsigned char *p, int size) {
+  uint64_t v = 0;
+  for (int i = 0; i < size; i++) {
+    int k = tf->little ? size - 1 - i : i;
+    v = (v << 8) | p[k];
+  }
+  return v;
+}
@@ -1,6 +1,11 @@
 #ifndef RGIO_GDAL_UTILS_H
 #define RGIO_GDAL_UTILS_H
 #include <gdal.h>
+#include <cpl_vsi.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
 GDALDataType ftype_from_string(const char *dtype);
 GDALDatasetH create_raster_dataset(const char *path,
                                    const char *format,
@@ -11,6 +16,62 @@ GDALDatasetH create_raster_dataset(const char *path,
                                    const char *crs,
                                    int n_bands,
                                    char **co);
+
+/* Output written block by block; see rgio_output_create() */
+typedef struct {
+  GDALDatasetH ds;         /* dataset to write blocks to */
+  GDALDriverH driver;      /* final driver */
+  char *path;              /* final path */
+  char *stage;             /* staging GTiff for CreateCopy-only drivers */
+  char **co;               /* final creation options */
+  int staged;              /* 1 when `ds` is copied to `driver` on finish */
+  double mem_bytes;        /* raster bytes staged in MEM instead of on disk */
+} rgio_output;
+int rgio_output_create(rgio_output *out, const char *path, const char *format,
+                       const char *dtype_str, const double *gt,
+                       int width, int height, const char *crs,
+                       int n_bands, char **co);
+int rgio_output_finish(rgio_output *out, int ok);
+double rgio_elapsed_seconds(void);
+int rgio_resolve_threads(int requested, int n_tasks);
+GDALDriverH rgio_mem_vector_driver(void);
+int rgio_register_pixel_functions(void);
+
+/* Source metadata for VRT mosaics; see rgio_vrt_meta() */
+typedef struct {
+  char *path;
+  GIntBig size, mtime;     /* from VSIStatL(), -1 if unknown */
+  int width, height, n_bands;
+  double gt[6];
+  char *wkt;
+  GDALDataType *types;
+  int *has_nodata;
+  double *nodata;
+  int *block_x, *block_y;
+} rgio_src_meta;
+int rgio_vrt_meta(char **paths, int n, const char *cache_path, int check,
+                  int threads, rgio_src_meta *meta, int *n_opened,
+                  char *msg, size_t msg_len);
+void rgio_src_meta_free(rgio_src_meta *meta);
+int rgio_write_tile_index(const char *index_path, const char *gti_path,
+                          const rgio_src_meta *meta, int n, const double *bbox,
+                          int width, int height, const char *target_wkt,
+                          const char *resample, char *msg, size_t msg_len);
+/* (Big)TIFF header reader; see rgio_tiff_open() */
+typedef struct {
+  VSILFILE *fp;
+  int little;              /* little endian ("II") file */
+  int big;                 /* BigTIFF */
+  int header_size;         /* 8, or 16 for BigTIFF */
+  uint64_t first_ifd;
+} rgio_tiff;
+int rgio_tiff_open(rgio_tiff *tf, const char *path);
+void rgio_tiff_close(rgio_tiff *tf);
+int rgio_tiff_read(rgio_tiff *tf, uint64_t off, void *buf, size_t n);
+uint64_t rgio_tiff_get(const rgio_tiff *tf, const unsigned char *p, int size);
 void rgio_gdal_init(void);
 void rgio_gdal_cleanup(void);
+#ifdef __cplusplus
+}
+#endif
 #endif
@@ -7,7 +7,302 @@
 #include <Rinternals.h>
 #include <gdal.h>
 #include <cpl_conv.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <math.h>
 #include <string.h>
+#include "gdal_utils.h"
+
+/* -------------------------------------------------------------------------- */
+/*  Fields                                                                    */
+/* -------------------------------------------------------------------------- */
+/*
+ * Every field rg_info() can return, in output order. Only the requested
+ * ones are computed, so selecting a few cheap fields avoids reading
+ * overviews, masks or the block index of thousands of files.
+ */
+enum {
+  INFO_DRIVER, INFO_DRIVER_LONG, INFO_DATATYPE, INFO_WIDTH, INFO_HEIGHT,
+  INFO_BANDS, INFO_GT, INFO_CRS, INFO_NODATA, INFO_COLOR_TABLE,
+  INFO_CATEGORIES, INFO_BLOCK_X, INFO_BLOCK_Y, INFO_COMPRESSION,
+  INFO_INTERLEAVE, INFO_TILED, INFO_BIGTIFF, INFO_OVERVIEWS,
+  INFO_OVERVIEW_SIZES, INFO_MASK_FLAGS, INFO_EMPTY_FRACTION,
+  INFO_N_FIELDS
+};
+
+static const char *info_field_names[INFO_N_FIELDS] = {
+  "driver", "driver_long", "datatype", "width", "height",
+  "bands", "gt", "crs", "nodata", "color_table",
+  "categories", "block_x", "block_y", "compression",
+  "interleave", "tiled", "bigtiff", "overviews",
+  "overview_sizes", "mask_flags", "empty_fraction"
+};
+
+static int info_field_index(const char *name) {
+  for (int i = 0; i < INFO_N_FIELDS; i++) {
+    if (strcmp(name, info_field_names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Metadata record                                                           */
+/* -------------------------------------------------------------------------- */
+/*
+ * Plain C copy of a dataset's metadata, filled without the R API so that
+ * records can be collected from worker threads.
+ */
+typedef struct {
+  char driver[64];
+  char driver_long[128];
+  char datatype[32];
+  int width, height, bands;
+  double gt[6];
+  int has_gt;
+  char *crs;              /* CPLStrdup'ed WKT, NULL if none */
+  double nodata;
+  int has_nodata;
+  int color_table;
+  int categories;
+  int *block_x, *block_y; /* per band */
+  char compression[32];   /* empty if not reported */
+  char interleave[16];
+  int tiled;
+  int bigtiff;
+  int n_overviews;
+  int *overview_w, *overview_h;
+  int *mask_flags;        /* per band */
+  double empty_fraction;  /* NaN if the driver cannot tell */
+} info_rec;
+
+static void info_rec_free(info_rec *rec) {
+  CPLFree(rec->crs);
+  CPLFree(rec->block_x);
+  CPLFree(rec->block_y);
+  CPLFree(rec->overview_w);
+  CPLFree(rec->overview_h);
+  CPLFree(rec->mask_flags);
+  memset(rec, 0, sizeof(*rec));
+}
+
+/* Facts read from a GTiff/COG header, once per dataset when first needed */
+typedef struct {
+  int read;
+  int big;        /* BigTIFF */
+  int tiled;      /* first IFD has TileWidth: 1, StripOffsets: 0, unknown: -1 */
+} info_tiff;
+
+static const info_tiff *info_tiff_header(const char *path, info_tiff *t) {
+  if (t->read) return t;
+  t->read = 1;
+  t->big = 0;
+  t->tiled = -1;
+
+  rgio_tiff tf;
+  if (!rgio_tiff_open(&tf, path)) return t;
+  t->big = tf.big;
+  int count_size = tf.big ? 8 : 2, entry_size = tf.big ? 20 : 12;
+  unsigned char entry[20];
+  if (rgio_tiff_read(&tf, tf.first_ifd, entry, count_size)) {
+    uint64_t n = rgio_tiff_get(&tf, entry, count_size);
+    for (uint64_t i = 0; i < n && t->tiled < 0; i++) {
+      if (VSIFReadL(entry, 1, entry_size, tf.fp) != (size_t) entry_size) break;
+      int tag = (int) rgio_tiff_get(&tf, entry, 2);
+      if (tag == 322) t->tiled = 1;       /* TileWidth */
+      else if (tag == 273) t->tiled = 0;  /* StripOffsets */
+    }
+  }
+  rgio_tiff_close(&tf);
+  return t;
+}
+
+/*
+ * Fill `rec` with the fields flagged in `want` (indexed by INFO_*). Basic
+ * dimensions are always read since several fields depend on them.
+ */
+static void info_collect(GDALDatasetH ds, const char *path, const int *want,
+                         info_rec *rec) {
+  memset(rec, 0, sizeof(*rec));
+  rec->empty_fraction = NAN;
+  info_tiff tiff = {0};
+
+  GDALDriverH drv = GDALGetDatasetDriver(ds);
+  snprintf(rec->driver, sizeof(rec->driver), "%s",
+           drv ? GDALGetDriverShortName(drv) : "Unknown");
+  snprintf(rec->driver_long, sizeof(rec->driver_long), "%s",
+           drv ? GDALGetDriverLongName(drv) : "Unknown");
+
+  rec->width = GDALGetRasterXSize(ds);
+  rec->height = GDALGetRasterYSize(ds);
+  rec->bands = GDALGetRasterCount(ds);
+
+  GDALRasterBandH band = rec->bands > 0 ? GDALGetRasterBand(ds, 1) : NULL;
+  GDALDataType dtype = band ? GDALGetRasterDataType(band) : GDT_Unknown;
+  const char *dtype_name = GDALGetDataTypeName(dtype);
+  snprintf(rec->datatype, sizeof(rec->datatype), "%s",
+           dtype_name ? dtype_name : "Unknown");
+
+  if (want[INFO_GT]) {
+    rec->has_gt = GDALGetGeoTransform(ds, rec->gt) == CE_None;
+  }
+
+  if (want[INFO_CRS]) {
+    const char *proj = GDALGetProjectionRef(ds);
+    if (proj != NULL && strlen(proj) > 0) rec->crs = CPLStrdup(proj);
+  }
+
+  if (band != NULL && want[INFO_NODATA]) {
+    rec->nodata = GDALGetRasterNoDataValue(band, &rec->has_nodata);
+  }
+
+  if (band != NULL && want[INFO_COLOR_TABLE]) {
+    rec->color_table = GDALGetRasterColorTable(band) != NULL;
+  }
+
+  if (band != NULL && want[INFO_CATEGORIES]) {
+    char **categories = GDALGetRasterCategoryNames(band);
+    for (int i = 0; categories != NULL && categories[i] != NULL; i++) {
+      if (categories[i][0] != '\0') {
+        rec->categories = 1;
+        break;
+      }
+    }
+  }
+
+  if (want[INFO_BLOCK_X] || want[INFO_BLOCK_Y] || want[INFO_TILED]) {
+    int n = rec->bands > 0 ? rec->bands : 1;
+    rec->block_x = (int *) CPLCalloc(n, sizeof(int));
+    rec->block_y = (int *) CPLCalloc(n, sizeof(int));
+    for (int b = 0; b < rec->bands; b++) {
+      GDALGetBlockSize(GDALGetRasterBand(ds, b + 1), &rec->block_x[b], &rec->block_y[b]);
+    }
+    /*
+     * The layout reported by the driver or stored in the TIFF header when
+     * available; otherwise strips span the full width, while tiles (even a
+     * single one) do not have to.
+     */
+    const char *layout = GDALGetMetadataItem(ds, "TILED", "IMAGE_STRUCTURE");
+    int tiled = layout != NULL ? CPLTestBool(layout) : -1;
+    if (tiled < 0 && drv != NULL &&
+        (EQUAL(rec->driver, "GTiff") || EQUAL(rec->driver, "COG"))) {
+      tiled = info_tiff_header(path, &tiff)->tiled;
+    }
+    rec->tiled = tiled >= 0 ? tiled
+                            : rec->bands > 0 && rec->block_x[0] != rec->width;
+  }
+
+  if (want[INFO_COMPRESSION]) {
+    const char *c = GDALGetMetadataItem(ds, "COMPRESSION", "IMAGE_STRUCTURE");
+    if (c == NULL && band != NULL) {
+      c = GDALGetMetadataItem(band, "COMPRESSION", "IMAGE_STRUCTURE");
+    }
+    snprintf(rec->compression, sizeof(rec->compression), "%s", c ? c : "");
+  }
+
+  if (want[INFO_INTERLEAVE]) {
+    const char *il = GDALGetMetadataItem(ds, "INTERLEAVE", "IMAGE_STRUCTURE");
+    snprintf(rec->interleave, sizeof(rec->interleave), "%s", il ? il : "");
+  }
+
+  if (want[INFO_BIGTIFF] && drv != NULL &&
+      (EQUAL(rec->driver, "GTiff") || EQUAL(rec->driver, "COG"))) {
+    rec->bigtiff = info_tiff_header(path, &tiff)->big;
+  }
+
+  if (band != NULL && (want[INFO_OVERVIEWS] || want[INFO_OVERVIEW_SIZES])) {
+    rec->n_overviews = GDALGetOverviewCount(band);
+    if (want[INFO_OVERVIEW_SIZES] && rec->n_overviews > 0) {
+      rec->overview_w = (int *) CPLCalloc(rec->n_overviews, sizeof(int));
+      rec->overview_h = (int *) CPLCalloc(rec->n_overviews, sizeof(int));
+      for (int i = 0; i < rec->n_overviews; i++) {
+        GDALRasterBandH ovr = GDALGetOverview(band, i);
+        if (ovr == NULL) continue;
+        rec->overview_w[i] = GDALGetRasterBandXSize(ovr);
+        rec->overview_h[i] = GDALGetRasterBandYSize(ovr);
+      }
+    }
+  }
+
+  if (want[INFO_MASK_FLAGS]) {
+    rec->mask_flags = (int *) CPLCalloc(rec->bands > 0 ? rec->bands : 1, sizeof(int));
+    for (int b = 0; b < rec->bands; b++) {
+      rec->mask_flags[b] = GDALGetMaskFlags(GDALGetRasterBand(ds, b + 1));
+    }
+  }
+
+  if (band != NULL && want[INFO_EMPTY_FRACTION]) {
+    double pct = 0;
+    int status = GDALGetDataCoverageStatus(band, 0, 0, rec->width, rec->height,
+                                           0, &pct);
+    if (!(status & GDAL_DATA_COVERAGE_STATUS_UNIMPLEMENTED)) {
+      rec->empty_fraction = 1.0 - pct / 100.0;
+    }
+  }
+}
+
+/* R value of one field of a record */
+static SEXP info_field_value(const info_rec *rec, int field) {
+  SEXP v;
+  switch (field) {
+  case INFO_DRIVER:      return Rf_mkString(rec->driver);
+  case INFO_DRIVER_LONG: return Rf_mkString(rec->driver_long);
+  case INFO_DATATYPE:    return Rf_mkString(rec->datatype);
+  case INFO_WIDTH:       return Rf_ScalarInteger(rec->width);
+  case INFO_HEIGHT:      return Rf_ScalarInteger(rec->height);
+  case INFO_BANDS:       return Rf_ScalarInteger(rec->bands);
+  case INFO_GT:
+    v = Rf_allocVector(REALSXP, 6);
+    for (int i = 0; i < 6; i++) REAL(v)[i] = rec->has_gt ? rec->gt[i] : NA_REAL;
+    return v;
+  case INFO_CRS:
+    return rec->crs ? Rf_mkString(rec->crs) : Rf_ScalarString(NA_STRING);
+  case INFO_NODATA:
+    return Rf_ScalarReal(rec->has_nodata ? rec->nodata : NA_REAL);
+  case INFO_COLOR_TABLE: return Rf_ScalarLogical(rec->color_table);
+  case INFO_CATEGORIES:  return Rf_ScalarLogical(rec->categories);
+  case INFO_BLOCK_X:
+  case INFO_BLOCK_Y:
+    v = Rf_allocVector(INTSXP, rec->bands);
+    for (int b = 0; b < rec->bands; b++) {
+      INTEGER(v)[b] = field == INFO_BLOCK_X ? rec->block_x[b] : rec->block_y[b];
+    }
+    return v;
+  case INFO_COMPRESSION:
+    return rec->compression[0] ? Rf_mkString(rec->compression)
+                               : Rf_ScalarString(NA_STRING);
+  case INFO_INTERLEAVE:
+    return rec->interleave[0] ? Rf_mkString(rec->interleave)
+                              : Rf_ScalarString(NA_STRING);
+  case INFO_TILED:       return Rf_ScalarLogical(rec->tiled);
+  case INFO_BIGTIFF:     return Rf_ScalarLogical(rec->bigtiff);
+  case INFO_OVERVIEWS:   return Rf_ScalarInteger(rec->n_overviews);
+  case INFO_OVERVIEW_SIZES:
+    v = PROTECT(Rf_allocMatrix(INTSXP, rec->n_overviews, 2));
+    for (int i = 0; i < rec->n_overviews; i++) {
+      INTEGER(v)[i] = rec->overview_w[i];
+      INTEGER(v)[i + rec->n_overviews] = rec->overview_h[i];
+    }
+    {
+      SEXP dimnames = PROTECT(Rf_allocVector(VECSXP, 2));
+      SEXP cols = PROTECT(Rf_allocVector(STRSXP, 2));
+      SET_STRING_ELT(cols, 0, Rf_mkChar("width"));
+      SET_STRING_ELT(cols, 1, Rf_mkChar("height"));
+      SET_VECTOR_ELT(dimnames, 1, cols);
+      Rf_setAttrib(v, R_DimNamesSymbol, dimnames);
+      UNPROTECT(3);
+    }
+    return v;
+  case INFO_MASK_FLAGS:
+    v = Rf_allocVector(INTSXP, rec->bands);
+    for (int b = 0; b < rec->bands; b++) INTEGER(v)[b] = rec->mask_flags[b];
+    return v;
+  case INFO_EMPTY_FRACTION:
+    return Rf_ScalarReal(ISNAN(rec->empty_fraction) ? NA_REAL : rec->empty_fraction);
+  default:
+    return R_NilValue;
+  }
+}
 
 /* -------------------------------------------------------------------------- */
 /*  _rgio_info                                                                */
@@ -15,7 +310,7 @@
 /*
  * Inspect raster dataset metadata and return as an R list.
  *
- * Returned fields:
+ * Available fields (see info_field_names):
  *   $driver        - short driver name (e.g., "GTiff", "COG")
  *   $driver_long   - long driver name (e.g., "GeoTIFF")
  *   $datatype      - raster data type (e.g., "UInt16")
@@ -25,150 +320,238 @@
  *   $nodata        - nodata value (numeric or NA)
  *   $color_table   - logical (TRUE if has color table)
  *   $categories    - logical (TRUE if has categories)
+ *   $block_x, $block_y - natural block size per band
+ *   $compression   - IMAGE_STRUCTURE compression or NA
+ *   $interleave    - IMAGE_STRUCTURE interleave or NA
+ *   $tiled         - logical (blocks narrower or wider than the raster)
+ *   $bigtiff       - logical (GTiff/COG with a BigTIFF header)
+ *   $overviews     - overview count of band 1
+ *   $overview_sizes - integer matrix (width, height) per overview
+ *   $mask_flags    - GDALGetMaskFlags() per band
+ *   $empty_fraction - fraction of band 1 reported empty by
+ *                    GDALGetDataCoverageStatus(), NA if unknown
+ *
+ * @param path Dataset path
+ * @param fields Character vector of field names to return, in order
  */
-
-SEXP _rgio_info(SEXP path)
+SEXP _rgio_info(SEXP path, SEXP fields)
 {
   const char *dataset_path = CHAR(STRING_ELT(path, 0));
   GDALAllRegister();
 
+  int n_fields = Rf_length(fields);
+  int want[INFO_N_FIELDS] = {0};
+  int *index = (int *) R_alloc(n_fields > 0 ? n_fields : 1, sizeof(int));
+  for (int i = 0; i < n_fields; i++) {
+    index[i] = info_field_index(CHAR(STRING_ELT(fields, i)));
+    if (index[i] < 0) {
+      error("Unknown info field: %s", CHAR(STRING_ELT(fields, i)));
+    }
+    want[index[i]] = 1;
+  }
+
   GDALDatasetH ds = GDALOpen(dataset_path, GA_ReadOnly);
   if (ds == NULL) {
     error("Failed to open dataset: %s", dataset_path);
   }
 
-  /* Driver information */
-  GDALDriverH drv = GDALGetDatasetDriver(ds);
-  const char *drv_short = drv ? GDALGetDriverShortName(drv) : "Unknown";
-  const char *drv_long  = drv ? GDALGetDriverLongName(drv)  : "Unknown";
-
-  /* Raster dimensions */
-  int width       = GDALGetRasterXSize(ds);
-  int height      = GDALGetRasterYSize(ds);
-  int band_count  = GDALGetRasterCount(ds);
+  info_rec rec;
+  info_collect(ds, dataset_path, want, &rec);
+  GDALClose(ds);
 
-  /* Band and datatype */
-  GDALRasterBandH band = NULL;
-  GDALDataType dtype   = GDT_Unknown;
-  if (band_count > 0) {
-    band = GDALGetRasterBand(ds, 1);
-    if (band != NULL)
-      dtype = GDALGetRasterDataType(band);
+  SEXP result = PROTECT(allocVector(VECSXP, n_fields));
+  SEXP names  = PROTECT(allocVector(STRSXP, n_fields));
+  for (int i = 0; i < n_fields; i++) {
+    SET_VECTOR_ELT(result, i, info_field_value(&rec, index[i]));
+    SET_STRING_ELT(names, i, Rf_mkChar(info_field_names[index[i]]));
   }
+  setAttrib(result, R_NamesSymbol, names);
+  info_rec_free(&rec);
 
-  const char *dtype_name = GDALGetDataTypeName(dtype);
-  if (dtype_name == NULL)
-    dtype_name = "Unknown";
-
-  /* GeoTransform */
-  double gt_vals[6];
-  int has_gt = GDALGetGeoTransform(ds, gt_vals);
-
-  SEXP gt = PROTECT(allocVector(REALSXP, 6));
-  double *gt_ptr = REAL(gt);
-  if (has_gt == CE_None) {
-    for (int i = 0; i < 6; i++)
-      gt_ptr[i] = gt_vals[i];
-  } else {
-    for (int i = 0; i < 6; i++)
-      gt_ptr[i] = NA_REAL;
-  }
-
-  /* CRS (projection) */
-  const char *proj = GDALGetProjectionRef(ds);
-  SEXP crs = PROTECT(allocVector(STRSXP, 1));
-  if (proj != NULL && strlen(proj) > 0) {
-    SET_STRING_ELT(crs, 0, Rf_mkChar(proj));
-  } else {
-    SET_STRING_ELT(crs, 0, NA_STRING);
-  }
-
-  /* NoData value */
-  double nodata_val = NA_REAL;
-  int has_nodata_flag = 0;
-  if (band != NULL) {
-    nodata_val = GDALGetRasterNoDataValue(band, &has_nodata_flag);
-    if (!has_nodata_flag)
-      nodata_val = NA_REAL;
-  }
-
-  /* Color table and categories */
-  int has_color_table = 0;
-  int has_categories  = 0;
-
-  if (band != NULL) {
-    GDALColorTableH ct = GDALGetRasterColorTable(band);
-    if (ct != NULL)
-      has_color_table = 1;
-
-    char **categories = GDALGetRasterCategoryNames(band);
-    if (categories != NULL && categories[0] != NULL) {
-      for (int i = 0; categories[i] != NULL; i++) {
-        if (categories[i][0] != '\0') {
-          has_categories = 1;
-          break;
-        }
-      }
-    }
-  }
+  UNPROTECT(2); /* result, names */
+  return result;
+}
 
-  /* ---------------------------------------------------------------------- */
-  /* Build return list                                                      */
-  /* ---------------------------------------------------------------------- */
+/* -------------------------------------------------------------------------- */
+/*  _rgio_info_batch                                                          */
+/* -------------------------------------------------------------------------- */
+/*
+ * Files are opened by a pool of worker threads, each claiming the next
+ * path under a mutex and filling its record. Records are turned into
+ * preallocated typed columns by the calling thread once all workers are
+ * done; vector fields are reduced to band 1 (block_x, block_y, mask_flags)
+ * or spread over columns (gt1..gt6).
+ */
+typedef struct {
+  int n;
+  char **paths;
+  const int *want;
+  info_rec *recs;
+  char **errors;
+  CPLMutex *mutex;
+  int next;
+} info_batch;
 
-  const int n_items = 11;
-  SEXP result = PROTECT(allocVector(VECSXP, n_items));
-  SEXP names  = PROTECT(allocVector(STRSXP, n_items));
+static void info_batch_worker(void *arg) {
+  info_batch *b = (info_batch *) arg;
+  CPLPushErrorHandler(CPLQuietErrorHandler);
 
-  int idx = 0;
+  for (;;) {
+    CPLAcquireMutex(b->mutex, 1000.0);
+    int i = b->next < b->n ? b->next++ : -1;
+    CPLReleaseMutex(b->mutex);
+    if (i < 0) break;
 
-  /* 0: driver short */
-  SET_VECTOR_ELT(result, idx, Rf_mkString(drv_short));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("driver"));
+    CPLErrorReset();
+    GDALDatasetH ds = GDALOpen(b->paths[i], GA_ReadOnly);
+    if (ds == NULL) {
+      b->errors[i] = CPLStrdup(CPLGetLastErrorMsg()[0] ? CPLGetLastErrorMsg()
+                                                       : "Failed to open dataset");
+      continue;
+    }
+    info_collect(ds, b->paths[i], b->want, &b->recs[i]);
+    GDALClose(ds);
+  }
 
-  /* 1: driver long */
-  SET_VECTOR_ELT(result, idx, Rf_mkString(drv_long));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("driver_long"));
+  CPLPopErrorHandler();
+}
 
-  /* 2: datatype */
-  SET_VECTOR_ELT(result, idx, Rf_mkString(dtype_name));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("datatype"));
+/*
+ * Entry point for batch metadata inspection
+ *
+ * @param paths Character vector of dataset paths
+ * @param fields Character vector of scalar field names (see _rgio_info;
+ *        overview_sizes is not supported)
+ * @param threads Worker threads (0 = all CPUs)
+ * @return Named list of columns: path, the requested fields, error
+ */
+SEXP _rgio_info_batch(SEXP paths, SEXP fields, SEXP threads)
+{
+  GDALAllRegister();
 
-  /* 3: width */
-  SET_VECTOR_ELT(result, idx, ScalarInteger(width));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("width"));
+  int n = Rf_length(paths);
+  int n_fields = Rf_length(fields);
+  int want[INFO_N_FIELDS] = {0};
+  int *index = (int *) R_alloc(n_fields > 0 ? n_fields : 1, sizeof(int));
+  int n_cols = 2;
+  for (int i = 0; i < n_fields; i++) {
+    index[i] = info_field_index(CHAR(STRING_ELT(fields, i)));
+    if (index[i] < 0 || index[i] == INFO_OVERVIEW_SIZES) {
+      error("Unsupported info field for batch: %s", CHAR(STRING_ELT(fields, i)));
+    }
+    want[index[i]] = 1;
+    n_cols += index[i] == INFO_GT ? 6 : 1;
+  }
 
-  /* 4: height */
-  SET_VECTOR_ELT(result, idx, ScalarInteger(height));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("height"));
+  info_batch b;
+  memset(&b, 0, sizeof(b));
+  b.n = n;
+  b.want = want;
+  b.paths = (char **) CPLCalloc(n > 0 ? n : 1, sizeof(char *));
+  b.recs = (info_rec *) CPLCalloc(n > 0 ? n : 1, sizeof(info_rec));
+  b.errors = (char **) CPLCalloc(n > 0 ? n : 1, sizeof(char *));
+  for (int i = 0; i < n; i++) {
+    b.paths[i] = CPLStrdup(CHAR(STRING_ELT(paths, i)));
+  }
 
-  /* 5: bands */
-  SET_VECTOR_ELT(result, idx, ScalarInteger(band_count));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("bands"));
+  int n_workers = rgio_resolve_threads(INTEGER(threads)[0], n);
+  b.mutex = CPLCreateMutex();
+  CPLReleaseMutex(b.mutex);
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+  for (int i = 1; i < n_workers; i++) {
+    workers[i] = CPLCreateJoinableThread(info_batch_worker, &b);
+  }
+  info_batch_worker(&b);  /* the calling thread opens files too */
+  for (int i = 1; i < n_workers; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLDestroyMutex(b.mutex);
 
-  /* 6: GeoTransform */
-  SET_VECTOR_ELT(result, idx, gt);
-  SET_STRING_ELT(names, idx++, Rf_mkChar("gt"));
+  /* Columns */
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, n_cols));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, n_cols));
+  int col = 0;
 
-  /* 7: CRS */
-  SET_VECTOR_ELT(result, idx, crs);
-  SET_STRING_ELT(names, idx++, Rf_mkChar("crs"));
+  SET_VECTOR_ELT(result, col, paths);
+  SET_STRING_ELT(names, col++, Rf_mkChar("path"));
 
-  /* 8: nodata */
-  SET_VECTOR_ELT(result, idx, ScalarReal(nodata_val));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("nodata"));
+  for (int f = 0; f < n_fields; f++) {
+    int field = index[f];
+    if (field == INFO_GT) {
+      for (int k = 0; k < 6; k++) {
+        SEXP v = Rf_allocVector(REALSXP, n);
+        SET_VECTOR_ELT(result, col, v);
+        for (int i = 0; i < n; i++) {
+          REAL(v)[i] = b.recs[i].has_gt ? b.recs[i].gt[k] : NA_REAL;
+        }
+        SET_STRING_ELT(names, col++, Rf_mkChar(CPLSPrintf("gt%d", k + 1)));
+      }
+      continue;
+    }
 
-  /* 9: color table */
-  SET_VECTOR_ELT(result, idx, ScalarLogical(has_color_table));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("color_table"));
+    SEXPTYPE type;
+    switch (field) {
+    case INFO_WIDTH: case INFO_HEIGHT: case INFO_BANDS: case INFO_BLOCK_X:
+    case INFO_BLOCK_Y: case INFO_OVERVIEWS: case INFO_MASK_FLAGS:
+      type = INTSXP; break;
+    case INFO_NODATA: case INFO_EMPTY_FRACTION:
+      type = REALSXP; break;
+    case INFO_COLOR_TABLE: case INFO_CATEGORIES: case INFO_TILED: case INFO_BIGTIFF:
+      type = LGLSXP; break;
+    default:
+      type = STRSXP; break;
+    }
+    SEXP v = Rf_allocVector(type, n);
+    SET_VECTOR_ELT(result, col, v);
+    SET_STRING_ELT(names, col++, Rf_mkChar(info_field_names[field]));
 
-  /* 10: categories */
-  SET_VECTOR_ELT(result, idx, ScalarLogical(has_categories));
-  SET_STRING_ELT(names, idx++, Rf_mkChar("categories"));
+    for (int i = 0; i < n; i++) {
+      const info_rec *r = &b.recs[i];
+      int failed = b.errors[i] != NULL;
+      switch (field) {
+      case INFO_DRIVER:      SET_STRING_ELT(v, i, failed ? NA_STRING : Rf_mkChar(r->driver)); break;
+      case INFO_DRIVER_LONG: SET_STRING_ELT(v, i, failed ? NA_STRING : Rf_mkChar(r->driver_long)); break;
+      case INFO_DATATYPE:    SET_STRING_ELT(v, i, failed ? NA_STRING : Rf_mkChar(r->datatype)); break;
+      case INFO_CRS:         SET_STRING_ELT(v, i, r->crs ? Rf_mkChar(r->crs) : NA_STRING); break;
+      case INFO_COMPRESSION:
+        SET_STRING_ELT(v, i, r->compression[0] ? Rf_mkChar(r->compression) : NA_STRING); break;
+      case INFO_INTERLEAVE:
+        SET_STRING_ELT(v, i, r->interleave[0] ? Rf_mkChar(r->interleave) : NA_STRING); break;
+      case INFO_WIDTH:    INTEGER(v)[i] = failed ? NA_INTEGER : r->width; break;
+      case INFO_HEIGHT:   INTEGER(v)[i] = failed ? NA_INTEGER : r->height; break;
+      case INFO_BANDS:    INTEGER(v)[i] = failed ? NA_INTEGER : r->bands; break;
+      case INFO_BLOCK_X:  INTEGER(v)[i] = r->bands > 0 ? r->block_x[0] : NA_INTEGER; break;
+      case INFO_BLOCK_Y:  INTEGER(v)[i] = r->bands > 0 ? r->block_y[0] : NA_INTEGER; break;
+      case INFO_OVERVIEWS: INTEGER(v)[i] = failed ? NA_INTEGER : r->n_overviews; break;
+      case INFO_MASK_FLAGS: INTEGER(v)[i] = r->bands > 0 ? r->mask_flags[0] : NA_INTEGER; break;
+      case INFO_NODATA:   REAL(v)[i] = r->has_nodata ? r->nodata : NA_REAL; break;
+      case INFO_EMPTY_FRACTION:
+        REAL(v)[i] = failed || ISNAN(r->empty_fraction) ? NA_REAL : r->empty_fraction; break;
+      case INFO_COLOR_TABLE: LOGICAL(v)[i] = failed ? NA_LOGICAL : r->color_table; break;
+      case INFO_CATEGORIES:  LOGICAL(v)[i] = failed ? NA_LOGICAL : r->categories; break;
+      case INFO_TILED:       LOGICAL(v)[i] = failed ? NA_LOGICAL : r->tiled; break;
+      case INFO_BIGTIFF:     LOGICAL(v)[i] = failed ? NA_LOGICAL : r->bigtiff; break;
+      default: break;
+      }
+    }
+  }
 
-  setAttrib(result, R_NamesSymbol, names);
+  SEXP r_error = Rf_allocVector(STRSXP, n);
+  SET_VECTOR_ELT(result, col, r_error);
+  SET_STRING_ELT(names, col++, Rf_mkChar("error"));
+  for (int i = 0; i < n; i++) {
+    SET_STRING_ELT(r_error, i, b.errors[i] ? Rf_mkChar(b.errors[i]) : NA_STRING);
+    CPLFree(b.errors[i]);
+    CPLFree(b.paths[i]);
+    info_rec_free(&b.recs[i]);
+  }
+  CPLFree(b.errors);
+  CPLFree(b.paths);
+  CPLFree(b.recs);
 
-  GDALClose(ds);
-  UNPROTECT(4); /* gt, crs, result, names */
+  Rf_setAttrib(result, R_NamesSymbol, names);
+  UNPROTECT(2); /* result, names */
   return result;
 }
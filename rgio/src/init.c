@@ -10,7 +10,8 @@
 /* Forward declarations of C entry points */
 extern SEXP _rgio_rz(SEXP files, SEXP outdir, SEXP value, SEXP field,
                      SEXP res, SEXP crs, SEXP nodata, SEXP dtype,
-                     SEXP format, SEXP ro, SEXP co, SEXP threads);
+                     SEXP format, SEXP ro, SEXP co, SEXP threads,
+                     SEXP where, SEXP sql, SEXP coverage);
 extern SEXP _rgio_wp(SEXP src, SEXP dst, SEXP tr, SEXP crs,
                      SEXP resample, SEXP dstnodata, SEXP wo,
                      SEXP co, SEXP threads, SEXP format, SEXP overwrite);
@@ -19,7 +20,11 @@ extern SEXP _rgio_rd(SEXP src, SEXP bbox, SEXP width, SEXP height,
                      SEXP threads, SEXP warp_opts);
 extern SEXP _rgio_lg(SEXP file, SEXP values, SEXP colors_rgba, SEXP labels);
 extern SEXP _rgio_vf(SEXP src, SEXP bbox, SEXP width, SEXP height,
-                     SEXP crs, SEXP opts);
+                     SEXP crs, SEXP opts, SEXP derived, SEXP resample,
+                     SEXP cache, SEXP check, SEXP threads, SEXP index,
+                     SEXP dst);
+extern SEXP _rgio_vsimem_usage(SEXP prefix);
+extern SEXP _rgio_vsimem_remove(SEXP dir);
 extern SEXP _rgio_vrt_palette_get(SEXP file);
 extern SEXP _rgio_vrt_palette_set(SEXP file, SEXP values, SEXP colors, SEXP nrows);
 extern SEXP _rgio_vrt_legend_get(SEXP file);
@@ -27,34 +32,66 @@ extern SEXP _rgio_vrt_legend_set(SEXP file, SEXP values, SEXP labels);
 extern SEXP _rgio_tr(SEXP src, SEXP dst, SEXP format,
                      SEXP resample, SEXP nodata, SEXP options,
                      SEXP co, SEXP threads);
+extern SEXP _rgio_tr_batch(SEXP src, SEXP dst, SEXP format,
+                           SEXP resample, SEXP nodata, SEXP options,
+                           SEXP co, SEXP threads);
 extern SEXP _rgio_wr(SEXP file, SEXP data, SEXP width, SEXP height,
                      SEXP gt, SEXP crs, SEXP datatype, SEXP nodata,
                      SEXP co);
 extern SEXP _rgio_pal(SEXP file, SEXP indices);
 extern SEXP _rgio_overviews(SEXP path, SEXP levels, SEXP resample,
-                            SEXP external, SEXP threads);
-extern SEXP _rgio_info(SEXP path);
+                            SEXP external, SEXP threads, SEXP cascade,
+                            SEXP windows);
+extern SEXP _rgio_info(SEXP path, SEXP fields);
+extern SEXP _rgio_info_batch(SEXP paths, SEXP fields, SEXP threads);
 extern SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
-                      SEXP field, SEXP connectedness, SEXP mask, SEXP co);
+                      SEXP field, SEXP connectedness, SEXP mask, SEXP co,
+                      SEXP tile_size, SEXP threads, SEXP simplify_tolerance,
+                      SEXP min_area);
+extern SEXP _rgio_vec_batch(SEXP src, SEXP band, SEXP id, SEXP dst, SEXP format,
+                            SEXP field, SEXP id_field, SEXP connectedness,
+                            SEXP co, SEXP threads);
+extern SEXP _rgio_codec_bench(SEXP src, SEXP windows, SEXP candidates);
+extern SEXP _rgio_cog_check(SEXP path);
+extern SEXP _rgio_stats(SEXP path, SEXP bands, SEXP bins, SEXP approx,
+                        SEXP threads, SEXP cache);
+extern SEXP _rgio_class_area(SEXP path, SEXP band, SEXP mode, SEXP threads);
+extern SEXP _rgio_reclass(SEXP src, SEXP dst, SEXP band, SEXP from, SEXP to,
+                          SEXP rmin, SEXP rmax, SEXP rto, SEXP others,
+                          SEXP dtype, SEXP nodata, SEXP format, SEXP co,
+                          SEXP legend, SEXP threads);
+extern SEXP _rgio_calc(SEXP expr, SEXP names, SEXP paths, SEXP bands, SEXP dst,
+                       SEXP dtype, SEXP nodata, SEXP format, SEXP co, SEXP threads);
 extern SEXP _rgio_gdal_capabilities(SEXP format);
 
 /* Registration table */
 static const R_CallMethodDef CallEntries[] = {
-  {"_rgio_rz", (DL_FUNC) &_rgio_rz, 12},
+  {"_rgio_rz", (DL_FUNC) &_rgio_rz, 15},
   {"_rgio_wp", (DL_FUNC) &_rgio_wp, 11},
   {"_rgio_rd", (DL_FUNC) &_rgio_rd, 9},
   {"_rgio_lg", (DL_FUNC) &_rgio_lg, 4},
-  {"_rgio_vf", (DL_FUNC) &_rgio_vf, 6},
+  {"_rgio_vf", (DL_FUNC) &_rgio_vf, 13},
+  {"_rgio_vsimem_usage", (DL_FUNC) &_rgio_vsimem_usage, 1},
+  {"_rgio_vsimem_remove", (DL_FUNC) &_rgio_vsimem_remove, 1},
   {"_rgio_vrt_palette_get", (DL_FUNC) &_rgio_vrt_palette_get, 1},
   {"_rgio_vrt_palette_set", (DL_FUNC) &_rgio_vrt_palette_set, 4},
   {"_rgio_vrt_legend_get", (DL_FUNC) &_rgio_vrt_legend_get, 1},
   {"_rgio_vrt_legend_set", (DL_FUNC) &_rgio_vrt_legend_set, 3},
   {"_rgio_tr", (DL_FUNC) &_rgio_tr, 8},
+  {"_rgio_tr_batch", (DL_FUNC) &_rgio_tr_batch, 8},
   {"_rgio_wr", (DL_FUNC) &_rgio_wr, 9},
   {"_rgio_pal", (DL_FUNC) &_rgio_pal, 2},
-  {"_rgio_overviews", (DL_FUNC) &_rgio_overviews, 5},
-  {"_rgio_info", (DL_FUNC) &_rgio_info, 1},
-  {"_rgio_vec", (DL_FUNC) &_rgio_vec, 8},
+  {"_rgio_overviews", (DL_FUNC) &_rgio_overviews, 7},
+  {"_rgio_info", (DL_FUNC) &_rgio_info, 2},
+  {"_rgio_info_batch", (DL_FUNC) &_rgio_info_batch, 3},
+  {"_rgio_vec", (DL_FUNC) &_rgio_vec, 12},
+  {"_rgio_vec_batch", (DL_FUNC) &_rgio_vec_batch, 10},
+  {"_rgio_codec_bench", (DL_FUNC) &_rgio_codec_bench, 3},
+  {"_rgio_cog_check", (DL_FUNC) &_rgio_cog_check, 1},
+  {"_rgio_stats", (DL_FUNC) &_rgio_stats, 6},
+  {"_rgio_class_area", (DL_FUNC) &_rgio_class_area, 4},
+  {"_rgio_reclass", (DL_FUNC) &_rgio_reclass, 15},
+  {"_rgio_calc", (DL_FUNC) &_rgio_calc, 10},
   {"_rgio_gdal_capabilities", (DL_FUNC) &_rgio_gdal_capabilities, 1},
   {NULL, NULL, 0}
 };
@@ -74,13 +74,23 @@ SEXP _rgio_lg(SEXP file, SEXP values, SEXP colors_rgba, SEXP labels) {
   
   /* Set category names if provided */
   if (has_labels) {
-    /* Build category names array */
-    char **category_names = (char **)CPLCalloc(n_entries + 1, sizeof(char *));
+    /* Build category names array, indexed by pixel value like the color
+     * table; values without a label get an empty name */
+    int n_names = 0;
+    for (int i = 0; i < n_entries; i++) {
+      if (value_indices[i] + 1 > n_names) n_names = value_indices[i] + 1;
+    }
+    char **category_names = (char **)CPLCalloc(n_names + 1, sizeof(char *));
     
     for (int i = 0; i < n_entries; i++) {
-      category_names[i] = CPLStrdup(CHAR(STRING_ELT(labels, i)));
+      if (value_indices[i] < 0) continue;
+      CPLFree(category_names[value_indices[i]]);
+      category_names[value_indices[i]] = CPLStrdup(CHAR(STRING_ELT(labels, i)));
+    }
+    for (int i = 0; i < n_names; i++) {
+      if (category_names[i] == NULL) category_names[i] = CPLStrdup("");
     }
-    category_names[n_entries] = NULL;
+    category_names[n_names] = NULL;
     
     /* Set category names */
     err = GDALSetRasterCategoryNames(band, category_names);
@@ -1,6 +1,16 @@
 /*
  * overviews.c
  * Build raster overviews using GDAL
+ *
+ * Besides a single GDALBuildOverviews() call, a cascading builder computes
+ * every level from the previous one (level k+1 from level k) instead of
+ * from the full-resolution band. It works band by band and tile by tile:
+ * the calling thread reads and writes all pixels through its dataset
+ * handle, while a pool of worker threads runs the resampling kernels on
+ * the buffered tiles. Each level may use its own resampling method.
+ *
+ * The same kernels refresh existing overviews over dirty windows only, so
+ * a small edit of a large raster does not rebuild whole levels.
  */
 
 #include <R.h>
@@ -8,14 +18,417 @@
 #include <gdal.h>
 #include <cpl_conv.h>
 #include <cpl_string.h>
+#include <cpl_multiproc.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
+#include "gdal_utils.h"
 
+/* Tiles buffered per worker thread between a read and a write phase */
+#define OVR_TILES_PER_THREAD 4
+
+/* Processing tile edge when the overview band is not tiled */
+#define OVR_DEFAULT_TILE 512
+
+/* -------------------------------------------------------------------------- */
+/*  Resampling kernels                                                        */
+/* -------------------------------------------------------------------------- */
+
+typedef enum {
+  OVR_NEAR, OVR_AVERAGE, OVR_RMS, OVR_MODE, OVR_MIN, OVR_MAX, OVR_SUM,
+  OVR_MED, OVR_Q1, OVR_Q3,
+  OVR_GDAL  /* no native kernel: GDALRegenerateOverviews() from level k */
+} ovr_kernel;
+
+static ovr_kernel ovr_kernel_from_string(const char *method) {
+  if (EQUAL(method, "near") || EQUAL(method, "nearest")) return OVR_NEAR;
+  if (EQUAL(method, "average")) return OVR_AVERAGE;
+  if (EQUAL(method, "rms")) return OVR_RMS;
+  if (EQUAL(method, "mode")) return OVR_MODE;
+  if (EQUAL(method, "min")) return OVR_MIN;
+  if (EQUAL(method, "max")) return OVR_MAX;
+  if (EQUAL(method, "sum")) return OVR_SUM;
+  if (EQUAL(method, "med")) return OVR_MED;
+  if (EQUAL(method, "q1")) return OVR_Q1;
+  if (EQUAL(method, "q3")) return OVR_Q3;
+  return OVR_GDAL;
+}
+
+static int ovr_cmp_double(const void *a, const void *b) {
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/* Source pixels [s0, s1) of level k that fall in pixel d of level k+1 */
+static void ovr_src_range(int d, double ratio, int src_size, int *s0, int *s1) {
+  *s0 = (int) floor(d * ratio);
+  *s1 = (int) floor((d + 1) * ratio);
+  if (*s0 >= src_size) *s0 = src_size - 1;
+  if (*s1 > src_size) *s1 = src_size;
+  if (*s1 <= *s0) *s1 = *s0 + 1;
+}
+
+/* Reduce the `n` valid values of one window; `vals` may be reordered */
+static double ovr_reduce(ovr_kernel kernel, double *vals, int n) {
+  double acc;
+  switch (kernel) {
+  case OVR_AVERAGE:
+    acc = 0.0;
+    for (int i = 0; i < n; i++) acc += vals[i];
+    return acc / n;
+  case OVR_RMS:
+    acc = 0.0;
+    for (int i = 0; i < n; i++) acc += vals[i] * vals[i];
+    return sqrt(acc / n);
+  case OVR_SUM:
+    acc = 0.0;
+    for (int i = 0; i < n; i++) acc += vals[i];
+    return acc;
+  case OVR_MIN:
+    acc = vals[0];
+    for (int i = 1; i < n; i++) if (vals[i] < acc) acc = vals[i];
+    return acc;
+  case OVR_MAX:
+    acc = vals[0];
+    for (int i = 1; i < n; i++) if (vals[i] > acc) acc = vals[i];
+    return acc;
+  case OVR_MODE: {
+    qsort(vals, n, sizeof(double), ovr_cmp_double);
+    double best = vals[0];
+    int best_run = 0;
+    for (int i = 0; i < n;) {
+      int j = i;
+      while (j < n && vals[j] == vals[i]) j++;
+      if (j - i > best_run) {
+        best_run = j - i;
+        best = vals[i];
+      }
+      i = j;
+    }
+    return best;
+  }
+  case OVR_MED:
+  case OVR_Q1:
+  case OVR_Q3: {
+    qsort(vals, n, sizeof(double), ovr_cmp_double);
+    double q = kernel == OVR_MED ? 0.5 : kernel == OVR_Q1 ? 0.25 : 0.75;
+    return vals[(int) floor(q * (n - 1) + 0.5)];
+  }
+  default:
+    return vals[0];
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Tiles and workers                                                         */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  int dst_x0, dst_y0, dst_w, dst_h;  /* window in level k+1 */
+  int src_x0, src_y0, src_w, src_h;  /* window in level k */
+  double *src;
+  double *dst;
+} ovr_tile;
+
+typedef struct {
+  ovr_tile *tiles;
+  int n_tiles;
+  double rx, ry;                     /* level k pixels per level k+1 pixel */
+  int src_xsize, src_ysize;
+  ovr_kernel kernel;
+  int has_nodata;
+  double nodata;
+  int max_window;                    /* largest source window, in pixels */
+  CPLMutex *mutex;
+  int next;
+} ovr_batch;
+
+static void ovr_compute_tile(const ovr_batch *b, ovr_tile *t, double *vals) {
+  for (int y = 0; y < t->dst_h; y++) {
+    int sy0, sy1;
+    ovr_src_range(t->dst_y0 + y, b->ry, b->src_ysize, &sy0, &sy1);
+    for (int x = 0; x < t->dst_w; x++) {
+      int sx0, sx1;
+      ovr_src_range(t->dst_x0 + x, b->rx, b->src_xsize, &sx0, &sx1);
+      double out = b->has_nodata ? b->nodata : NAN;
+
+      if (b->kernel == OVR_NEAR) {
+        int sx = (int) floor((t->dst_x0 + x + 0.5) * b->rx);
+        int sy = (int) floor((t->dst_y0 + y + 0.5) * b->ry);
+        if (sx < sx0) sx = sx0;
+        if (sx >= sx1) sx = sx1 - 1;
+        if (sy < sy0) sy = sy0;
+        if (sy >= sy1) sy = sy1 - 1;
+        out = t->src[(size_t) (sy - t->src_y0) * t->src_w + (sx - t->src_x0)];
+      } else {
+        int n = 0;
+        for (int sy = sy0; sy < sy1; sy++) {
+          const double *row = t->src + (size_t) (sy - t->src_y0) * t->src_w - t->src_x0;
+          for (int sx = sx0; sx < sx1; sx++) {
+            double v = row[sx];
+            if (isnan(v) || (b->has_nodata && v == b->nodata)) continue;
+            vals[n++] = v;
+          }
+        }
+        if (n > 0) out = ovr_reduce(b->kernel, vals, n);
+      }
+      t->dst[(size_t) y * t->dst_w + x] = out;
+    }
+  }
+}
+
+static void ovr_worker(void *arg) {
+  ovr_batch *b = (ovr_batch *) arg;
+  double *vals = (double *) CPLMalloc((size_t) b->max_window * sizeof(double));
+  for (;;) {
+    CPLAcquireMutex(b->mutex, 1000.0);
+    int i = b->next++;
+    CPLReleaseMutex(b->mutex);
+    if (i >= b->n_tiles) break;
+    ovr_compute_tile(b, &b->tiles[i], vals);
+  }
+  CPLFree(vals);
+}
+
+/*
+ * Compute `dst` (level k+1) from `src` (level k) with a native kernel,
+ * restricted to the window `win` = {x0, y0, x1, y1} of `dst` (NULL for the
+ * whole band). Tiles follow the block layout of `dst` and are processed in
+ * batches: read serially, resampled on `n_threads` workers, written
+ * serially.
+ */
+static CPLErr ovr_cascade_level(GDALRasterBandH src, GDALRasterBandH dst,
+                                ovr_kernel kernel, int n_threads,
+                                const int *win) {
+  ovr_batch b;
+  memset(&b, 0, sizeof(b));
+  b.src_xsize = GDALGetRasterBandXSize(src);
+  b.src_ysize = GDALGetRasterBandYSize(src);
+  int dst_xsize = GDALGetRasterBandXSize(dst);
+  int dst_ysize = GDALGetRasterBandYSize(dst);
+  b.rx = (double) b.src_xsize / dst_xsize;
+  b.ry = (double) b.src_ysize / dst_ysize;
+  b.kernel = kernel;
+  b.nodata = GDALGetRasterNoDataValue(src, &b.has_nodata);
+
+  int bx, by;
+  GDALGetBlockSize(dst, &bx, &by);
+  if (bx != by || bx < 64) bx = by = OVR_DEFAULT_TILE;
+
+  int x0 = 0, y0 = 0, x1 = dst_xsize, y1 = dst_ysize;
+  if (win != NULL) {
+    x0 = win[0] > 0 ? win[0] : 0;
+    y0 = win[1] > 0 ? win[1] : 0;
+    x1 = win[2] < dst_xsize ? win[2] : dst_xsize;
+    y1 = win[3] < dst_ysize ? win[3] : dst_ysize;
+  }
+  if (x1 <= x0 || y1 <= y0) return CE_None;
+
+  int n_tx = (x1 - x0 + bx - 1) / bx;
+  int n_ty = (y1 - y0 + by - 1) / by;
+  int n_total = n_tx * n_ty;
+  int batch_cap = n_threads * OVR_TILES_PER_THREAD;
+
+  b.tiles = (ovr_tile *) CPLCalloc(batch_cap, sizeof(ovr_tile));
+  b.max_window = ((int) ceil(b.rx) + 1) * ((int) ceil(b.ry) + 1);
+  b.mutex = CPLCreateMutex();
+  CPLReleaseMutex(b.mutex);
+
+  CPLErr err = CE_None;
+  for (int first = 0; first < n_total && err == CE_None; first += batch_cap) {
+    b.n_tiles = n_total - first < batch_cap ? n_total - first : batch_cap;
+    b.next = 0;
+
+    /* Read */
+    for (int i = 0; i < b.n_tiles && err == CE_None; i++) {
+      ovr_tile *t = &b.tiles[i];
+      int k = first + i;
+      int s0, s1;
+      t->dst_x0 = x0 + (k % n_tx) * bx;
+      t->dst_y0 = y0 + (k / n_tx) * by;
+      t->dst_w = x1 - t->dst_x0 < bx ? x1 - t->dst_x0 : bx;
+      t->dst_h = y1 - t->dst_y0 < by ? y1 - t->dst_y0 : by;
+
+      ovr_src_range(t->dst_x0, b.rx, b.src_xsize, &t->src_x0, &s1);
+      ovr_src_range(t->dst_x0 + t->dst_w - 1, b.rx, b.src_xsize, &s0, &s1);
+      t->src_w = s1 - t->src_x0;
+      ovr_src_range(t->dst_y0, b.ry, b.src_ysize, &t->src_y0, &s1);
+      ovr_src_range(t->dst_y0 + t->dst_h - 1, b.ry, b.src_ysize, &s0, &s1);
+      t->src_h = s1 - t->src_y0;
+
+      t->src = (double *) CPLRealloc(t->src, (size_t) t->src_w * t->src_h * sizeof(double));
+      t->dst = (double *) CPLRealloc(t->dst, (size_t) t->dst_w * t->dst_h * sizeof(double));
+      err = GDALRasterIO(src, GF_Read, t->src_x0, t->src_y0, t->src_w, t->src_h,
+                         t->src, t->src_w, t->src_h, GDT_Float64, 0, 0);
+    }
+    if (err != CE_None) break;
+
+    /* Resample */
+    int n_workers = n_threads < b.n_tiles ? n_threads : b.n_tiles;
+    CPLJoinableThread **workers =
+      (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+    for (int i = 1; i < n_workers; i++) {
+      workers[i] = CPLCreateJoinableThread(ovr_worker, &b);
+    }
+    ovr_worker(&b);  /* the calling thread takes part too */
+    for (int i = 1; i < n_workers; i++) {
+      if (workers[i]) CPLJoinThread(workers[i]);
+    }
+    CPLFree(workers);
+
+    /* Write */
+    for (int i = 0; i < b.n_tiles && err == CE_None; i++) {
+      ovr_tile *t = &b.tiles[i];
+      err = GDALRasterIO(dst, GF_Write, t->dst_x0, t->dst_y0, t->dst_w, t->dst_h,
+                         t->dst, t->dst_w, t->dst_h, GDT_Float64, 0, 0);
+    }
+  }
+
+  for (int i = 0; i < batch_cap; i++) {
+    CPLFree(b.tiles[i].src);
+    CPLFree(b.tiles[i].dst);
+  }
+  CPLFree(b.tiles);
+  CPLDestroyMutex(b.mutex);
+  return err;
+}
+
+/* Overview of `band` created for decimation `level` */
+static GDALRasterBandH ovr_band_for_level(GDALRasterBandH band, int level) {
+  int want = (GDALGetRasterBandXSize(band) + level - 1) / level;
+  GDALRasterBandH best = NULL;
+  int best_diff = 0;
+  for (int i = 0; i < GDALGetOverviewCount(band); i++) {
+    GDALRasterBandH ovr = GDALGetOverview(band, i);
+    int diff = abs(GDALGetRasterBandXSize(ovr) - want);
+    if (best == NULL || diff < best_diff) {
+      best = ovr;
+      best_diff = diff;
+    }
+  }
+  return best;
+}
+
+static int ovr_cmp_int(const void *a, const void *b) {
+  return *(const int *) a - *(const int *) b;
+}
+
+/*
+ * Cascading build: levels are sorted, created empty ("NONE"), then filled
+ * band by band, each level from the previous one. `methods[i]` is the
+ * resampling of the i-th level (after sorting).
+ */
+static CPLErr ovr_build_cascade(GDALDatasetH ds, int n_levels, int *levels,
+                                const char *const *methods, int threads) {
+  CPLErr err = GDALBuildOverviews(ds, "NONE", n_levels, levels, 0, NULL, NULL, NULL);
+  if (err != CE_None) return err;
+
+  int n_threads = rgio_resolve_threads(threads, 1 << 16);
+  int n_bands = GDALGetRasterCount(ds);
+
+  for (int b = 1; b <= n_bands && err == CE_None; b++) {
+    GDALRasterBandH base = GDALGetRasterBand(ds, b);
+    GDALRasterBandH src = base;
+    for (int i = 0; i < n_levels && err == CE_None; i++) {
+      GDALRasterBandH dst = ovr_band_for_level(base, levels[i]);
+      if (dst == NULL) return CE_Failure;
+
+      ovr_kernel kernel = ovr_kernel_from_string(methods[i]);
+      if (kernel == OVR_GDAL) {
+        err = GDALRegenerateOverviews(src, 1, &dst, methods[i], NULL, NULL);
+      } else {
+        err = ovr_cascade_level(src, dst, kernel, n_threads, NULL);
+      }
+      src = dst;
+    }
+    GDALFlushRasterCache(base);
+  }
+  return err;
+}
+
+static int ovr_cmp_band_size(const void *a, const void *b) {
+  return GDALGetRasterBandXSize(*(GDALRasterBandH const *) b) -
+         GDALGetRasterBandXSize(*(GDALRasterBandH const *) a);
+}
+
+/*
+ * Incremental refresh: for each dirty window {x0, y0, x1, y1} of the
+ * full-resolution band, recompute only the overview pixels it covers,
+ * level by level from the largest overview down, each from the level
+ * above. `methods[i]` is the resampling of the i-th largest overview.
+ */
+static CPLErr ovr_refresh_windows(GDALDatasetH ds, int n_win, const int *windows,
+                                  const char *const *methods, int n_methods,
+                                  int threads, char *message, size_t message_len) {
+  int n_threads = rgio_resolve_threads(threads, 1 << 16);
+  int n_bands = GDALGetRasterCount(ds);
+  CPLErr err = CE_None;
+
+  for (int b = 1; b <= n_bands && err == CE_None; b++) {
+    GDALRasterBandH base = GDALGetRasterBand(ds, b);
+    int n_ovr = GDALGetOverviewCount(base);
+    if (n_ovr == 0) {
+      snprintf(message, message_len, "dataset has no overviews to refresh");
+      return CE_Failure;
+    }
+    GDALRasterBandH *ovr = (GDALRasterBandH *) CPLMalloc(n_ovr * sizeof(GDALRasterBandH));
+    for (int i = 0; i < n_ovr; i++) ovr[i] = GDALGetOverview(base, i);
+    qsort(ovr, n_ovr, sizeof(GDALRasterBandH), ovr_cmp_band_size);
+
+    for (int w = 0; w < n_win && err == CE_None; w++) {
+      int cur[4];
+      memcpy(cur, windows + 4 * w, sizeof(cur));
+      GDALRasterBandH src = base;
+
+      for (int i = 0; i < n_ovr && err == CE_None; i++) {
+        const char *method = methods[i < n_methods ? i : n_methods - 1];
+        ovr_kernel kernel = ovr_kernel_from_string(method);
+        if (kernel == OVR_GDAL) {
+          snprintf(message, message_len,
+                   "resampling '%s' is not supported for incremental refresh", method);
+          err = CE_Failure;
+          break;
+        }
+
+        double rx = (double) GDALGetRasterBandXSize(src) / GDALGetRasterBandXSize(ovr[i]);
+        double ry = (double) GDALGetRasterBandYSize(src) / GDALGetRasterBandYSize(ovr[i]);
+        int dst_win[4];
+        dst_win[0] = (int) floor(cur[0] / rx);
+        dst_win[1] = (int) floor(cur[1] / ry);
+        dst_win[2] = (int) ceil(cur[2] / rx);
+        dst_win[3] = (int) ceil(cur[3] / ry);
+
+        err = ovr_cascade_level(src, ovr[i], kernel, n_threads, dst_win);
+        memcpy(cur, dst_win, sizeof(cur));
+        src = ovr[i];
+      }
+    }
+    CPLFree(ovr);
+    GDALFlushRasterCache(base);
+  }
+  return err;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_overviews()                                                         */
+/* -------------------------------------------------------------------------- */
+/*
+ * @param resample Resampling method; with `cascade`, one per level (recycled
+ *   from the last element)
+ * @param cascade Logical; compute each level from the previous one with the
+ *   native builder
+ * @param windows Integer n x 4 matrix of dirty windows (xoff, yoff, xsize,
+ *   ysize) of the full-resolution band; when non-empty the existing
+ *   overviews are refreshed over those windows only and `levels` is ignored
+ */
 SEXP _rgio_overviews(SEXP path, SEXP levels, SEXP resample,
-                     SEXP external, SEXP threads) {
+                     SEXP external, SEXP threads, SEXP cascade,
+                     SEXP windows) {
   const char *dataset_path = CHAR(STRING_ELT(path, 0));
   const char *resample_method = CHAR(STRING_ELT(resample, 0));
   int external_flag = LOGICAL(external)[0];
   int thread_count = INTEGER(threads)[0];
+  int cascade_flag = LOGICAL(cascade)[0];
 
   GDALAllRegister();
 
@@ -37,6 +450,41 @@ SEXP _rgio_overviews(SEXP path, SEXP levels, SEXP resample,
     CPLSetConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
   }
 
+  int n_win = Rf_isMatrix(windows) ? Rf_nrows(windows) : 0;
+  if (n_win > 0) {
+    int *win = (int *) CPLMalloc(4 * n_win * sizeof(int));
+    const int *m = INTEGER(windows);
+    for (int w = 0; w < n_win; w++) {
+      win[4 * w + 0] = m[w];
+      win[4 * w + 1] = m[w + n_win];
+      win[4 * w + 2] = m[w] + m[w + 2 * n_win];
+      win[4 * w + 3] = m[w + n_win] + m[w + 3 * n_win];
+    }
+    int n_methods = LENGTH(resample);
+    const char **methods = (const char **) CPLMalloc(n_methods * sizeof(char *));
+    for (int i = 0; i < n_methods; i++) methods[i] = CHAR(STRING_ELT(resample, i));
+
+    char message[256] = "";
+    CPLErr err = ovr_refresh_windows(ds, n_win, win, methods, n_methods,
+                                     thread_count, message, sizeof(message));
+    CPLFree(methods);
+    CPLFree(win);
+
+    if (prev_threads != NULL) {
+      CPLSetConfigOption("GDAL_NUM_THREADS", prev_threads);
+      CPLFree(prev_threads);
+    } else {
+      CPLSetConfigOption("GDAL_NUM_THREADS", NULL);
+    }
+    GDALClose(ds);
+    if (err != CE_None) {
+      if (message[0] != '\0')
+        error("Failed to refresh overviews for %s: %s", dataset_path, message);
+      error("Failed to refresh overviews for %s", dataset_path);
+    }
+    return path;
+  }
+
   int n_levels = LENGTH(levels);
   int *overview_list = NULL;
 
@@ -76,8 +524,20 @@ SEXP _rgio_overviews(SEXP path, SEXP levels, SEXP resample,
     CPLFree(ovr_copy);
   }
 
-  CPLErr err = GDALBuildOverviews(ds, resample_method, n_levels, overview_list,
-                                  0, NULL, NULL, NULL);
+  CPLErr err;
+  if (cascade_flag) {
+    qsort(overview_list, n_levels, sizeof(int), ovr_cmp_int);
+    int n_methods = LENGTH(resample);
+    const char **methods = (const char **) CPLMalloc(n_levels * sizeof(char *));
+    for (int i = 0; i < n_levels; i++) {
+      methods[i] = CHAR(STRING_ELT(resample, i < n_methods ? i : n_methods - 1));
+    }
+    err = ovr_build_cascade(ds, n_levels, overview_list, methods, thread_count);
+    CPLFree(methods);
+  } else {
+    err = GDALBuildOverviews(ds, resample_method, n_levels, overview_list,
+                             0, NULL, NULL, NULL);
+  }
 
   CPLFree(overview_list);
 
@@ -0,0 +1,331 @@
+/*
+ * pixfun.c
+ * Native VRT pixel functions for derived bands
+ */
+
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/*
+ * The functions below are registered with GDAL under an "rgio_" prefix and
+ * referenced from VRTDerivedRasterBand elements written by rg_vrt_build().
+ * GDAL calls them from its own (possibly worker) threads with one buffer per
+ * source, so they never touch the R API.
+ *
+ * Every source is widened to double once per call, the band is computed
+ * into a double row buffer and GDALCopyWords() converts it to the requested
+ * buffer type and spacing. A source pixel equal to the band nodata value
+ * (GDAL passes it as the built-in "NoData" argument) or NaN is nodata; the
+ * result is then the nodata value, or NaN when the band has none.
+ */
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 4, 0)
+
+#define PF_NODATA_ARG "<Argument type='builtin' value='NoData' />"
+
+typedef struct {
+  int n;                   /* pixels per source */
+  int n_sources;
+  double **src;            /* widened sources */
+  double *out;             /* result, n pixels */
+  int has_nodata;
+  double nodata;
+  double fill;             /* nodata, or NaN */
+} pf_ctx;
+
+static void pf_free(pf_ctx *ctx) {
+  if (ctx->src != NULL) {
+    for (int i = 0; i < ctx->n_sources; i++) VSIFree(ctx->src[i]);
+    VSIFree(ctx->src);
+  }
+  VSIFree(ctx->out);
+}
+
+static CPLErr pf_begin(pf_ctx *ctx, const char *name, void **sources,
+                       int n_sources, int n_expected, int xsize, int ysize,
+                       GDALDataType src_type, CSLConstList args) {
+  memset(ctx, 0, sizeof(*ctx));
+  if (n_sources != n_expected) {
+    CPLError(CE_Failure, CPLE_AppDefined,
+             "%s: expected %d source(s), got %d", name, n_expected, n_sources);
+    return CE_Failure;
+  }
+  ctx->n = xsize * ysize;
+  ctx->n_sources = n_sources;
+  const char *nd = CSLFetchNameValue(args, "NoData");
+  if (nd != NULL && !EQUAL(nd, "NaN")) {
+    ctx->has_nodata = 1;
+    ctx->nodata = CPLAtof(nd);
+  }
+  ctx->fill = ctx->has_nodata ? ctx->nodata : NAN;
+
+  ctx->src = (double **) VSICalloc(n_sources, sizeof(double *));
+  ctx->out = (double *) VSIMalloc2(ctx->n, sizeof(double));
+  if (ctx->src == NULL || ctx->out == NULL) {
+    pf_free(ctx);
+    CPLError(CE_Failure, CPLE_OutOfMemory, "%s: out of memory", name);
+    return CE_Failure;
+  }
+  int src_size = GDALGetDataTypeSizeBytes(src_type);
+  for (int i = 0; i < n_sources; i++) {
+    ctx->src[i] = (double *) VSIMalloc2(ctx->n, sizeof(double));
+    if (ctx->src[i] == NULL) {
+      pf_free(ctx);
+      CPLError(CE_Failure, CPLE_OutOfMemory, "%s: out of memory", name);
+      return CE_Failure;
+    }
+    GDALCopyWords(sources[i], src_type, src_size, ctx->src[i], GDT_Float64,
+                  (int) sizeof(double), ctx->n);
+  }
+  return CE_None;
+}
+
+static CPLErr pf_end(pf_ctx *ctx, void *data, int xsize, int ysize,
+                     GDALDataType buf_type, int pixel_space, int line_space) {
+  for (int y = 0; y < ysize; y++) {
+    GDALCopyWords(ctx->out + (size_t) y * xsize, GDT_Float64,
+                  (int) sizeof(double),
+                  (GByte *) data + (size_t) y * line_space, buf_type,
+                  pixel_space, xsize);
+  }
+  pf_free(ctx);
+  return CE_None;
+}
+
+static inline int pf_is_nodata(const pf_ctx *ctx, double v) {
+  return isnan(v) || (ctx->has_nodata && v == ctx->nodata);
+}
+
+static double pf_arg(CSLConstList args, const char *key, double dflt) {
+  const char *v = CSLFetchNameValue(args, key);
+  return v != NULL ? CPLAtof(v) : dflt;
+}
+
+/* Comma or space separated list of numbers; returns the count */
+static int pf_list(CSLConstList args, const char *key, double **values) {
+  *values = NULL;
+  const char *v = CSLFetchNameValue(args, key);
+  if (v == NULL) return 0;
+  char **tokens = CSLTokenizeString2(v, ", ", 0);
+  int n = CSLCount((CSLConstList) tokens);
+  if (n > 0) {
+    *values = (double *) VSIMalloc2(n, sizeof(double));
+    if (*values == NULL) n = 0;
+    for (int i = 0; i < n; i++) (*values)[i] = CPLAtof(tokens[i]);
+  }
+  CSLDestroy(tokens);
+  return n;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_normdiff: (a - b) / (a + b)                                          */
+/* -------------------------------------------------------------------------- */
+static CPLErr pf_normdiff(void **sources, int n_sources, void *data,
+                          int xsize, int ysize, GDALDataType src_type,
+                          GDALDataType buf_type, int pixel_space,
+                          int line_space, CSLConstList args) {
+  pf_ctx ctx;
+  if (pf_begin(&ctx, "rgio_normdiff", sources, n_sources, 2, xsize, ysize,
+               src_type, args) != CE_None) return CE_Failure;
+  const double *a = ctx.src[0], *b = ctx.src[1];
+  for (int k = 0; k < ctx.n; k++) {
+    double s = a[k] + b[k];
+    ctx.out[k] = (pf_is_nodata(&ctx, a[k]) || pf_is_nodata(&ctx, b[k]) || s == 0)
+      ? ctx.fill : (a[k] - b[k]) / s;
+  }
+  return pf_end(&ctx, data, xsize, ysize, buf_type, pixel_space, line_space);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_scale: x * scale + offset                                            */
+/* -------------------------------------------------------------------------- */
+static CPLErr pf_scale(void **sources, int n_sources, void *data,
+                       int xsize, int ysize, GDALDataType src_type,
+                       GDALDataType buf_type, int pixel_space,
+                       int line_space, CSLConstList args) {
+  pf_ctx ctx;
+  if (pf_begin(&ctx, "rgio_scale", sources, n_sources, 1, xsize, ysize,
+               src_type, args) != CE_None) return CE_Failure;
+  double scale = pf_arg(args, "scale", 1.0), offset = pf_arg(args, "offset", 0.0);
+  const double *x = ctx.src[0];
+  for (int k = 0; k < ctx.n; k++) {
+    ctx.out[k] = pf_is_nodata(&ctx, x[k]) ? ctx.fill : x[k] * scale + offset;
+  }
+  return pf_end(&ctx, data, xsize, ysize, buf_type, pixel_space, line_space);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_clamp: min(max(x, min), max)                                         */
+/* -------------------------------------------------------------------------- */
+static CPLErr pf_clamp(void **sources, int n_sources, void *data,
+                       int xsize, int ysize, GDALDataType src_type,
+                       GDALDataType buf_type, int pixel_space,
+                       int line_space, CSLConstList args) {
+  pf_ctx ctx;
+  if (pf_begin(&ctx, "rgio_clamp", sources, n_sources, 1, xsize, ysize,
+               src_type, args) != CE_None) return CE_Failure;
+  double lo = pf_arg(args, "min", -HUGE_VAL), hi = pf_arg(args, "max", HUGE_VAL);
+  const double *x = ctx.src[0];
+  for (int k = 0; k < ctx.n; k++) {
+    double v = x[k];
+    ctx.out[k] = pf_is_nodata(&ctx, v) ? ctx.fill : (v < lo ? lo : (v > hi ? hi : v));
+  }
+  return pf_end(&ctx, data, xsize, ysize, buf_type, pixel_space, line_space);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_remap: class remapping through from/to lists                         */
+/* -------------------------------------------------------------------------- */
+static int pf_cmp_pair(const void *a, const void *b) {
+  double x = ((const double *) a)[0], y = ((const double *) b)[0];
+  return (x > y) - (x < y);
+}
+
+static CPLErr pf_remap(void **sources, int n_sources, void *data,
+                       int xsize, int ysize, GDALDataType src_type,
+                       GDALDataType buf_type, int pixel_space,
+                       int line_space, CSLConstList args) {
+  double *from = NULL, *to = NULL;
+  int n_from = pf_list(args, "from", &from);
+  int n_to = pf_list(args, "to", &to);
+  if (n_from != n_to) {
+    VSIFree(from);
+    VSIFree(to);
+    CPLError(CE_Failure, CPLE_AppDefined,
+             "rgio_remap: 'from' and 'to' must have the same length");
+    return CE_Failure;
+  }
+  pf_ctx ctx;
+  if (pf_begin(&ctx, "rgio_remap", sources, n_sources, 1, xsize, ysize,
+               src_type, args) != CE_None) {
+    VSIFree(from);
+    VSIFree(to);
+    return CE_Failure;
+  }
+
+  /* interleaved (from, to) pairs sorted by source value */
+  double *pairs = (double *) VSIMalloc2(n_from > 0 ? n_from : 1, 2 * sizeof(double));
+  if (pairs == NULL) {
+    VSIFree(from);
+    VSIFree(to);
+    pf_free(&ctx);
+    CPLError(CE_Failure, CPLE_OutOfMemory, "rgio_remap: out of memory");
+    return CE_Failure;
+  }
+  for (int i = 0; i < n_from; i++) {
+    pairs[2 * i] = from[i];
+    pairs[2 * i + 1] = to[i];
+  }
+  VSIFree(from);
+  VSIFree(to);
+  qsort(pairs, n_from, 2 * sizeof(double), pf_cmp_pair);
+
+  const char *dflt = CSLFetchNameValue(args, "default");
+  int keep = dflt == NULL;
+  double other = keep ? 0 : (EQUAL(dflt, "NoData") ? ctx.fill : CPLAtof(dflt));
+
+  const double *x = ctx.src[0];
+  for (int k = 0; k < ctx.n; k++) {
+    double v = x[k];
+    if (pf_is_nodata(&ctx, v)) {
+      ctx.out[k] = ctx.fill;
+      continue;
+    }
+    int lo = 0, hi = n_from - 1, found = -1;
+    while (lo <= hi) {
+      int mid = (lo + hi) / 2;
+      if (pairs[2 * mid] < v) lo = mid + 1;
+      else if (pairs[2 * mid] > v) hi = mid - 1;
+      else { found = mid; break; }
+    }
+    ctx.out[k] = found >= 0 ? pairs[2 * found + 1] : (keep ? v : other);
+  }
+  VSIFree(pairs);
+  return pf_end(&ctx, data, xsize, ysize, buf_type, pixel_space, line_space);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  rgio_cloudmask: value band masked by a QA band                            */
+/* -------------------------------------------------------------------------- */
+/*
+ * Source 1 is the value band, source 2 a QA or scene classification band.
+ * A pixel is masked when its QA value is one of `values` (e.g. Sentinel-2
+ * SCL classes) or has any of the bits in `bits` set (e.g. Landsat QA_PIXEL).
+ */
+static CPLErr pf_cloudmask(void **sources, int n_sources, void *data,
+                           int xsize, int ysize, GDALDataType src_type,
+                           GDALDataType buf_type, int pixel_space,
+                           int line_space, CSLConstList args) {
+  pf_ctx ctx;
+  if (pf_begin(&ctx, "rgio_cloudmask", sources, n_sources, 2, xsize, ysize,
+               src_type, args) != CE_None) return CE_Failure;
+  double *values = NULL;
+  int n_values = pf_list(args, "values", &values);
+  GUIntBig bits = (GUIntBig) pf_arg(args, "bits", 0);
+
+  const double *x = ctx.src[0], *qa = ctx.src[1];
+  for (int k = 0; k < ctx.n; k++) {
+    int masked = pf_is_nodata(&ctx, x[k]) || isnan(qa[k]);
+    if (!masked && bits != 0 && qa[k] >= 0) {
+      masked = ((GUIntBig) qa[k] & bits) != 0;
+    }
+    for (int i = 0; !masked && i < n_values; i++) {
+      masked = qa[k] == values[i];
+    }
+    ctx.out[k] = masked ? ctx.fill : x[k];
+  }
+  VSIFree(values);
+  return pf_end(&ctx, data, xsize, ysize, buf_type, pixel_space, line_space);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Registration                                                              */
+/* -------------------------------------------------------------------------- */
+int rgio_register_pixel_functions(void) {
+  static int registered = 0;
+  if (registered) return 1;
+  GDALAddDerivedBandPixelFuncWithArgs(
+    "rgio_normdiff", pf_normdiff,
+    "<PixelFunctionArgumentsList>" PF_NODATA_ARG "</PixelFunctionArgumentsList>");
+  GDALAddDerivedBandPixelFuncWithArgs(
+    "rgio_scale", pf_scale,
+    "<PixelFunctionArgumentsList>"
+    "<Argument name='scale' type='double' default='1' />"
+    "<Argument name='offset' type='double' default='0' />"
+    PF_NODATA_ARG "</PixelFunctionArgumentsList>");
+  GDALAddDerivedBandPixelFuncWithArgs(
+    "rgio_clamp", pf_clamp,
+    "<PixelFunctionArgumentsList>"
+    "<Argument name='min' type='double' />"
+    "<Argument name='max' type='double' />"
+    PF_NODATA_ARG "</PixelFunctionArgumentsList>");
+  GDALAddDerivedBandPixelFuncWithArgs(
+    "rgio_remap", pf_remap,
+    "<PixelFunctionArgumentsList>"
+    "<Argument name='from' type='string' />"
+    "<Argument name='to' type='string' />"
+    "<Argument name='default' type='string' />"
+    PF_NODATA_ARG "</PixelFunctionArgumentsList>");
+  GDALAddDerivedBandPixelFuncWithArgs(
+    "rgio_cloudmask", pf_cloudmask,
+    "<PixelFunctionArgumentsList>"
+    "<Argument name='values' type='string' />"
+    "<Argument name='bits' type='integer' default='0' />"
+    PF_NODATA_ARG "</PixelFunctionArgumentsList>");
+  registered = 1;
+  return 1;
+}
+
+#else
+
+/* Pixel functions with arguments need GDAL >= 3.4 */
+int rgio_register_pixel_functions(void) {
+  return 0;
+}
+
+#endif
@@ -5,8 +5,15 @@
  * Architecture:
  *   R front-end -> .Call("_rgio_rz", ...) -> this C entrypoint -> internal helpers
  *
- * Remaining TODOs:
- * - loop is still serial; parallelization can be added later at higher level
+ * A coverage mode burns the exact fraction of every cell covered by
+ * polygons instead of burn values.
+ *
+ * Features can be restricted with an attribute filter or an SQL statement,
+ * both evaluated by the driver so indexed formats skip non-matching rows.
+ *
+ * Layers whose CRS differs from the target CRS are reprojected while they
+ * are burned (no intermediate ogr2ogr output). Transformations are cached
+ * per distinct source CRS for the duration of a call.
  */
 
 #include <R.h>
@@ -14,6 +21,7 @@
 #include <gdal.h>
 #include <gdal_alg.h>
 #include <ogr_api.h>
+#include <ogr_srs_api.h>
 #include <cpl_conv.h>
 #include <cpl_string.h>
 #include <math.h>
@@ -21,6 +29,523 @@
 
 #include "gdal_utils.h"
 
+/* Number of points sampled along each edge when reprojecting an extent */
+#define RZ_DENSIFY_POINTS 21
+
+/* Features collected per GDALRasterizeGeometries() call in multi-field mode */
+#define RZ_BATCH_FEATURES 4096
+
+/* Accumulator memory per row chunk in coverage-fraction mode */
+#define RZ_COVERAGE_CHUNK_BYTES (256.0 * 1024 * 1024)
+
+/* -------------------------------------------------------------------------- */
+/*  Coordinate transformation cache                                           */
+/* -------------------------------------------------------------------------- */
+/*
+ * One entry per distinct source CRS seen during a call. Layers whose CRS
+ * matches the target (or that carry no CRS at all) get an entry with NULL
+ * transformations so the OSRIsSame() check is not repeated either.
+ */
+typedef struct {
+  char *src_wkt;
+  OGRCoordinateTransformationH fwd;  /* layer CRS -> target CRS */
+  OGRCoordinateTransformationH inv;  /* target CRS -> layer CRS */
+} rz_ct_entry;
+
+typedef struct {
+  OGRSpatialReferenceH dst_srs;
+  rz_ct_entry *entries;
+  int count;
+} rz_ct_cache;
+
+static void rz_ct_cache_init(rz_ct_cache *cache, const char *target_crs) {
+  cache->dst_srs = NULL;
+  cache->entries = NULL;
+  cache->count = 0;
+
+  if (target_crs == NULL || target_crs[0] == '\0') return;
+
+  cache->dst_srs = OSRNewSpatialReference(NULL);
+  if (OSRSetFromUserInput(cache->dst_srs, target_crs) != OGRERR_NONE) {
+    OSRDestroySpatialReference(cache->dst_srs);
+    cache->dst_srs = NULL;
+    return;
+  }
+  OSRSetAxisMappingStrategy(cache->dst_srs, OAMS_TRADITIONAL_GIS_ORDER);
+}
+
+static void rz_ct_cache_free(rz_ct_cache *cache) {
+  for (int i = 0; i < cache->count; i++) {
+    CPLFree(cache->entries[i].src_wkt);
+    if (cache->entries[i].fwd) OCTDestroyCoordinateTransformation(cache->entries[i].fwd);
+    if (cache->entries[i].inv) OCTDestroyCoordinateTransformation(cache->entries[i].inv);
+  }
+  CPLFree(cache->entries);
+  if (cache->dst_srs) OSRDestroySpatialReference(cache->dst_srs);
+  cache->entries = NULL;
+  cache->count = 0;
+  cache->dst_srs = NULL;
+}
+
+/*
+ * Return the cached transformation pair for the layer's CRS, creating it on
+ * first use. Returns NULL when no reprojection is required.
+ */
+static const rz_ct_entry *rz_ct_cache_get(rz_ct_cache *cache, OGRLayerH layer) {
+  if (cache->dst_srs == NULL) return NULL;
+
+  OGRSpatialReferenceH layer_srs = OGR_L_GetSpatialRef(layer);
+  if (layer_srs == NULL) return NULL;
+
+  char *wkt = NULL;
+  if (OSRExportToWkt(layer_srs, &wkt) != OGRERR_NONE || wkt == NULL) {
+    CPLFree(wkt);
+    return NULL;
+  }
+
+  for (int i = 0; i < cache->count; i++) {
+    if (strcmp(cache->entries[i].src_wkt, wkt) == 0) {
+      CPLFree(wkt);
+      return cache->entries[i].fwd ? &cache->entries[i] : NULL;
+    }
+  }
+
+  rz_ct_entry entry = {wkt, NULL, NULL};
+  if (!OSRIsSame(layer_srs, cache->dst_srs)) {
+    OGRSpatialReferenceH src_srs = OSRClone(layer_srs);
+    OSRSetAxisMappingStrategy(src_srs, OAMS_TRADITIONAL_GIS_ORDER);
+    entry.fwd = OCTNewCoordinateTransformation(src_srs, cache->dst_srs);
+    entry.inv = OCTNewCoordinateTransformation(cache->dst_srs, src_srs);
+    OSRDestroySpatialReference(src_srs);
+  }
+
+  cache->entries = (rz_ct_entry *) CPLRealloc(
+    cache->entries, (cache->count + 1) * sizeof(rz_ct_entry));
+  cache->entries[cache->count++] = entry;
+
+  return entry.fwd ? &cache->entries[cache->count - 1] : NULL;
+}
+
+/*
+ * Reproject an envelope by sampling RZ_DENSIFY_POINTS points along each
+ * edge, so curved edges in the target CRS are fully covered.
+ */
+static int rz_transform_extent(OGRCoordinateTransformationH ct,
+                               const OGREnvelope *extent, double *bbox) {
+  const int n_edge = RZ_DENSIFY_POINTS;
+  const int n = 4 * n_edge;
+  double *x = (double *) CPLMalloc(n * sizeof(double));
+  double *y = (double *) CPLMalloc(n * sizeof(double));
+  int *ok = (int *) CPLMalloc(n * sizeof(int));
+
+  for (int i = 0; i < n_edge; i++) {
+    double f = (double) i / (n_edge - 1);
+    double xs = extent->MinX + f * (extent->MaxX - extent->MinX);
+    double ys = extent->MinY + f * (extent->MaxY - extent->MinY);
+    x[i]              = xs;            y[i]              = extent->MinY;
+    x[i + n_edge]     = xs;            y[i + n_edge]     = extent->MaxY;
+    x[i + 2 * n_edge] = extent->MinX;  y[i + 2 * n_edge] = ys;
+    x[i + 3 * n_edge] = extent->MaxX;  y[i + 3 * n_edge] = ys;
+  }
+
+  OCTTransformEx(ct, n, x, y, NULL, ok);
+
+  int n_ok = 0;
+  for (int i = 0; i < n; i++) {
+    if (!ok[i] || !isfinite(x[i]) || !isfinite(y[i])) continue;
+    if (n_ok == 0) {
+      bbox[0] = bbox[2] = x[i];
+      bbox[1] = bbox[3] = y[i];
+    } else {
+      if (x[i] < bbox[0]) bbox[0] = x[i];
+      if (y[i] < bbox[1]) bbox[1] = y[i];
+      if (x[i] > bbox[2]) bbox[2] = x[i];
+      if (y[i] > bbox[3]) bbox[3] = y[i];
+    }
+    n_ok++;
+  }
+
+  CPLFree(x);
+  CPLFree(y);
+  CPLFree(ok);
+  return n_ok > 0;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Geometry -> pixel/line transformer                                        */
+/* -------------------------------------------------------------------------- */
+/*
+ * GDALTransformerFunc handed to GDALRasterizeLayers(): reprojects layer
+ * coordinates with the cached transformation and then maps them onto the
+ * output raster grid.
+ */
+typedef struct {
+  OGRCoordinateTransformationH fwd;
+  OGRCoordinateTransformationH inv;
+  double gt[6];
+  double inv_gt[6];
+} rz_transform_arg;
+
+static int rz_transform(void *arg, int dst_to_src, int n,
+                        double *x, double *y, double *z, int *ok) {
+  rz_transform_arg *t = (rz_transform_arg *) arg;
+
+  if (!dst_to_src) {
+    OCTTransformEx(t->fwd, n, x, y, z, ok);
+    for (int i = 0; i < n; i++) {
+      if (ok != NULL && !ok[i]) continue;
+      double gx = x[i], gy = y[i];
+      x[i] = t->inv_gt[0] + gx * t->inv_gt[1] + gy * t->inv_gt[2];
+      y[i] = t->inv_gt[3] + gx * t->inv_gt[4] + gy * t->inv_gt[5];
+    }
+  } else {
+    for (int i = 0; i < n; i++) {
+      double px = x[i], py = y[i];
+      x[i] = t->gt[0] + px * t->gt[1] + py * t->gt[2];
+      y[i] = t->gt[3] + px * t->gt[4] + py * t->gt[5];
+    }
+    OCTTransformEx(t->inv, n, x, y, z, ok);
+  }
+
+  return TRUE;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Multi-field burn                                                          */
+/* -------------------------------------------------------------------------- */
+/*
+ * Burn several attributes into bands 1..n_fields during a single traversal
+ * of the layer. Geometries are collected in batches of RZ_BATCH_FEATURES
+ * together with one burn value per band and handed to
+ * GDALRasterizeGeometries(). field_idx[b] < 0 burns the constant burn_val
+ * into band b + 1.
+ */
+static CPLErr rz_burn_fields(GDALDatasetH raster_ds, OGRLayerH layer,
+                             const int *field_idx, int n_fields,
+                             double burn_val,
+                             GDALTransformerFunc transformer, void *transform_arg,
+                             char **opts) {
+  int *band_list = (int *) CPLMalloc(n_fields * sizeof(int));
+  for (int b = 0; b < n_fields; b++) band_list[b] = b + 1;
+
+  OGRGeometryH *geoms = (OGRGeometryH *) CPLMalloc(RZ_BATCH_FEATURES * sizeof(OGRGeometryH));
+  double *values = (double *) CPLMalloc((size_t) RZ_BATCH_FEATURES * n_fields * sizeof(double));
+
+  CPLErr err = CE_None;
+  int n_batch = 0;
+  OGRFeatureH feat;
+
+  OGR_L_ResetReading(layer);
+  while (err == CE_None) {
+    feat = OGR_L_GetNextFeature(layer);
+    if (feat != NULL) {
+      OGRGeometryH geom = OGR_F_StealGeometry(feat);
+      if (geom != NULL) {
+        geoms[n_batch] = geom;
+        for (int b = 0; b < n_fields; b++) {
+          values[(size_t) n_batch * n_fields + b] =
+            field_idx[b] >= 0 ? OGR_F_GetFieldAsDouble(feat, field_idx[b]) : burn_val;
+        }
+        n_batch++;
+      }
+      OGR_F_Destroy(feat);
+    }
+
+    if (n_batch > 0 && (feat == NULL || n_batch == RZ_BATCH_FEATURES)) {
+      err = GDALRasterizeGeometries(raster_ds, n_fields, band_list, n_batch,
+                                    geoms, transformer, transform_arg,
+                                    values, (const char *const *) opts,
+                                    NULL, NULL);
+      for (int g = 0; g < n_batch; g++) OGR_G_DestroyGeometry(geoms[g]);
+      n_batch = 0;
+    }
+    if (feat == NULL) break;
+  }
+
+  for (int g = 0; g < n_batch; g++) OGR_G_DestroyGeometry(geoms[g]);
+  CPLFree(values);
+  CPLFree(geoms);
+  CPLFree(band_list);
+  return err;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Coverage-fraction burn                                                    */
+/* -------------------------------------------------------------------------- */
+/*
+ * Exact fraction of each cell covered by polygons, computed in one pass at
+ * the target resolution. By Green's theorem the area of a polygon inside
+ * cell (r, c) is the boundary integral of clamp(x - c, 0, 1) dy over the
+ * part of the boundary lying in row r, so every ring edge is split at the
+ * grid lines it crosses and each piece adds
+ *   - (x_mid - c) * dy to the cell it lies in, and
+ *   - dy to every cell of the row left of it.
+ * The second term is kept as a per-row suffix array and resolved with one
+ * backwards sweep. Coordinates are in pixel/line space; rows are processed
+ * in chunks [r0, r1) so the accumulators stay within
+ * RZ_COVERAGE_CHUNK_BYTES. Overlapping polygons are clamped to 1.
+ */
+typedef struct {
+  int width;
+  int r0, r1;
+  double *part;  /* (r1 - r0) * width      in-cell contributions */
+  double *suf;   /* (r1 - r0) * (width + 1) whole-cell contributions */
+} rz_cov_acc;
+
+static void rz_cov_add(rz_cov_acc *acc, int row, double xm, double dy) {
+  if (xm < 0.0) return;
+  double *suf = acc->suf + (size_t) row * (acc->width + 1);
+  if (xm >= acc->width) {
+    suf[acc->width] += dy;
+    return;
+  }
+  int c = (int) floor(xm);
+  acc->part[(size_t) row * acc->width + c] += (xm - c) * dy;
+  suf[c] += dy;
+}
+
+/* Piece of an edge inside one row: split it at the column lines */
+static void rz_cov_row_piece(rz_cov_acc *acc, int row,
+                             double x1, double x2, double dy) {
+  double lo = x1 < x2 ? x1 : x2;
+  double hi = x1 < x2 ? x2 : x1;
+  double span = hi - lo;
+
+  if (span <= 0.0) {
+    rz_cov_add(acc, row, lo, dy);
+    return;
+  }
+
+  double u = lo;
+  while (u < hi) {
+    double v;
+    if (u < 0.0) {
+      v = hi < 0.0 ? hi : 0.0;
+    } else if (u >= acc->width) {
+      v = hi;
+    } else {
+      v = floor(u) + 1.0;
+      if (v > hi) v = hi;
+    }
+    if (v <= u) break;
+    rz_cov_add(acc, row, 0.5 * (u + v), dy * (v - u) / span);
+    u = v;
+  }
+}
+
+/* Ring edge (xa, ya) -> (xb, yb): split it at the row lines of the chunk */
+static void rz_cov_edge(rz_cov_acc *acc, double xa, double ya,
+                        double xb, double yb, double sign) {
+  if (ya == yb) return;
+
+  double lo = ya < yb ? ya : yb;
+  double hi = ya < yb ? yb : ya;
+  if (hi <= acc->r0 || lo >= acc->r1) return;
+  if (lo < acc->r0) lo = acc->r0;
+  if (hi > acc->r1) hi = acc->r1;
+
+  double slope = (xb - xa) / (yb - ya);
+  double dir = (yb > ya ? 1.0 : -1.0) * sign;
+
+  for (int r = (int) floor(lo); r < hi; r++) {
+    double y_s = r > lo ? r : lo;
+    double y_e = r + 1 < hi ? r + 1 : hi;
+    if (y_e <= y_s) continue;
+    rz_cov_row_piece(acc, r - acc->r0,
+                     xa + (y_s - ya) * slope,
+                     xa + (y_e - ya) * slope,
+                     (y_e - y_s) * dir);
+  }
+}
+
+/* Add one ring; exterior rings count positively, holes negatively */
+static void rz_cov_ring(rz_cov_acc *acc, OGRGeometryH ring, int is_hole,
+                        GDALTransformerFunc transformer, void *transform_arg,
+                        const double *inv_gt) {
+  int n = OGR_G_GetPointCount(ring);
+  if (n < 3) return;
+
+  double *x = (double *) CPLMalloc(n * sizeof(double));
+  double *y = (double *) CPLMalloc(n * sizeof(double));
+  for (int i = 0; i < n; i++) {
+    double z;
+    OGR_G_GetPoint(ring, i, &x[i], &y[i], &z);
+  }
+
+  int ok_all = 1;
+  if (transformer != NULL) {
+    int *ok = (int *) CPLMalloc(n * sizeof(int));
+    transformer(transform_arg, FALSE, n, x, y, NULL, ok);
+    for (int i = 0; i < n; i++) {
+      if (!ok[i]) ok_all = 0;
+    }
+    CPLFree(ok);
+  } else {
+    for (int i = 0; i < n; i++) {
+      double gx = x[i], gy = y[i];
+      x[i] = inv_gt[0] + gx * inv_gt[1] + gy * inv_gt[2];
+      y[i] = inv_gt[3] + gx * inv_gt[4] + gy * inv_gt[5];
+    }
+  }
+
+  if (ok_all) {
+    /* Orientation from the same boundary integral (closing edge included) */
+    double area = 0.0;
+    for (int i = 0; i < n; i++) {
+      int j = (i + 1) % n;
+      area += 0.5 * (x[i] + x[j]) * (y[j] - y[i]);
+    }
+    if (area != 0.0) {
+      double sign = (area > 0.0 ? 1.0 : -1.0) * (is_hole ? -1.0 : 1.0);
+      for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        rz_cov_edge(acc, x[i], y[i], x[j], y[j], sign);
+      }
+    }
+  }
+
+  CPLFree(x);
+  CPLFree(y);
+}
+
+static void rz_cov_geometry(rz_cov_acc *acc, OGRGeometryH geom,
+                            GDALTransformerFunc transformer, void *transform_arg,
+                            const double *inv_gt) {
+  OGRwkbGeometryType type = wkbFlatten(OGR_G_GetGeometryType(geom));
+  if (type == wkbPolygon) {
+    int n_rings = OGR_G_GetGeometryCount(geom);
+    for (int k = 0; k < n_rings; k++) {
+      rz_cov_ring(acc, OGR_G_GetGeometryRef(geom, k), k > 0,
+                  transformer, transform_arg, inv_gt);
+    }
+  } else if (type == wkbMultiPolygon || type == wkbGeometryCollection) {
+    int n_parts = OGR_G_GetGeometryCount(geom);
+    for (int k = 0; k < n_parts; k++) {
+      rz_cov_geometry(acc, OGR_G_GetGeometryRef(geom, k),
+                      transformer, transform_arg, inv_gt);
+    }
+  }
+}
+
+/*
+ * Burn coverage fractions into band 1. Byte output is scaled to 0-255 (with
+ * a 1/255 band scale), floating types receive fractions in [0, 1].
+ * When the layer is in the raster CRS each row chunk sets a spatial filter,
+ * so only intersecting features are read.
+ */
+static CPLErr rz_burn_coverage(GDALDatasetH raster_ds, OGRLayerH layer,
+                               GDALTransformerFunc transformer, void *transform_arg) {
+  int width  = GDALGetRasterXSize(raster_ds);
+  int height = GDALGetRasterYSize(raster_ds);
+  GDALRasterBandH band = GDALGetRasterBand(raster_ds, 1);
+  int scaled = GDALGetRasterDataType(band) == GDT_Byte;
+
+  double gt[6], inv_gt[6];
+  GDALGetGeoTransform(raster_ds, gt);
+  GDALInvGeoTransform(gt, inv_gt);
+
+  double row_bytes = (2.0 * width + 1.0) * sizeof(double);
+  int chunk_rows = (int) (RZ_COVERAGE_CHUNK_BYTES / row_bytes);
+  if (chunk_rows < 1) chunk_rows = 1;
+  if (chunk_rows > height) chunk_rows = height;
+
+  rz_cov_acc acc;
+  acc.width = width;
+  acc.part = (double *) CPLMalloc((size_t) chunk_rows * width * sizeof(double));
+  acc.suf  = (double *) CPLMalloc((size_t) chunk_rows * (width + 1) * sizeof(double));
+  double *out = (double *) CPLMalloc((size_t) width * sizeof(double));
+
+  CPLErr err = CE_None;
+  for (int r0 = 0; r0 < height && err == CE_None; r0 += chunk_rows) {
+    acc.r0 = r0;
+    acc.r1 = r0 + chunk_rows < height ? r0 + chunk_rows : height;
+    int n_rows = acc.r1 - acc.r0;
+    memset(acc.part, 0, (size_t) n_rows * width * sizeof(double));
+    memset(acc.suf, 0, (size_t) n_rows * (width + 1) * sizeof(double));
+
+    if (transformer == NULL && chunk_rows < height) {
+      double y_a = gt[3] + acc.r0 * gt[5];
+      double y_b = gt[3] + acc.r1 * gt[5];
+      OGR_L_SetSpatialFilterRect(layer, gt[0], y_a < y_b ? y_a : y_b,
+                                 gt[0] + width * gt[1], y_a < y_b ? y_b : y_a);
+    }
+
+    OGR_L_ResetReading(layer);
+    OGRFeatureH feat;
+    while ((feat = OGR_L_GetNextFeature(layer)) != NULL) {
+      OGRGeometryH geom = OGR_F_GetGeometryRef(feat);
+      if (geom != NULL)
+        rz_cov_geometry(&acc, geom, transformer, transform_arg, inv_gt);
+      OGR_F_Destroy(feat);
+    }
+
+    for (int r = 0; r < n_rows && err == CE_None; r++) {
+      const double *part = acc.part + (size_t) r * width;
+      const double *suf  = acc.suf + (size_t) r * (width + 1);
+      double run = 0.0;
+      for (int c = width - 1; c >= 0; c--) {
+        run += suf[c + 1];
+        double f = part[c] + run;
+        if (f < 0.0) f = 0.0;
+        if (f > 1.0) f = 1.0;
+        out[c] = scaled ? floor(f * 255.0 + 0.5) : f;
+      }
+      err = GDALRasterIO(band, GF_Write, 0, acc.r0 + r, width, 1,
+                         out, width, 1, GDT_Float64, 0, 0);
+    }
+  }
+
+  if (transformer == NULL && chunk_rows < height)
+    OGR_L_SetSpatialFilter(layer, NULL);
+
+  if (scaled) GDALSetRasterScale(band, 1.0 / 255.0);
+  GDALSetDescription(band, "coverage");
+
+  CPLFree(out);
+  CPLFree(acc.suf);
+  CPLFree(acc.part);
+  return err;
+}
+
+/*
+ * Extent of the features passing the layer's attribute filter. Drivers may
+ * answer OGR_L_GetExtent() from a header or index that ignores the filter,
+ * so filtered layers are scanned instead.
+ */
+static OGRErr rz_layer_extent(OGRLayerH layer, int filtered, OGREnvelope *extent) {
+  if (!filtered) return OGR_L_GetExtent(layer, extent, TRUE);
+
+  int n = 0;
+  OGRFeatureH feat;
+  OGR_L_ResetReading(layer);
+  while ((feat = OGR_L_GetNextFeature(layer)) != NULL) {
+    OGRGeometryH geom = OGR_F_GetGeometryRef(feat);
+    if (geom != NULL && !OGR_G_IsEmpty(geom)) {
+      OGREnvelope env;
+      OGR_G_GetEnvelope(geom, &env);
+      if (n++ == 0) {
+        *extent = env;
+      } else {
+        if (env.MinX < extent->MinX) extent->MinX = env.MinX;
+        if (env.MinY < extent->MinY) extent->MinY = env.MinY;
+        if (env.MaxX > extent->MaxX) extent->MaxX = env.MaxX;
+        if (env.MaxY > extent->MaxY) extent->MaxY = env.MaxY;
+      }
+    }
+    OGR_F_Destroy(feat);
+  }
+  OGR_L_ResetReading(layer);
+  return n > 0 ? OGRERR_NONE : OGRERR_FAILURE;
+}
+
+/*
+ * Release the SQL result set (if any) before closing the vector dataset.
+ */
+static void rz_close_vector(GDALDatasetH vec_ds, OGRLayerH sql_layer) {
+  if (sql_layer != NULL) GDALDatasetReleaseResultSet(vec_ds, sql_layer);
+  GDALClose(vec_ds);
+}
+
 /*
  * _rgio_rz
  * Rasterize vector layers (e.g. shapefiles, GeoJSON) into rasters (GTiff or COG)
@@ -29,95 +554,158 @@
  *  files   - character vector of vector file paths
  *  outdir  - output directory for rasters
  *  value   - numeric constant burn value (used if field missing)
- *  field   - character string, name of attribute to burn (optional)
+ *  field   - character vector of attributes to burn (optional); more than
+ *            one field produces one band per field in a single pass
  *  res     - numeric vector of length 2 (xres, yres)
- *  crs     - character string (CRS, e.g. "EPSG:4326")
+ *  crs     - character string (CRS, e.g. "EPSG:4326"); layers in another
+ *            CRS are reprojected on the fly
  *  nodata  - integer or numeric nodata value
  *  dtype   - character string (GDAL type, e.g. "Byte", "UInt16", "Float32")
- *  format  - character string (output driver, e.g. "GTiff" or "COG")
+ *  format  - character string (output driver, e.g. "GTiff" or "COG");
+ *            CreateCopy-only drivers are burned into a stage (MEM when it
+ *            fits) and copied, see rgio_output_create()
  *  ro      - character vector (rasterize options)
  *  co      - character vector (creation options)
  *  threads - integer number of threads (currently unused)
+ *  where   - character string, attribute filter applied to the first layer
+ *            ("" for none)
+ *  sql     - character string, SQL statement whose result set is burned
+ *            instead of the first layer ("" for none)
+ *  coverage - logical; burn the exact fraction of each cell covered by
+ *            polygons instead of attribute/constant values
  *
  * Returns:
- *  Character vector of output file paths
+ *  Character vector of output file paths. For CreateCopy-only drivers it
+ *  carries the attributes "bytes_saved" (intermediate raster bytes that never
+ *  reached disk) and "elapsed" (seconds spent per file).
  */
 SEXP _rgio_rz(SEXP files, SEXP outdir, SEXP value, SEXP field,
               SEXP res, SEXP crs, SEXP nodata, SEXP dtype,
-              SEXP format, SEXP ro, SEXP co, SEXP threads)
+              SEXP format, SEXP ro, SEXP co, SEXP threads,
+              SEXP where, SEXP sql, SEXP coverage)
 {
   GDALAllRegister();
   OGRRegisterAll();
 
   int n_files = Rf_length(files);
+  int coverage_mode = LOGICAL(coverage)[0];
+  int n_fields = coverage_mode ? 1 : Rf_length(field);
+  if (n_fields < 1) n_fields = 1;
   const char *output_dir = CHAR(STRING_ELT(outdir, 0));
-  const char *field_name = CHAR(STRING_ELT(field, 0));
+  const char *field_name = Rf_length(field) > 0 ? CHAR(STRING_ELT(field, 0)) : "";
   const char *target_crs = CHAR(STRING_ELT(crs, 0));
   const char *dtype_str  = CHAR(STRING_ELT(dtype, 0));
   const char *format_str = CHAR(STRING_ELT(format, 0));
+  const char *where_str  = CHAR(STRING_ELT(where, 0));
+  const char *sql_str    = CHAR(STRING_ELT(sql, 0));
   double *resolution = REAL(res);
   double xres = resolution[0];
   double yres = resolution[1];
   int nodata_val = INTEGER(nodata)[0];
   double burn_val = (value != R_NilValue) ? REAL(value)[0] : 1.0;
 
+  if (GDALGetDriverByName(format_str) == NULL) {
+    error("Driver not found: %s", format_str);
+  }
+  int fused = 0;  /* CreateCopy-only driver, set from the first output */
+
   /* Build creation options */
   char **create_opts = NULL;
-  for (int i = 0; i < Rf_length(co); i++)
+  for (int i = 0; i < Rf_length(co); i++) {
     create_opts = CSLAddString(create_opts, CHAR(STRING_ELT(co, i)));
+  }
+
+  rz_ct_cache ct_cache;
+  rz_ct_cache_init(&ct_cache, target_crs);
 
   SEXP output_paths = PROTECT(Rf_allocVector(STRSXP, n_files));
+  SEXP bytes_saved  = PROTECT(Rf_allocVector(REALSXP, n_files));
+  SEXP elapsed      = PROTECT(Rf_allocVector(REALSXP, n_files));
 
   for (int i = 0; i < n_files; i++) {
     const char *input_file = CHAR(STRING_ELT(files, i));
+    double t_start = rgio_elapsed_seconds();
 
     GDALDatasetH vec_ds = GDALOpenEx(input_file, GDAL_OF_VECTOR, NULL, NULL, NULL);
     if (vec_ds == NULL) {
+      rz_ct_cache_free(&ct_cache);
       CSLDestroy(create_opts);
       error("Failed to open vector file: %s", input_file);
     }
 
-    OGRLayerH layer = GDALDatasetGetLayer(vec_ds, 0);
+    /* Select features: SQL result set, or first layer with attribute filter */
+    OGRLayerH sql_layer = NULL;
+    OGRLayerH layer = NULL;
+    if (sql_str[0] != '\0') {
+      sql_layer = GDALDatasetExecuteSQL(vec_ds, sql_str, NULL, NULL);
+      layer = sql_layer;
+    } else {
+      layer = GDALDatasetGetLayer(vec_ds, 0);
+    }
     if (layer == NULL) {
       GDALClose(vec_ds);
+      rz_ct_cache_free(&ct_cache);
       CSLDestroy(create_opts);
+      if (sql_str[0] != '\0')
+        error("SQL statement returned no layer for file: %s", input_file);
       error("No layer found in file: %s", input_file);
     }
+    if (sql_layer == NULL && where_str[0] != '\0' &&
+        OGR_L_SetAttributeFilter(layer, where_str) != OGRERR_NONE) {
+      GDALClose(vec_ds);
+      rz_ct_cache_free(&ct_cache);
+      CSLDestroy(create_opts);
+      error("Invalid attribute filter '%s' for file: %s", where_str, input_file);
+    }
 
-    /* Compute extent */
+    /* Compute extent, of the filtered features only */
     OGREnvelope extent;
-    if (OGR_L_GetExtent(layer, &extent, TRUE) != OGRERR_NONE) {
-      GDALClose(vec_ds);
+    if (rz_layer_extent(layer, sql_layer == NULL && where_str[0] != '\0',
+                        &extent) != OGRERR_NONE) {
+      rz_close_vector(vec_ds, sql_layer);
+      rz_ct_cache_free(&ct_cache);
       CSLDestroy(create_opts);
       error("Failed to get extent for file: %s", input_file);
     }
 
     double bbox[4] = {extent.MinX, extent.MinY, extent.MaxX, extent.MaxY};
+
+    /* Reproject extent when the layer is not in the target CRS */
+    const rz_ct_entry *ct = rz_ct_cache_get(&ct_cache, layer);
+    if (ct != NULL && !rz_transform_extent(ct->fwd, &extent, bbox)) {
+      rz_close_vector(vec_ds, sql_layer);
+      rz_ct_cache_free(&ct_cache);
+      CSLDestroy(create_opts);
+      error("Failed to reproject extent for file: %s", input_file);
+    }
+
     const char *base_name = CPLGetBasename(input_file);
     char output_file[4096];
     snprintf(output_file, sizeof(output_file), "%s/%s.tif", output_dir, base_name);
 
-    /* Create output raster */
-    GDALDatasetH raster_ds = create_raster_dataset(
-      output_file,
-      format_str,
-      dtype_str,
-      bbox,
-      0, 0, xres, yres,
-      target_crs,
-      1,
-      create_opts
-    );
-    if (raster_ds == NULL) {
-      GDALClose(vec_ds);
+    /* Create output raster (staged when the driver is CreateCopy-only) */
+    double out_gt[6] = {bbox[0], xres, 0.0, bbox[3], 0.0, -yres};
+    rgio_output out;
+    int created = rgio_output_create(&out, output_file, format_str, dtype_str, out_gt,
+                                     (int) ceil((bbox[2] - bbox[0]) / xres),
+                                     (int) ceil((bbox[3] - bbox[1]) / yres),
+                                     target_crs, n_fields, create_opts);
+    GDALDatasetH raster_ds = out.ds;
+    fused = out.staged;
+    REAL(bytes_saved)[i] = out.mem_bytes;
+    if (!created) {
+      rz_close_vector(vec_ds, sql_layer);
+      rz_ct_cache_free(&ct_cache);
       CSLDestroy(create_opts);
       error("Failed to create output raster: %s", output_file);
     }
 
-    /* Initialize raster */
-    GDALRasterBandH band = GDALGetRasterBand(raster_ds, 1);
-    GDALSetRasterNoDataValue(band, (double)nodata_val);
-    GDALFillRaster(band, (double)nodata_val, 0.0);
+    /* Initialize raster (every cell is written in coverage mode) */
+    for (int b = 0; b < n_fields && !coverage_mode; b++) {
+      GDALRasterBandH band = GDALGetRasterBand(raster_ds, b + 1);
+      GDALSetRasterNoDataValue(band, (double)nodata_val);
+      GDALFillRaster(band, (double)nodata_val, 0.0);
+    }
 
     /* Check if field exists */
     int field_exists = 0;
@@ -141,33 +729,80 @@ SEXP _rgio_rz(SEXP files, SEXP outdir, SEXP value, SEXP field,
     int band_list[1] = {1};
     OGRLayerH layers[1] = {layer};
 
+    /* On-the-fly reprojection */
+    GDALTransformerFunc transformer = NULL;
+    rz_transform_arg transform_arg;
+    if (ct != NULL) {
+      transform_arg.fwd = ct->fwd;
+      transform_arg.inv = ct->inv;
+      GDALGetGeoTransform(raster_ds, transform_arg.gt);
+      GDALInvGeoTransform(transform_arg.gt, transform_arg.inv_gt);
+      transformer = rz_transform;
+    }
+
     /* Perform rasterization */
     CPLErr err;
-    if (field_exists) {
+    if (coverage_mode) {
+      err = rz_burn_coverage(raster_ds, layer, transformer,
+                             ct ? &transform_arg : NULL);
+    } else if (n_fields > 1) {
+      int *field_idx = (int *) CPLMalloc(n_fields * sizeof(int));
+      char **geom_opts = NULL;
+      for (int b = 0; b < n_fields; b++) {
+        const char *name = CHAR(STRING_ELT(field, b));
+        field_idx[b] = OGR_FD_GetFieldIndex(defn, name);
+        GDALSetDescription(GDALGetRasterBand(raster_ds, b + 1), name);
+      }
+      for (int j = 0; j < Rf_length(ro); j++) {
+        const char *opt = CHAR(STRING_ELT(ro, j));
+        if (!EQUALN(opt, "ATTRIBUTE=", 10))
+          geom_opts = CSLAddString(geom_opts, opt);
+      }
+      err = rz_burn_fields(raster_ds, layer, field_idx, n_fields, burn_val,
+                           transformer, ct ? &transform_arg : NULL, geom_opts);
+      CSLDestroy(geom_opts);
+      CPLFree(field_idx);
+    } else if (field_exists) {
       err = GDALRasterizeLayers(raster_ds, 1, band_list, 1, layers,
-                                NULL, NULL, NULL, rasterize_opts, NULL, NULL);
+                                transformer, ct ? &transform_arg : NULL,
+                                NULL, rasterize_opts, NULL, NULL);
     } else {
       err = GDALRasterizeLayers(raster_ds, 1, band_list, 1, layers,
-                                NULL, NULL, burn_values, NULL, NULL, NULL);
+                                transformer, ct ? &transform_arg : NULL,
+                                burn_values, NULL, NULL, NULL);
     }
 
     CSLDestroy(rasterize_opts);
 
     if (err != CE_None) {
-      GDALClose(raster_ds);
-      GDALClose(vec_ds);
+      rgio_output_finish(&out, 0);
+      rz_close_vector(vec_ds, sql_layer);
+      rz_ct_cache_free(&ct_cache);
       CSLDestroy(create_opts);
       error("Rasterization failed for %s", input_file);
     }
 
     GDALSetMetadataItem(raster_ds, "AREA_OR_POINT", "Area", NULL);
-    GDALClose(raster_ds);
-    GDALClose(vec_ds);
+    rz_close_vector(vec_ds, sql_layer);
+
+    if (!rgio_output_finish(&out, 1)) {
+      rz_ct_cache_free(&ct_cache);
+      CSLDestroy(create_opts);
+      error("Failed to write %s output: %s", format_str, output_file);
+    }
+
+    REAL(elapsed)[i] = rgio_elapsed_seconds() - t_start;
 
     SET_STRING_ELT(output_paths, i, Rf_mkChar(output_file));
   }
 
+  if (fused) {
+    setAttrib(output_paths, install("bytes_saved"), bytes_saved);
+    setAttrib(output_paths, install("elapsed"), elapsed);
+  }
+
+  rz_ct_cache_free(&ct_cache);
   CSLDestroy(create_opts);
-  UNPROTECT(1);
+  UNPROTECT(3);
   return output_paths;
 }
@@ -0,0 +1,461 @@
+/*
+ * reclass.c
+ * Block-parallel reclassification with lookup tables and range rules
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/* Largest block area processed at once */
+#define RC_MAX_BLOCK_PIXELS 4194304
+/* Strips are grouped into units of about this many pixels */
+#define RC_MIN_UNIT_PIXELS 1048576
+
+/* -------------------------------------------------------------------------- */
+/*  Rules                                                                     */
+/* -------------------------------------------------------------------------- */
+/*
+ * Exact rules are kept sorted by source value and searched by bisection;
+ * range rules [min, max) are tried in order after them. Values matched by no
+ * rule are kept or set to nodata.
+ */
+typedef struct {
+  int n_exact;
+  double *from, *to;       /* sorted by from */
+  int n_ranges;
+  const double *rmin, *rmax, *rto;
+  int keep_others;
+  int has_src_nodata;
+  double src_nodata;
+  int has_dst_nodata;
+  double dst_nodata;
+  double fill;             /* written for nodata: dst_nodata, else 0 or NaN */
+} rc_rules;
+
+static int rc_cmp_pair(const void *a, const void *b) {
+  double x = ((const double *) a)[0], y = ((const double *) b)[0];
+  return (x > y) - (x < y);
+}
+
+/* Whether `type` stores `v` exactly (NaN only in floating point types) */
+static int rc_value_exact(double v, GDALDataType type) {
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 10, 0)
+  return GDALIsValueExactAs(v, type);
+#else
+  if (ISNAN(v)) return GDALDataTypeIsFloating(type);
+  if (type == GDT_Float64) return 1;
+  if (type == GDT_Float32) return isinf(v) || (double) (float) v == v;
+  int clamped = 0, rounded = 0;
+  GDALAdjustValueToDataType(type, v, &clamped, &rounded);
+  return !clamped && !rounded;
+#endif
+}
+
+/* Map one source value; NaN stands for "nodata" in the output */
+static double rc_map(const rc_rules *r, double v) {
+  if (ISNAN(v) || (r->has_src_nodata && v == r->src_nodata)) return NAN;
+  int lo = 0, hi = r->n_exact - 1;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (r->from[mid] < v) lo = mid + 1;
+    else if (r->from[mid] > v) hi = mid - 1;
+    else return r->to[mid];
+  }
+  for (int i = 0; i < r->n_ranges; i++) {
+    if (v >= r->rmin[i] && v < r->rmax[i]) return r->rto[i];
+  }
+  return r->keep_others ? v : NAN;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Block-parallel job                                                        */
+/* -------------------------------------------------------------------------- */
+/*
+ * Work units are windows of the output grid. Every worker opens its own
+ * source handle and maps its window; writes to the shared output handle
+ * are serialised under the mutex. Integer sources of up to 16 bits go
+ * through a direct array LUT over their whole value range (`lut`), in the
+ * output work type, so the inner loop is one load and one store per pixel.
+ */
+typedef struct {
+  const char *path;
+  int band;
+  const rc_rules *rules;
+  int bw, bh, nbx, width, height;
+  GIntBig n_units;
+  /* direct LUT (NULL if the source is wider than 16 bits) */
+  const void *lut;
+  GIntBig lut_offset;
+  GDALDataType work_type;  /* GDT_Int32 or GDT_Float64 */
+  GDALRasterBandH out_band;
+  CPLMutex *mutex;
+  GIntBig next;
+  int failed;
+  char message[512];
+} rc_job;
+
+static void rc_fail(rc_job *job, const char *message) {
+  CPLAcquireMutex(job->mutex, 1000.0);
+  if (!job->failed) {
+    job->failed = 1;
+    snprintf(job->message, sizeof(job->message), "%s", message);
+  }
+  CPLReleaseMutex(job->mutex);
+}
+
+static void rc_worker(void *arg) {
+  rc_job *job = (rc_job *) arg;
+  const rc_rules *r = job->rules;
+  size_t max_px = (size_t) job->bw * job->bh;
+
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  GDALDatasetH ds = GDALOpen(job->path, GA_ReadOnly);
+  GDALRasterBandH band = ds != NULL ? GDALGetRasterBand(ds, job->band) : NULL;
+  void *in = VSIMalloc2(max_px, job->lut != NULL ? sizeof(GInt32) : sizeof(double));
+  void *out = VSIMalloc2(max_px, GDALGetDataTypeSizeBytes(job->work_type));
+  if (band == NULL || in == NULL || out == NULL) {
+    char message[512];
+    snprintf(message, sizeof(message), "Failed to open %s", job->path);
+    rc_fail(job, message);
+  }
+
+  while (band != NULL && in != NULL && out != NULL) {
+    CPLAcquireMutex(job->mutex, 1000.0);
+    GIntBig unit = job->failed || job->next >= job->n_units ? -1 : job->next++;
+    CPLReleaseMutex(job->mutex);
+    if (unit < 0) break;
+
+    int x0 = (int) (unit % job->nbx) * job->bw;
+    int y0 = (int) (unit / job->nbx) * job->bh;
+    int cw = job->width - x0 < job->bw ? job->width - x0 : job->bw;
+    int ch = job->height - y0 < job->bh ? job->height - y0 : job->bh;
+    size_t n = (size_t) cw * ch;
+
+    if (GDALRasterIO(band, GF_Read, x0, y0, cw, ch, in, cw, ch,
+                     job->lut != NULL ? GDT_Int32 : GDT_Float64, 0, 0) != CE_None) {
+      char message[512];
+      snprintf(message, sizeof(message), "Failed to read block at %d,%d: %s",
+               x0, y0, CPLGetLastErrorMsg());
+      rc_fail(job, message);
+      break;
+    }
+
+    if (job->lut != NULL) {
+      const GInt32 *src = (const GInt32 *) in;
+      if (job->work_type == GDT_Int32) {
+        const GInt32 *lut = (const GInt32 *) job->lut - job->lut_offset;
+        GInt32 *dst = (GInt32 *) out;
+        for (size_t i = 0; i < n; i++) dst[i] = lut[src[i]];
+      } else {
+        const double *lut = (const double *) job->lut - job->lut_offset;
+        double *dst = (double *) out;
+        for (size_t i = 0; i < n; i++) dst[i] = lut[src[i]];
+      }
+    } else {
+      const double *src = (const double *) in;
+      double nd = r->fill;
+      if (job->work_type == GDT_Int32) {
+        GInt32 *dst = (GInt32 *) out;
+        for (size_t i = 0; i < n; i++) {
+          double v = rc_map(r, src[i]);
+          dst[i] = (GInt32) (ISNAN(v) ? nd : v);
+        }
+      } else {
+        double *dst = (double *) out;
+        for (size_t i = 0; i < n; i++) {
+          double v = rc_map(r, src[i]);
+          dst[i] = ISNAN(v) ? nd : v;
+        }
+      }
+    }
+
+    CPLAcquireMutex(job->mutex, 1000.0);
+    CPLErr err = GDALRasterIO(job->out_band, GF_Write, x0, y0, cw, ch, out, cw, ch,
+                              job->work_type, 0, 0);
+    if (err != CE_None && !job->failed) {
+      job->failed = 1;
+      snprintf(job->message, sizeof(job->message), "Failed to write block at %d,%d: %s",
+               x0, y0, CPLGetLastErrorMsg());
+    }
+    CPLReleaseMutex(job->mutex);
+    if (err != CE_None) break;
+  }
+
+  VSIFree(in);
+  VSIFree(out);
+  if (ds != NULL) GDALClose(ds);
+  CPLPopErrorHandler();
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Legend                                                                    */
+/* -------------------------------------------------------------------------- */
+/*
+ * Carry the source color table and category names over to the output:
+ * each output class takes the entry of the first source value mapped to it.
+ */
+static void rc_copy_legend(GDALRasterBandH src, GDALRasterBandH dst, const rc_rules *r) {
+  GDALColorTableH src_ct = GDALGetRasterColorTable(src);
+  char **src_names = GDALGetRasterCategoryNames(src);
+  int n_colors = src_ct != NULL ? GDALGetColorEntryCount(src_ct) : 0;
+  int n_names = CSLCount((CSLConstList) src_names);
+  int n_src = n_colors > n_names ? n_colors : n_names;
+  if (n_src == 0) return;
+
+  int max_out = -1;
+  int *target = (int *) CPLMalloc(sizeof(int) * n_src);
+  for (int v = 0; v < n_src; v++) {
+    double m = rc_map(r, (double) v);
+    target[v] = !ISNAN(m) && m >= 0 && m <= 65535 && m == floor(m) ? (int) m : -1;
+    if (target[v] > max_out) max_out = target[v];
+  }
+  if (max_out < 0) {
+    CPLFree(target);
+    return;
+  }
+
+  unsigned char *set = (unsigned char *) CPLCalloc(max_out + 1, 1);
+  GDALColorTableH ct = n_colors > 0 ? GDALCreateColorTable(GPI_RGB) : NULL;
+  char **names = n_names > 0 ? (char **) CPLCalloc(max_out + 2, sizeof(char *)) : NULL;
+  for (int v = 0; v < n_src; v++) {
+    int m = target[v];
+    if (m < 0 || set[m]) continue;
+    set[m] = 1;
+    if (ct != NULL && v < n_colors) GDALSetColorEntry(ct, m, GDALGetColorEntry(src_ct, v));
+    if (names != NULL && v < n_names) names[m] = CPLStrdup(src_names[v]);
+  }
+  if (ct != NULL) {
+    GDALSetRasterColorTable(dst, ct);
+    GDALSetRasterColorInterpretation(dst, GCI_PaletteIndex);
+    GDALDestroyColorTable(ct);
+  }
+  if (names != NULL) {
+    for (int m = 0; m <= max_out; m++) {
+      if (names[m] == NULL) names[m] = CPLStrdup("");
+    }
+    GDALSetRasterCategoryNames(dst, names);
+    CSLDestroy(names);
+  }
+  CPLFree(set);
+  CPLFree(target);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_reclass                                                             */
+/* -------------------------------------------------------------------------- */
+/*
+ * Reclassify one band into a new single band raster.
+ *
+ * @param src Source raster path
+ * @param dst Output path
+ * @param band Source band index
+ * @param from,to Exact value rules (numeric, same length)
+ * @param rmin,rmax,rto Range rules [rmin, rmax) -> rto, tried in order
+ * @param others Logical; keep unmatched values (FALSE sets them to nodata)
+ * @param dtype Output data type name ("" = source type)
+ * @param nodata Output nodata (NA = source nodata, if any)
+ * @param format Output driver ("GTiff", "COG", ...)
+ * @param co Creation options
+ * @param legend Logical; carry the color table and category names over
+ * @param threads Worker threads (0 = all CPUs)
+ * @return list(path, lut, elapsed); `lut` tells whether the direct array
+ *         path was used
+ */
+SEXP _rgio_reclass(SEXP src, SEXP dst, SEXP band, SEXP from, SEXP to,
+                   SEXP rmin, SEXP rmax, SEXP rto, SEXP others,
+                   SEXP dtype, SEXP nodata, SEXP format, SEXP co,
+                   SEXP legend, SEXP threads) {
+  const char *src_file = CHAR(STRING_ELT(src, 0));
+  const char *dst_file = CHAR(STRING_ELT(dst, 0));
+  const char *format_str = CHAR(STRING_ELT(format, 0));
+  int band_idx = INTEGER(band)[0];
+  double t_start = rgio_elapsed_seconds();
+  GDALAllRegister();
+
+  GDALDatasetH ds = GDALOpen(src_file, GA_ReadOnly);
+  if (ds == NULL) {
+    error("Failed to open dataset: %s", src_file);
+  }
+  if (band_idx < 1 || band_idx > GDALGetRasterCount(ds)) {
+    GDALClose(ds);
+    error("Band %d does not exist in %s", band_idx, src_file);
+  }
+  GDALRasterBandH src_band = GDALGetRasterBand(ds, band_idx);
+  GDALDataType src_type = GDALGetRasterDataType(src_band);
+
+  const char *dtype_str = CHAR(STRING_ELT(dtype, 0));
+  if (dtype_str[0] == '\0') dtype_str = GDALGetDataTypeName(src_type);
+  GDALDataType dst_type = GDALGetDataTypeByName(dtype_str);
+  if (dst_type == GDT_Unknown || GDALDataTypeIsComplex(dst_type)) {
+    GDALClose(ds);
+    error("Unsupported 'datatype': %s", dtype_str);
+  }
+
+  /* Rules */
+  rc_rules rules;
+  memset(&rules, 0, sizeof(rules));
+  rules.n_exact = Rf_length(from);
+  double *pairs = (double *) R_alloc((size_t) 2 * (rules.n_exact + 1), sizeof(double));
+  for (int i = 0; i < rules.n_exact; i++) {
+    pairs[2 * i] = REAL(from)[i];
+    pairs[2 * i + 1] = REAL(to)[i];
+  }
+  qsort(pairs, rules.n_exact, 2 * sizeof(double), rc_cmp_pair);
+  rules.from = (double *) R_alloc(rules.n_exact + 1, sizeof(double));
+  rules.to = (double *) R_alloc(rules.n_exact + 1, sizeof(double));
+  for (int i = 0; i < rules.n_exact; i++) {
+    rules.from[i] = pairs[2 * i];
+    rules.to[i] = pairs[2 * i + 1];
+  }
+  rules.n_ranges = Rf_length(rmin);
+  rules.rmin = REAL(rmin);
+  rules.rmax = REAL(rmax);
+  rules.rto = REAL(rto);
+  rules.keep_others = LOGICAL(others)[0];
+  rules.src_nodata = GDALGetRasterNoDataValue(src_band, &rules.has_src_nodata);
+  double nd = REAL(nodata)[0];
+  rules.has_dst_nodata = !ISNAN(nd) || rules.has_src_nodata;
+  rules.dst_nodata = !ISNAN(nd) ? nd : rules.src_nodata;
+  if (rules.has_dst_nodata && !rc_value_exact(rules.dst_nodata, dst_type)) {
+    GDALClose(ds);
+    if (ISNAN(nd))
+      error("Source nodata %g cannot be stored as %s; set 'nodata'",
+            rules.src_nodata, dtype_str);
+    error("'nodata' %g cannot be stored as %s", nd, dtype_str);
+  }
+
+  rc_job job;
+  memset(&job, 0, sizeof(job));
+  job.path = src_file;
+  job.band = band_idx;
+  job.rules = &rules;
+  job.width = GDALGetRasterXSize(ds);
+  job.height = GDALGetRasterYSize(ds);
+  job.work_type = GDALDataTypeIsInteger(dst_type) && dst_type != GDT_UInt32 &&
+                  GDALGetDataTypeSizeBytes(dst_type) <= 4 ? GDT_Int32 : GDT_Float64;
+  rules.fill = rules.has_dst_nodata ? rules.dst_nodata
+                                    : GDALDataTypeIsInteger(dst_type) ? 0 : NAN;
+
+  /* Every value written must fit the output type, or the casts below (and
+   * GDAL) would wrap, clamp or round it; NaN targets are written as fill */
+  for (int i = 0; i < rules.n_exact + rules.n_ranges; i++) {
+    int exact = i < rules.n_exact;
+    double v = exact ? rules.to[i] : rules.rto[i - rules.n_exact];
+    if (!ISNAN(v) && !rc_value_exact(v, dst_type)) {
+      GDALClose(ds);
+      error("'%s' value %g cannot be stored as %s",
+            exact ? "rules$to" : "ranges$to", v, dtype_str);
+    }
+  }
+  if (!rc_value_exact(rules.fill, dst_type)) {
+    GDALClose(ds);
+    error("Fill value %g cannot be stored as %s; set 'nodata'", rules.fill, dtype_str);
+  }
+
+  /* Direct array LUT for integer sources of up to 16 bits */
+  size_t lut_size = 0;
+  switch (src_type) {
+  case GDT_Byte:   lut_size = 256;                         break;
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 7, 0)
+  case GDT_Int8:   lut_size = 256;   job.lut_offset = -128;   break;
+#endif
+  case GDT_UInt16: lut_size = 65536;                       break;
+  case GDT_Int16:  lut_size = 65536; job.lut_offset = -32768; break;
+  default: break;
+  }
+  if (lut_size > 0) {
+    if (job.work_type == GDT_Int32) {
+      GInt32 *lut = (GInt32 *) R_alloc(lut_size, sizeof(GInt32));
+      for (size_t i = 0; i < lut_size; i++) {
+        double v = rc_map(&rules, (double) ((GIntBig) i + job.lut_offset));
+        lut[i] = (GInt32) (ISNAN(v) ? rules.fill : v);
+      }
+      job.lut = lut;
+    } else {
+      double *lut = (double *) R_alloc(lut_size, sizeof(double));
+      for (size_t i = 0; i < lut_size; i++) {
+        double v = rc_map(&rules, (double) ((GIntBig) i + job.lut_offset));
+        lut[i] = ISNAN(v) ? rules.fill : v;
+      }
+      job.lut = lut;
+    }
+  }
+
+  /* Output */
+  double gt[6] = { 0, 1, 0, 0, 0, -1 };
+  GDALGetGeoTransform(ds, gt);
+  char **create_opts = NULL;
+  for (int i = 0; i < Rf_length(co); i++) {
+    create_opts = CSLAddString(create_opts, CHAR(STRING_ELT(co, i)));
+  }
+  rgio_output out;
+  int created = rgio_output_create(&out, dst_file, format_str, dtype_str, gt,
+                                   job.width, job.height, GDALGetProjectionRef(ds),
+                                   1, create_opts);
+  CSLDestroy(create_opts);
+  if (!created) {
+    GDALClose(ds);
+    error("Failed to create output raster: %s (%s)", dst_file, CPLGetLastErrorMsg());
+  }
+  job.out_band = GDALGetRasterBand(out.ds, 1);
+  if (rules.has_dst_nodata) GDALSetRasterNoDataValue(job.out_band, rules.dst_nodata);
+  if (LOGICAL(legend)[0] && (dst_type == GDT_Byte || dst_type == GDT_UInt16))
+    rc_copy_legend(src_band, job.out_band, &rules);
+  GDALSetDescription(job.out_band, GDALGetDescription(src_band));
+
+  /* Work units follow the output blocks; strips are grouped */
+  GDALGetBlockSize(job.out_band, &job.bw, &job.bh);
+  if (job.bw <= 0 || job.bw > job.width) job.bw = job.width;
+  if (job.bh <= 0 || job.bh > job.height) job.bh = job.height;
+  if (job.bw == job.width && (double) job.bw * job.bh < RC_MIN_UNIT_PIXELS) {
+    int k = RC_MIN_UNIT_PIXELS / (job.bw * job.bh);
+    job.bh = job.bh * k < job.height ? job.bh * k : job.height;
+  }
+  if ((double) job.bw * job.bh > RC_MAX_BLOCK_PIXELS) {
+    job.bh = RC_MAX_BLOCK_PIXELS / job.bw > 0 ? RC_MAX_BLOCK_PIXELS / job.bw : 1;
+  }
+  job.nbx = (job.width + job.bw - 1) / job.bw;
+  job.n_units = (GIntBig) job.nbx * ((job.height + job.bh - 1) / job.bh);
+  GDALClose(ds);
+
+  int n_workers = rgio_resolve_threads(INTEGER(threads)[0],
+                                       job.n_units < 65536 ? (int) job.n_units : 65536);
+  job.mutex = CPLCreateMutex();
+  CPLReleaseMutex(job.mutex);
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+  for (int i = 1; i < n_workers; i++) {
+    workers[i] = CPLCreateJoinableThread(rc_worker, &job);
+  }
+  rc_worker(&job);  /* the calling thread takes part too */
+  for (int i = 1; i < n_workers; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLDestroyMutex(job.mutex);
+
+  if (!rgio_output_finish(&out, !job.failed)) {
+    if (job.failed) error("%s", job.message);
+    error("Failed to write %s output: %s", format_str, dst_file);
+  }
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 3));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 3));
+  SET_VECTOR_ELT(result, 0, Rf_mkString(dst_file));
+  SET_STRING_ELT(names, 0, Rf_mkChar("path"));
+  SET_VECTOR_ELT(result, 1, Rf_ScalarLogical(job.lut != NULL));
+  SET_STRING_ELT(names, 1, Rf_mkChar("lut"));
+  SET_VECTOR_ELT(result, 2, Rf_ScalarReal(rgio_elapsed_seconds() - t_start));
+  SET_STRING_ELT(names, 2, Rf_mkChar("elapsed"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+  UNPROTECT(2);
+  return result;
+}
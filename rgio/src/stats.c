@@ -0,0 +1,542 @@
+/*
+ * stats.c
+ * Parallel band statistics and histograms with PAM caching
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <math.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/* Pixels read per band in approximate mode without overviews */
+#define ST_APPROX_PIXELS 2500000
+/* Largest integer value range histogrammed with one bin per value */
+#define ST_MAX_DISCRETE_BINS 65536
+#define ST_DEFAULT_BINS 256
+
+/* -------------------------------------------------------------------------- */
+/*  Accumulators                                                              */
+/* -------------------------------------------------------------------------- */
+
+typedef struct {
+  double count;
+  double min, max;
+  double mean, m2;      /* running mean and sum of squared deviations */
+  GUIntBig *hist;
+} st_acc;
+
+/* Chan et al. pairwise update of (count, mean, m2) */
+static void st_acc_merge(st_acc *a, double n, double mean, double m2,
+                         double vmin, double vmax) {
+  if (n <= 0) return;
+  if (a->count == 0) {
+    a->count = n;
+    a->mean = mean;
+    a->m2 = m2;
+    a->min = vmin;
+    a->max = vmax;
+    return;
+  }
+  double total = a->count + n;
+  double delta = mean - a->mean;
+  a->mean += delta * n / total;
+  a->m2 += m2 + delta * delta * a->count * n / total;
+  a->count = total;
+  if (vmin < a->min) a->min = vmin;
+  if (vmax > a->max) a->max = vmax;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Block-parallel job                                                        */
+/* -------------------------------------------------------------------------- */
+/*
+ * Work units are blocks of the selected bands, in band-major order. Every
+ * worker opens its own dataset handle and claims blocks under the mutex.
+ * Pass 1 accumulates moments and range, pass 2 the histogram over the
+ * range found in pass 1.
+ */
+typedef struct {
+  const char *path;
+  int n_bands;
+  const int *bands;
+  const int *ovr;          /* overview index per band, -1 = full resolution */
+  const int *step_x, *step_y;  /* read blocks on every step_x-th column, step_y-th row */
+  int *bw, *bh, *nbx, *nby;
+  int *width, *height;
+  int *has_nodata;
+  double *nodata;
+  GIntBig *first_unit;     /* first unit of each band; [n_bands] = total */
+  int pass;
+  double *lo, *hi;
+  int *bins;
+  st_acc *acc;             /* [thread * n_bands + band] */
+  CPLMutex *mutex;
+  GIntBig next;
+  int failed;
+  char message[512];
+} st_job;
+
+typedef struct {
+  st_job *job;
+  int tid;
+} st_worker_arg;
+
+static GDALRasterBandH st_band(GDALDatasetH ds, const st_job *job, int b) {
+  GDALRasterBandH band = GDALGetRasterBand(ds, job->bands[b]);
+  if (band != NULL && job->ovr[b] >= 0) band = GDALGetOverview(band, job->ovr[b]);
+  return band;
+}
+
+static void st_worker(void *arg) {
+  st_worker_arg *wa = (st_worker_arg *) arg;
+  st_job *job = wa->job;
+  st_acc *acc = job->acc + (size_t) wa->tid * job->n_bands;
+
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  GDALDatasetH ds = GDALOpen(job->path, GA_ReadOnly);
+  int max_px = 0;
+  for (int b = 0; b < job->n_bands; b++) {
+    if (job->bw[b] * job->bh[b] > max_px) max_px = job->bw[b] * job->bh[b];
+  }
+  double *buf = (double *) VSIMalloc2(max_px > 0 ? max_px : 1, sizeof(double));
+
+  if (ds == NULL || buf == NULL) {
+    CPLAcquireMutex(job->mutex, 1000.0);
+    if (!job->failed) {
+      job->failed = 1;
+      snprintf(job->message, sizeof(job->message), "Failed to open %s", job->path);
+    }
+    CPLReleaseMutex(job->mutex);
+  }
+
+  while (ds != NULL && buf != NULL) {
+    CPLAcquireMutex(job->mutex, 1000.0);
+    GIntBig unit = job->failed ? -1 : job->next;
+    if (unit >= 0 && unit < job->first_unit[job->n_bands]) job->next++;
+    else unit = -1;
+    CPLReleaseMutex(job->mutex);
+    if (unit < 0) break;
+
+    int b = 0;
+    while (unit >= job->first_unit[b + 1]) b++;
+    GIntBig k = unit - job->first_unit[b];
+    int bx = (int) (k % job->nbx[b]), by = (int) (k / job->nbx[b]);
+    if (bx % job->step_x[b] != 0 || by % job->step_y[b] != 0) continue;
+    if (job->pass == 2 && acc[b].hist == NULL) continue;  /* no valid pixels */
+
+    int x0 = bx * job->bw[b], y0 = by * job->bh[b];
+    int cw = job->width[b] - x0 < job->bw[b] ? job->width[b] - x0 : job->bw[b];
+    int ch = job->height[b] - y0 < job->bh[b] ? job->height[b] - y0 : job->bh[b];
+
+    GDALRasterBandH band = st_band(ds, job, b);
+    if (band == NULL ||
+        GDALRasterIO(band, GF_Read, x0, y0, cw, ch, buf, cw, ch,
+                     GDT_Float64, 0, 0) != CE_None) {
+      CPLAcquireMutex(job->mutex, 1000.0);
+      if (!job->failed) {
+        job->failed = 1;
+        snprintf(job->message, sizeof(job->message), "Failed to read band %d: %s",
+                 job->bands[b], CPLGetLastErrorMsg());
+      }
+      CPLReleaseMutex(job->mutex);
+      break;
+    }
+
+    size_t n = (size_t) cw * ch;
+    int has_nd = job->has_nodata[b];
+    double nd = job->nodata[b];
+
+    if (job->pass == 1) {
+      double cnt = 0, sum = 0, vmin = HUGE_VAL, vmax = -HUGE_VAL;
+      for (size_t i = 0; i < n; i++) {
+        double v = buf[i];
+        if (ISNAN(v) || (has_nd && v == nd)) continue;
+        cnt++;
+        sum += v;
+        if (v < vmin) vmin = v;
+        if (v > vmax) vmax = v;
+      }
+      if (cnt == 0) continue;
+      double mean = sum / cnt, m2 = 0;
+      for (size_t i = 0; i < n; i++) {
+        double v = buf[i];
+        if (ISNAN(v) || (has_nd && v == nd)) continue;
+        m2 += (v - mean) * (v - mean);
+      }
+      st_acc_merge(&acc[b], cnt, mean, m2, vmin, vmax);
+    } else {
+      double lo = job->lo[b];
+      int bins = job->bins[b];
+      double scale = bins / (job->hi[b] - lo);
+      GUIntBig *hist = acc[b].hist;
+      for (size_t i = 0; i < n; i++) {
+        double v = buf[i];
+        if (ISNAN(v) || (has_nd && v == nd)) continue;
+        int k = (int) ((v - lo) * scale);
+        if (k < 0) k = 0;
+        if (k >= bins) k = bins - 1;
+        hist[k]++;
+      }
+    }
+  }
+
+  VSIFree(buf);
+  if (ds != NULL) GDALClose(ds);
+  CPLPopErrorHandler();
+}
+
+static void st_run(st_job *job, int n_workers) {
+  job->next = 0;
+  st_worker_arg *args = (st_worker_arg *) CPLCalloc(n_workers, sizeof(st_worker_arg));
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+  for (int i = 0; i < n_workers; i++) {
+    args[i].job = job;
+    args[i].tid = i;
+  }
+  for (int i = 1; i < n_workers; i++) {
+    workers[i] = CPLCreateJoinableThread(st_worker, &args[i]);
+  }
+  st_worker(&args[0]);  /* the calling thread takes part too */
+  for (int i = 1; i < n_workers; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLFree(args);
+}
+
+/* -------------------------------------------------------------------------- */
+/*  PAM cache                                                                 */
+/* -------------------------------------------------------------------------- */
+/*
+ * Statistics and the default histogram already stored for a band (in the
+ * file or its .aux.xml), if they match the request: exact results serve
+ * both modes, approximate ones only approximate requests, and the
+ * histogram must have the requested number of bins (any, if bins = 0).
+ */
+static int st_cached(GDALRasterBandH band, int approx, int bins, double *stats,
+                     double *lo, double *hi, int *n_bins, GUIntBig **hist) {
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  int ok = GDALGetRasterStatistics(band, approx, FALSE, &stats[0], &stats[1],
+                                   &stats[2], &stats[3]) == CE_None;
+  if (ok) {
+    ok = GDALGetDefaultHistogramEx(band, lo, hi, n_bins, hist, FALSE,
+                                   NULL, NULL) == CE_None;
+    if (ok && bins > 0 && *n_bins != bins) {
+      VSIFree(*hist);
+      ok = 0;
+    }
+  }
+  CPLPopErrorHandler();
+  if (!ok) *hist = NULL;
+  return ok;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_stats                                                               */
+/* -------------------------------------------------------------------------- */
+/*
+ * Per band statistics and histogram.
+ *
+ * @param path Raster path
+ * @param bands Integer band indices
+ * @param bins Histogram bins (0 = one per value for integer bands with a
+ *        range up to ST_MAX_DISCRETE_BINS, else ST_DEFAULT_BINS)
+ * @param approx Logical; sample an overview (or every n-th block)
+ * @param threads Worker threads (0 = all CPUs)
+ * @param cache Logical; reuse and store PAM statistics/histograms
+ * @return list(band, count, min, max, mean, sd, approximate, cached,
+ *         discrete, histograms = list(list(lo, hi, counts)))
+ */
+SEXP _rgio_stats(SEXP path, SEXP bands, SEXP bins, SEXP approx,
+                 SEXP threads, SEXP cache) {
+  const char *file = CHAR(STRING_ELT(path, 0));
+  int n_bands = Rf_length(bands);
+  int req_bins = INTEGER(bins)[0];
+  int is_approx = LOGICAL(approx)[0];
+  int use_cache = LOGICAL(cache)[0];
+  GDALAllRegister();
+
+  GDALDatasetH ds = GDALOpen(file, GA_ReadOnly);
+  if (ds == NULL) {
+    error("Failed to open dataset: %s", file);
+  }
+  for (int b = 0; b < n_bands; b++) {
+    int idx = INTEGER(bands)[b];
+    if (idx < 1 || idx > GDALGetRasterCount(ds)) {
+      GDALClose(ds);
+      error("Band %d does not exist in %s", idx, file);
+    }
+  }
+
+  st_job job;
+  memset(&job, 0, sizeof(job));
+  job.path = file;
+  job.n_bands = n_bands;
+  job.bands = INTEGER(bands);
+  int *ovr = (int *) R_alloc(n_bands > 0 ? n_bands : 1, sizeof(int));
+  int *step_x = (int *) R_alloc(n_bands > 0 ? n_bands : 1, sizeof(int));
+  int *step_y = (int *) R_alloc(n_bands > 0 ? n_bands : 1, sizeof(int));
+  job.ovr = ovr;
+  job.step_x = step_x;
+  job.step_y = step_y;
+  job.bw = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.bh = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.nbx = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.nby = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.width = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.height = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.has_nodata = (int *) R_alloc(n_bands + 1, sizeof(int));
+  job.nodata = (double *) R_alloc(n_bands + 1, sizeof(double));
+  job.first_unit = (GIntBig *) R_alloc(n_bands + 1, sizeof(GIntBig));
+  job.lo = (double *) R_alloc(n_bands + 1, sizeof(double));
+  job.hi = (double *) R_alloc(n_bands + 1, sizeof(double));
+  job.bins = (int *) R_alloc(n_bands + 1, sizeof(int));
+
+  /* Results, one entry per band */
+  double *r_stats = (double *) R_alloc((size_t) (n_bands + 1) * 5, sizeof(double));
+  int *r_cached = (int *) R_alloc(n_bands + 1, sizeof(int));
+  int *r_discrete = (int *) R_alloc(n_bands + 1, sizeof(int));
+  GUIntBig **r_hist = (GUIntBig **) R_alloc(n_bands + 1, sizeof(GUIntBig *));
+
+  /* Cached bands are taken as is; the others get a unit range */
+  GIntBig units = 0;
+  for (int b = 0; b < n_bands; b++) {
+    GDALRasterBandH band = GDALGetRasterBand(ds, job.bands[b]);
+    GDALDataType dt = GDALGetRasterDataType(band);
+    r_discrete[b] = GDALDataTypeIsInteger(dt);
+    r_hist[b] = NULL;
+    r_cached[b] = 0;
+    job.first_unit[b] = units;
+
+    double st[4];
+    if (use_cache && st_cached(band, is_approx, req_bins, st, &job.lo[b], &job.hi[b],
+                               &job.bins[b], &r_hist[b])) {
+      double count = 0;
+      for (int k = 0; k < job.bins[b]; k++) count += (double) r_hist[b][k];
+      r_stats[b * 5 + 0] = count;
+      r_stats[b * 5 + 1] = st[0];
+      r_stats[b * 5 + 2] = st[1];
+      r_stats[b * 5 + 3] = st[2];
+      r_stats[b * 5 + 4] = st[3];
+      r_cached[b] = 1;
+      ovr[b] = -1;
+      step_x[b] = step_y[b] = 1;
+      job.bw[b] = job.bh[b] = job.nbx[b] = job.nby[b] = 0;
+      job.width[b] = job.height[b] = 0;
+      job.has_nodata[b] = 0;
+      job.nodata[b] = 0;
+      continue;
+    }
+
+    ovr[b] = -1;
+    step_x[b] = step_y[b] = 1;
+    GDALRasterBandH src = band;
+    if (is_approx) {
+      GDALRasterBandH sample = GDALGetRasterSampleOverview(band, ST_APPROX_PIXELS);
+      for (int k = 0; sample != band && k < GDALGetOverviewCount(band); k++) {
+        if (GDALGetOverview(band, k) == sample) {
+          ovr[b] = k;
+          src = sample;
+          break;
+        }
+      }
+    }
+    job.width[b] = GDALGetRasterBandXSize(src);
+    job.height[b] = GDALGetRasterBandYSize(src);
+    GDALGetBlockSize(src, &job.bw[b], &job.bh[b]);
+    if (job.bw[b] <= 0 || job.bw[b] > job.width[b]) job.bw[b] = job.width[b];
+    if (job.bh[b] <= 0 || job.bh[b] > job.height[b]) job.bh[b] = job.height[b];
+    /* huge strips are split so that workers share the band */
+    if ((double) job.bw[b] * job.bh[b] > 4194304.0) {
+      job.bh[b] = 4194304 / job.bw[b] > 0 ? 4194304 / job.bw[b] : 1;
+    }
+    job.nbx[b] = (job.width[b] + job.bw[b] - 1) / job.bw[b];
+    job.nby[b] = (job.height[b] + job.bh[b] - 1) / job.bh[b];
+    GIntBig n_blocks = (GIntBig) job.nbx[b] * job.nby[b];
+    if (is_approx && ovr[b] < 0) {
+      double px = (double) job.width[b] * job.height[b];
+      /* read about one block in `stride` */
+      int stride = (int) (px / ST_APPROX_PIXELS);
+      if (stride < 1) stride = 1;
+      /*
+       * A regular lattice of blocks: taking every stride-th block in row
+       * order would keep the same block columns whenever nbx shares a
+       * factor with the stride.
+       */
+      int sx = (int) floor(sqrt((double) stride) + 0.5);
+      step_x[b] = sx < 1 ? 1 : sx > job.nbx[b] ? job.nbx[b] : sx;
+      step_y[b] = (stride + step_x[b] - 1) / step_x[b];
+    }
+    job.nodata[b] = GDALGetRasterNoDataValue(band, &job.has_nodata[b]);
+    units += n_blocks;
+  }
+  job.first_unit[n_bands] = units;
+
+  int n_workers = rgio_resolve_threads(INTEGER(threads)[0], units > 0 ? (int) (units < 65536 ? units : 65536) : 1);
+  job.acc = (st_acc *) CPLCalloc((size_t) n_workers * (n_bands > 0 ? n_bands : 1),
+                                 sizeof(st_acc));
+  job.mutex = CPLCreateMutex();
+  CPLReleaseMutex(job.mutex);
+
+  if (units > 0) {
+    /* Pass 1: moments and range */
+    job.pass = 1;
+    st_run(&job, n_workers);
+
+    /* Pass 2: histogram over the merged range */
+    int any_hist = 0;
+    for (int b = 0; b < n_bands && !job.failed; b++) {
+      if (r_cached[b]) continue;
+      st_acc total = {0};
+      for (int t = 0; t < n_workers; t++) {
+        st_acc *a = &job.acc[(size_t) t * n_bands + b];
+        st_acc_merge(&total, a->count, a->mean, a->m2, a->min, a->max);
+      }
+      r_stats[b * 5 + 0] = total.count;
+      r_stats[b * 5 + 1] = total.count > 0 ? total.min : NA_REAL;
+      r_stats[b * 5 + 2] = total.count > 0 ? total.max : NA_REAL;
+      r_stats[b * 5 + 3] = total.count > 0 ? total.mean : NA_REAL;
+      r_stats[b * 5 + 4] = total.count > 0 ? sqrt(total.m2 / total.count) : NA_REAL;
+      if (total.count == 0) {
+        job.bins[b] = 0;
+        job.lo[b] = job.hi[b] = 0;
+        continue;
+      }
+
+      double range = total.max - total.min;
+      if (req_bins > 0) {
+        job.bins[b] = req_bins;
+        r_discrete[b] = 0;
+      } else if (r_discrete[b] && range + 1 <= ST_MAX_DISCRETE_BINS) {
+        job.bins[b] = (int) range + 1;
+      } else {
+        job.bins[b] = ST_DEFAULT_BINS;
+        r_discrete[b] = 0;
+      }
+      if (r_discrete[b] || range == 0) {
+        job.lo[b] = total.min - 0.5;
+        job.hi[b] = total.max + 0.5;
+        /* a constant band fills one bin, unless the caller asked for a
+         * bin count, which the PAM cache must match later */
+        if (!r_discrete[b] && req_bins == 0) job.bins[b] = 1;
+      } else {
+        job.lo[b] = total.min;
+        job.hi[b] = total.max;
+      }
+      for (int t = 0; t < n_workers; t++) {
+        job.acc[(size_t) t * n_bands + b].hist =
+          (GUIntBig *) CPLCalloc(job.bins[b], sizeof(GUIntBig));
+      }
+      any_hist = 1;
+    }
+
+    if (any_hist && !job.failed) {
+      job.pass = 2;
+      st_run(&job, n_workers);
+    }
+
+    for (int b = 0; b < n_bands; b++) {
+      if (r_cached[b] || job.bins[b] == 0) continue;
+      GUIntBig *hist = (GUIntBig *) CPLCalloc(job.bins[b], sizeof(GUIntBig));
+      for (int t = 0; t < n_workers; t++) {
+        GUIntBig *h = job.acc[(size_t) t * n_bands + b].hist;
+        for (int k = 0; h != NULL && k < job.bins[b]; k++) hist[k] += h[k];
+      }
+      r_hist[b] = hist;
+    }
+  }
+
+  for (int i = 0; i < n_workers * n_bands; i++) CPLFree(job.acc[i].hist);
+  CPLFree(job.acc);
+  CPLDestroyMutex(job.mutex);
+
+  if (job.failed) {
+    for (int b = 0; b < n_bands; b++) {
+      if (r_cached[b]) VSIFree(r_hist[b]); else CPLFree(r_hist[b]);
+    }
+    GDALClose(ds);
+    error("%s", job.message);
+  }
+
+  /* Persist to PAM; written to .aux.xml when the dataset is closed */
+  if (use_cache) {
+    for (int b = 0; b < n_bands; b++) {
+      if (r_cached[b] || r_hist[b] == NULL) continue;
+      GDALRasterBandH band = GDALGetRasterBand(ds, job.bands[b]);
+      CPLPushErrorHandler(CPLQuietErrorHandler);
+      GDALSetRasterStatistics(band, r_stats[b * 5 + 1], r_stats[b * 5 + 2],
+                              r_stats[b * 5 + 3], r_stats[b * 5 + 4]);
+      int sampled = is_approx && (ovr[b] >= 0 || step_x[b] > 1 || step_y[b] > 1);
+      GDALSetMetadataItem(band, "STATISTICS_APPROXIMATE", sampled ? "YES" : NULL, NULL);
+      GDALSetDefaultHistogramEx(band, job.lo[b], job.hi[b], job.bins[b], r_hist[b]);
+      CPLPopErrorHandler();
+    }
+  }
+  GDALClose(ds);
+
+  /* Result */
+  SEXP r_band = PROTECT(Rf_allocVector(INTSXP, n_bands));
+  SEXP r_count = PROTECT(Rf_allocVector(REALSXP, n_bands));
+  SEXP r_min = PROTECT(Rf_allocVector(REALSXP, n_bands));
+  SEXP r_max = PROTECT(Rf_allocVector(REALSXP, n_bands));
+  SEXP r_mean = PROTECT(Rf_allocVector(REALSXP, n_bands));
+  SEXP r_sd = PROTECT(Rf_allocVector(REALSXP, n_bands));
+  SEXP r_approx = PROTECT(Rf_allocVector(LGLSXP, n_bands));
+  SEXP r_cache = PROTECT(Rf_allocVector(LGLSXP, n_bands));
+  SEXP r_disc = PROTECT(Rf_allocVector(LGLSXP, n_bands));
+  SEXP r_hists = PROTECT(Rf_allocVector(VECSXP, n_bands));
+
+  for (int b = 0; b < n_bands; b++) {
+    INTEGER(r_band)[b] = job.bands[b];
+    REAL(r_count)[b] = r_stats[b * 5 + 0];
+    REAL(r_min)[b] = r_stats[b * 5 + 1];
+    REAL(r_max)[b] = r_stats[b * 5 + 2];
+    REAL(r_mean)[b] = r_stats[b * 5 + 3];
+    REAL(r_sd)[b] = r_stats[b * 5 + 4];
+    LOGICAL(r_approx)[b] = is_approx && !r_cached[b] ? (ovr[b] >= 0 || step_x[b] > 1 || step_y[b] > 1) : 0;
+    LOGICAL(r_cache)[b] = r_cached[b];
+    /* a cached histogram is discrete when it has unit bins on an integer band */
+    if (r_cached[b]) {
+      r_discrete[b] = r_discrete[b] && job.bins[b] > 0 &&
+        fabs((job.hi[b] - job.lo[b]) / job.bins[b] - 1.0) < 1e-9;
+    }
+    LOGICAL(r_disc)[b] = r_discrete[b];
+
+    SEXP h = PROTECT(Rf_allocVector(VECSXP, 3));
+    SEXP hn = PROTECT(Rf_allocVector(STRSXP, 3));
+    SEXP counts = Rf_allocVector(REALSXP, job.bins[b]);
+    SET_VECTOR_ELT(h, 2, counts);
+    for (int k = 0; k < job.bins[b]; k++) REAL(counts)[k] = (double) r_hist[b][k];
+    SET_VECTOR_ELT(h, 0, Rf_ScalarReal(job.lo[b]));
+    SET_VECTOR_ELT(h, 1, Rf_ScalarReal(job.hi[b]));
+    SET_STRING_ELT(hn, 0, Rf_mkChar("lo"));
+    SET_STRING_ELT(hn, 1, Rf_mkChar("hi"));
+    SET_STRING_ELT(hn, 2, Rf_mkChar("counts"));
+    Rf_setAttrib(h, R_NamesSymbol, hn);
+    SET_VECTOR_ELT(r_hists, b, h);
+    UNPROTECT(2);
+
+    if (r_cached[b]) VSIFree(r_hist[b]); else CPLFree(r_hist[b]);
+  }
+
+  const char *out_names[] = { "band", "count", "min", "max", "mean", "sd",
+                              "approximate", "cached", "discrete", "histograms" };
+  SEXP cols[] = { r_band, r_count, r_min, r_max, r_mean, r_sd,
+                  r_approx, r_cache, r_disc, r_hists };
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 10));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 10));
+  for (int i = 0; i < 10; i++) {
+    SET_VECTOR_ELT(result, i, cols[i]);
+    SET_STRING_ELT(names, i, Rf_mkChar(out_names[i]));
+  }
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  UNPROTECT(12);
+  return result;
+}
@@ -0,0 +1,210 @@
+/*
+ * tile_index.c
+ * GDAL tile index (GTI) mosaics
+ */
+
+#include <gdal.h>
+#include <ogr_api.h>
+#include <ogr_srs_api.h>
+#include <cpl_conv.h>
+#include <cpl_minixml.h>
+#include <cpl_string.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/*
+ * A GTI mosaic is a vector layer with one footprint polygon per source and
+ * its path in a "location" field, plus a small XML (.gti) describing the
+ * grid. GDAL's GTI driver opens it without touching the sources and, on
+ * read, queries the layer's spatial index (GeoPackage R-tree or FlatGeobuf
+ * packed Hilbert R-tree) for the intersecting tiles only, so opening a
+ * continental mosaic does not grow with the number of tiles the way a VRT
+ * with one source element per tile does.
+ */
+
+#define TI_LAYER "tiles"
+#define TI_LOCATION "location"
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 9, 0)
+
+/* Footprint of a source in the index CRS; NULL if it cannot be transformed */
+static OGRGeometryH ti_footprint(const rgio_src_meta *m, OGRCoordinateTransformationH ct) {
+  const double *gt = m->gt;
+  double px[5] = {0, m->width, m->width, 0, 0};
+  double py[5] = {0, 0, m->height, m->height, 0};
+  OGRGeometryH ring = OGR_G_CreateGeometry(wkbLinearRing);
+  for (int k = 0; k < 5; k++) {
+    OGR_G_AddPoint_2D(ring, gt[0] + px[k] * gt[1] + py[k] * gt[2],
+                      gt[3] + px[k] * gt[4] + py[k] * gt[5]);
+  }
+  OGRGeometryH poly = OGR_G_CreateGeometry(wkbPolygon);
+  OGR_G_AddGeometryDirectly(poly, ring);
+  if (ct != NULL) {
+    /* densify so the reprojected edges follow the curved footprint */
+    double w = m->width * fabs(gt[1]), h = m->height * fabs(gt[5]);
+    OGR_G_Segmentize(poly, (w > h ? w : h) / 32.0);
+    if (OGR_G_Transform(poly, ct) != OGRERR_NONE) {
+      OGR_G_DestroyGeometry(poly);
+      return NULL;
+    }
+  }
+  return poly;
+}
+
+static const char *ti_driver_name(const char *path) {
+  const char *ext = CPLGetExtension(path);
+  if (EQUAL(ext, "gpkg")) return "GPKG";
+  if (EQUAL(ext, "fgb")) return "FlatGeobuf";
+  return NULL;
+}
+
+/* Write the .gti XML describing the mosaic grid over `index_path` */
+static int ti_write_gti(const char *gti_path, const char *index_path,
+                        const rgio_src_meta *first, const double *bbox,
+                        int width, int height, const char *target_wkt,
+                        const char *resample) {
+  double gt[6] = {bbox[0], (bbox[2] - bbox[0]) / width, 0,
+                  bbox[3], 0, -(bbox[3] - bbox[1]) / height};
+  CPLXMLNode *root = CPLCreateXMLNode(NULL, CXT_Element, "GDALTileIndexDataset");
+  CPLCreateXMLElementAndValue(root, "IndexDataset", index_path);
+  CPLCreateXMLElementAndValue(root, "IndexLayer", TI_LAYER);
+  CPLCreateXMLElementAndValue(root, "LocationField", TI_LOCATION);
+  CPLCreateXMLElementAndValue(root, "XSize", CPLSPrintf("%d", width));
+  CPLCreateXMLElementAndValue(root, "YSize", CPLSPrintf("%d", height));
+  CPLCreateXMLElementAndValue(
+    root, "GeoTransform",
+    CPLSPrintf("%.17g,%.17g,%.17g,%.17g,%.17g,%.17g", gt[0], gt[1], gt[2],
+               gt[3], gt[4], gt[5]));
+  CPLCreateXMLElementAndValue(root, "SRS", target_wkt);
+  CPLCreateXMLElementAndValue(root, "BandCount", CPLSPrintf("%d", first->n_bands));
+  CPLCreateXMLElementAndValue(root, "Resampling",
+                              strcmp(resample, "near") == 0 ? "nearest" : resample);
+  for (int b = 0; b < first->n_bands; b++) {
+    CPLXMLNode *band = CPLCreateXMLNode(root, CXT_Element, "Band");
+    CPLAddXMLAttributeAndValue(band, "band", CPLSPrintf("%d", b + 1));
+    CPLAddXMLAttributeAndValue(band, "dataType", GDALGetDataTypeName(first->types[b]));
+    if (first->has_nodata[b]) {
+      CPLCreateXMLElementAndValue(band, "NoDataValue",
+                                  CPLSPrintf("%.17g", first->nodata[b]));
+    }
+  }
+  int ok = CPLSerializeXMLTreeToFile(root, gti_path);
+  CPLDestroyXMLNode(root);
+  return ok;
+}
+
+/*
+ * Write a GTI tile index of `meta` to `index_path` (.gpkg or .fgb) and the
+ * grid description to `gti_path`. Footprints of sources in another CRS are
+ * densified and reprojected; the GTI driver warps those tiles on read.
+ * Returns 0 with a message in `msg` on failure.
+ */
+int rgio_write_tile_index(const char *index_path, const char *gti_path,
+                          const rgio_src_meta *meta, int n, const double *bbox,
+                          int width, int height, const char *target_wkt,
+                          const char *resample, char *msg, size_t msg_len) {
+  const char *driver_name = ti_driver_name(index_path);
+  if (driver_name == NULL) {
+    snprintf(msg, msg_len, "Tile index must be a .gpkg or .fgb file: %s", index_path);
+    return 0;
+  }
+  if (n == 0) {
+    snprintf(msg, msg_len, "Tile index needs at least one source");
+    return 0;
+  }
+  GDALDriverH drv = GDALGetDriverByName(driver_name);
+  if (drv == NULL) {
+    snprintf(msg, msg_len, "GDAL driver not available: %s", driver_name);
+    return 0;
+  }
+  GDALDeleteDataset(drv, index_path);
+  GDALDatasetH ds = GDALCreate(drv, index_path, 0, 0, 0, GDT_Unknown, NULL);
+  if (ds == NULL) {
+    snprintf(msg, msg_len, "Failed to create tile index: %s", index_path);
+    return 0;
+  }
+
+  OGRSpatialReferenceH srs = OSRNewSpatialReference(target_wkt);
+  OSRSetAxisMappingStrategy(srs, OAMS_TRADITIONAL_GIS_ORDER);
+  OGRLayerH layer = GDALDatasetCreateLayer(ds, TI_LAYER, srs, wkbPolygon, NULL);
+  OGRFieldDefnH fld = OGR_Fld_Create(TI_LOCATION, OFTString);
+  int ok = layer != NULL && OGR_L_CreateField(layer, fld, TRUE) == OGRERR_NONE;
+  OGR_Fld_Destroy(fld);
+  if (!ok) {
+    snprintf(msg, msg_len, "Failed to create tile index layer: %s", index_path);
+  }
+
+  /* one transaction for the whole layer; FlatGeobuf has none and ignores it */
+  int in_transaction = ok && GDALDatasetStartTransaction(ds, FALSE) == OGRERR_NONE;
+  OGRSpatialReferenceH src_srs = NULL;
+  OGRCoordinateTransformationH ct = NULL;
+  const char *ct_wkt = NULL;   /* WKT `ct` was built for */
+  for (int i = 0; ok && i < n; i++) {
+    const rgio_src_meta *m = &meta[i];
+    if (m->wkt != NULL && m->wkt[0] != '\0' &&
+        (ct_wkt == NULL || strcmp(ct_wkt, m->wkt) != 0)) {
+      if (ct != NULL) OCTDestroyCoordinateTransformation(ct);
+      if (src_srs != NULL) OSRDestroySpatialReference(src_srs);
+      src_srs = OSRNewSpatialReference(m->wkt);
+      ct = NULL;
+      if (src_srs != NULL) {
+        OSRSetAxisMappingStrategy(src_srs, OAMS_TRADITIONAL_GIS_ORDER);
+        if (!OSRIsSame(src_srs, srs)) ct = OCTNewCoordinateTransformation(src_srs, srs);
+      }
+      ct_wkt = m->wkt;
+    }
+    OGRGeometryH geom = ti_footprint(m, (m->wkt != NULL && m->wkt[0] != '\0') ? ct : NULL);
+    if (geom == NULL) {
+      snprintf(msg, msg_len, "Failed to reproject footprint of: %s", m->path);
+      ok = 0;
+      break;
+    }
+    OGRFeatureH feat = OGR_F_Create(OGR_L_GetLayerDefn(layer));
+    OGR_F_SetFieldString(feat, 0, m->path);
+    OGR_F_SetGeometryDirectly(feat, geom);
+    if (OGR_L_CreateFeature(layer, feat) != OGRERR_NONE) {
+      snprintf(msg, msg_len, "Failed to write tile index feature for: %s", m->path);
+      ok = 0;
+    }
+    OGR_F_Destroy(feat);
+  }
+  if (ct != NULL) OCTDestroyCoordinateTransformation(ct);
+  if (src_srs != NULL) OSRDestroySpatialReference(src_srs);
+  OSRDestroySpatialReference(srs);
+
+  if (in_transaction) {
+    if (ok) {
+      ok = GDALDatasetCommitTransaction(ds) == OGRERR_NONE;
+      if (!ok) snprintf(msg, msg_len, "Failed to write tile index: %s", index_path);
+    } else {
+      GDALDatasetRollbackTransaction(ds);
+    }
+  }
+  GDALClose(ds);
+
+  if (ok && !ti_write_gti(gti_path, index_path, &meta[0], bbox, width, height,
+                          target_wkt, resample)) {
+    snprintf(msg, msg_len, "Failed to write GTI description: %s", gti_path);
+    ok = 0;
+  }
+  if (!ok) {
+    GDALDeleteDataset(drv, index_path);
+    VSIUnlink(gti_path);
+  }
+  return ok;
+}
+
+#else
+
+/* The GTI driver appeared in GDAL 3.9 */
+int rgio_write_tile_index(const char *index_path, const char *gti_path,
+                          const rgio_src_meta *meta, int n, const double *bbox,
+                          int width, int height, const char *target_wkt,
+                          const char *resample, char *msg, size_t msg_len) {
+  snprintf(msg, msg_len, "GTI tile indexes require GDAL >= 3.9");
+  return 0;
+}
+
+#endif
@@ -1,6 +1,12 @@
 /*
  * vectorize.c
  * Raster to vector polygonization
+ *
+ * Besides a single GDALPolygonize() pass over the band, a tiled mode
+ * polygonizes blocks of `tile_size` pixels on a pool of worker threads
+ * (each with its own dataset handles) while the calling thread dissolves,
+ * by value, the polygons cut at tile seams as soon as their neighbouring
+ * tiles are done, so the output holds the same regions as the single pass.
  */
 
 #include <R.h>
@@ -11,10 +17,724 @@
 #include <gdal_alg.h>
 #include <cpl_conv.h>
 #include <cpl_string.h>
+#include <cpl_multiproc.h>
+#include <math.h>
 #include <string.h>
+#include "gdal_utils.h"
 
+/* -------------------------------------------------------------------------- */
+/*  Tiled polygonization                                                      */
+/* -------------------------------------------------------------------------- */
+
+/* Tile borders shared with a neighbour tile that a polygon touches */
+#define VEC_SEAM_LEFT   1
+#define VEC_SEAM_RIGHT  2
+#define VEC_SEAM_TOP    4
+#define VEC_SEAM_BOTTOM 8
+
+/* Tile edge used when filters are requested without `tile_size` */
+#define VEC_FILTER_TILE 1024
+
+/*
+ * Tiles are polygonized in global pixel/line space (unit geotransform
+ * shifted to the tile origin), so vertices are exact integers: envelopes
+ * compare exactly with seams, pieces of a region meet vertex for vertex,
+ * and the source geotransform is applied only when a region is written.
+ */
+typedef struct {
+  OGRGeometryH geom;
+  int value;
+  int seams;
+  double px_min, px_max, py_min, py_max;  /* envelope in pixel/line space */
+} vec_poly;
+
+typedef struct {
+  vec_poly *polys;
+  int n, cap;
+} vec_tile;
+
+typedef struct {
+  const char *src_path;
+  const char *mask_path;
+  int band_index;
+  int conn;
+  int tile_size;
+  int width, height;
+  int n_tx, n_ty;
+  vec_tile *tiles;
+  CPLMutex *mutex;
+  CPLCond *cond;        /* signalled when a tile is done or a worker exits */
+  int next_tile;
+  int *done;            /* finished tiles, in completion order */
+  int n_done;
+  int active;           /* workers still running */
+  int failed;
+  char message[512];
+} vec_job;
+
+static void vec_job_fail(vec_job *job, const char *msg) {
+  CPLAcquireMutex(job->mutex, 1000.0);
+  if (!job->failed) {
+    job->failed = 1;
+    snprintf(job->message, sizeof(job->message), "%s", msg);
+  }
+  CPLReleaseMutex(job->mutex);
+}
+
+static void vec_tile_push(vec_tile *tile, const vec_poly *p) {
+  if (tile->n == tile->cap) {
+    tile->cap = tile->cap ? tile->cap * 2 : 64;
+    tile->polys = (vec_poly *) CPLRealloc(tile->polys, tile->cap * sizeof(vec_poly));
+  }
+  tile->polys[tile->n++] = *p;
+}
+
+static void vec_tile_free(vec_tile *tile) {
+  for (int i = 0; i < tile->n; i++) {
+    if (tile->polys[i].geom) OGR_G_DestroyGeometry(tile->polys[i].geom);
+  }
+  CPLFree(tile->polys);
+  memset(tile, 0, sizeof(*tile));
+}
+
+/*
+ * Polygonize tile `t` through a MEM copy of its window (Int32, as
+ * GDALPolygonize() reads it) into a scratch layer of `scratch_ds`, then keep
+ * the geometries together with their seam flags.
+ */
+static int vec_polygonize_tile(vec_job *job, int t,
+                               GDALRasterBandH src_band, GDALRasterBandH mask_band,
+                               GDALDriverH mem_drv, GDALDatasetH scratch_ds,
+                               GInt32 *buf) {
+  int tx = t % job->n_tx, ty = t / job->n_tx;
+  int x0 = tx * job->tile_size, y0 = ty * job->tile_size;
+  int w = job->width - x0 < job->tile_size ? job->width - x0 : job->tile_size;
+  int h = job->height - y0 < job->tile_size ? job->height - y0 : job->tile_size;
+
+  GDALDatasetH mem_ds = GDALCreate(mem_drv, "", w, h, mask_band ? 2 : 1,
+                                   GDT_Int32, NULL);
+  if (mem_ds == NULL) return 0;
+
+  double tile_gt[6] = {x0, 1, 0, y0, 0, 1};
+  GDALSetGeoTransform(mem_ds, tile_gt);
+
+  int ok = GDALRasterIO(src_band, GF_Read, x0, y0, w, h, buf, w, h,
+                        GDT_Int32, 0, 0) == CE_None &&
+           GDALRasterIO(GDALGetRasterBand(mem_ds, 1), GF_Write, 0, 0, w, h,
+                        buf, w, h, GDT_Int32, 0, 0) == CE_None;
+  if (ok && mask_band) {
+    ok = GDALRasterIO(mask_band, GF_Read, x0, y0, w, h, buf, w, h,
+                      GDT_Int32, 0, 0) == CE_None &&
+         GDALRasterIO(GDALGetRasterBand(mem_ds, 2), GF_Write, 0, 0, w, h,
+                      buf, w, h, GDT_Int32, 0, 0) == CE_None;
+  }
+
+  OGRLayerH layer = NULL;
+  if (ok) {
+    layer = GDALDatasetCreateLayer(scratch_ds, "tile", NULL, wkbPolygon, NULL);
+    OGRFieldDefnH fld = OGR_Fld_Create("value", OFTInteger);
+    ok = layer != NULL && OGR_L_CreateField(layer, fld, TRUE) == OGRERR_NONE;
+    OGR_Fld_Destroy(fld);
+  }
+
+  if (ok) {
+    char **poly_opts = CSLAddString(NULL, job->conn == 8 ? "8CONNECTED=YES"
+                                                          : "8CONNECTED=NO");
+    ok = GDALPolygonize(GDALGetRasterBand(mem_ds, 1),
+                        mask_band ? GDALGetRasterBand(mem_ds, 2) : NULL,
+                        layer, 0, poly_opts, NULL, NULL) == CE_None;
+    CSLDestroy(poly_opts);
+  }
+
+  if (ok) {
+    vec_tile *tile = &job->tiles[t];
+    OGRFeatureH feat;
+    OGR_L_ResetReading(layer);
+    while ((feat = OGR_L_GetNextFeature(layer)) != NULL) {
+      vec_poly p;
+      OGREnvelope env;
+      p.geom = OGR_F_StealGeometry(feat);
+      p.value = OGR_F_GetFieldAsInteger(feat, 0);
+      OGR_F_Destroy(feat);
+      if (p.geom == NULL) continue;
+
+      OGR_G_GetEnvelope(p.geom, &env);
+      p.px_min = env.MinX;
+      p.px_max = env.MaxX;
+      p.py_min = env.MinY;
+      p.py_max = env.MaxY;
+
+      p.seams = 0;
+      if (x0 > 0 && p.px_min <= x0) p.seams |= VEC_SEAM_LEFT;
+      if (x0 + w < job->width && p.px_max >= x0 + w) p.seams |= VEC_SEAM_RIGHT;
+      if (y0 > 0 && p.py_min <= y0) p.seams |= VEC_SEAM_TOP;
+      if (y0 + h < job->height && p.py_max >= y0 + h) p.seams |= VEC_SEAM_BOTTOM;
+      vec_tile_push(tile, &p);
+    }
+  }
+
+  if (layer != NULL) {
+    GDALDatasetDeleteLayer(scratch_ds, GDALDatasetGetLayerCount(scratch_ds) - 1);
+  }
+  GDALClose(mem_ds);
+  return ok;
+}
+
+static void vec_worker(void *arg) {
+  vec_job *job = (vec_job *) arg;
+
+  GDALDatasetH src_ds = GDALOpen(job->src_path, GA_ReadOnly);
+  GDALDatasetH mask_ds = job->mask_path[0] ? GDALOpen(job->mask_path, GA_ReadOnly) : NULL;
+  GDALDriverH vec_drv = rgio_mem_vector_driver();
+  GDALDatasetH scratch_ds = vec_drv ?
+    GDALCreate(vec_drv, "", 0, 0, 0, GDT_Unknown, NULL) : NULL;
+
+  if (src_ds == NULL || (job->mask_path[0] && mask_ds == NULL) || scratch_ds == NULL) {
+    vec_job_fail(job, "Failed to open datasets in polygonize worker");
+  } else {
+    GDALRasterBandH src_band = GDALGetRasterBand(src_ds, job->band_index);
+    GDALRasterBandH mask_band = mask_ds ? GDALGetRasterBand(mask_ds, 1) : NULL;
+    GDALDriverH mem_drv = GDALGetDriverByName("MEM");
+    GInt32 *buf = (GInt32 *) CPLMalloc((size_t) job->tile_size * job->tile_size *
+                                        sizeof(GInt32));
+    int n_tiles = job->n_tx * job->n_ty;
+
+    for (;;) {
+      CPLAcquireMutex(job->mutex, 1000.0);
+      int t = job->failed ? n_tiles : job->next_tile++;
+      CPLReleaseMutex(job->mutex);
+      if (t >= n_tiles) break;
+
+      if (!vec_polygonize_tile(job, t, src_band, mask_band, mem_drv, scratch_ds, buf)) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Polygonize failed for tile %d", t);
+        vec_job_fail(job, msg);
+        break;
+      }
+
+      /* Hand the tile to the writer */
+      CPLAcquireMutex(job->mutex, 1000.0);
+      job->done[job->n_done++] = t;
+      CPLCondSignal(job->cond);
+      CPLReleaseMutex(job->mutex);
+    }
+    CPLFree(buf);
+  }
+
+  if (scratch_ds) GDALClose(scratch_ds);
+  if (mask_ds) GDALClose(mask_ds);
+  if (src_ds) GDALClose(src_ds);
+
+  CPLAcquireMutex(job->mutex, 1000.0);
+  job->active--;
+  CPLCondSignal(job->cond);
+  CPLReleaseMutex(job->mutex);
+}
+
+/* Union-find over the seam pieces handed to the writer */
+static int vec_find(int *parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+/*
+ * Pieces on either side of a seam belong to one region when they carry the
+ * same value and touch: along a boundary segment, or, with 8-connectedness,
+ * also at a single pixel corner.
+ */
+static int vec_linked(const vec_poly *a, const vec_poly *b, int conn) {
+  if (a->value != b->value) return 0;
+  if (a->px_max < b->px_min || b->px_max < a->px_min ||
+      a->py_max < b->py_min || b->py_max < a->py_min) return 0;
+  if (conn == 8) return OGR_G_Intersects(a->geom, b->geom);
+
+  OGRGeometryH inter = OGR_G_Intersection(a->geom, b->geom);
+  if (inter == NULL) return 0;
+  int shared = !OGR_G_IsEmpty(inter) && OGR_G_GetDimension(inter) >= 1;
+  OGR_G_DestroyGeometry(inter);
+  return shared;
+}
+
+/* Seam flags a piece needs to reach the neighbour tile at (dx, dy) */
+static int vec_seam_mask(int dx, int dy) {
+  return (dx < 0 ? VEC_SEAM_LEFT : 0) | (dx > 0 ? VEC_SEAM_RIGHT : 0) |
+         (dy < 0 ? VEC_SEAM_TOP : 0) | (dy > 0 ? VEC_SEAM_BOTTOM : 0);
+}
+
+static double vec_ring_signed_area(OGRGeometryH ring) {
+  int n = OGR_G_GetPointCount(ring);
+  double sum = 0;
+  for (int i = 0; i + 1 < n; i++) {
+    sum += OGR_G_GetX(ring, i) * OGR_G_GetY(ring, i + 1) -
+           OGR_G_GetX(ring, i + 1) * OGR_G_GetY(ring, i);
+  }
+  return sum / 2;
+}
+
+/*
+ * Splice closed ring `b` into closed ring `a` at a vertex they share,
+ * walking `b` in the same orientation as `a`; returns NULL when they share
+ * no vertex. This is the self-touching ring GDALPolygonize() builds for
+ * pixels joined only at a corner.
+ */
+static OGRGeometryH vec_splice_rings(OGRGeometryH a, OGRGeometryH b) {
+  int na = OGR_G_GetPointCount(a), nb = OGR_G_GetPointCount(b);
+  for (int i = 0; i + 1 < na; i++) {
+    double x = OGR_G_GetX(a, i), y = OGR_G_GetY(a, i);
+    for (int j = 0; j + 1 < nb; j++) {
+      if (OGR_G_GetX(b, j) != x || OGR_G_GetY(b, j) != y) continue;
+
+      int reverse = (vec_ring_signed_area(a) > 0) != (vec_ring_signed_area(b) > 0);
+      OGRGeometryH ring = OGR_G_CreateGeometry(wkbLinearRing);
+      for (int k = 0; k <= i; k++)
+        OGR_G_AddPoint_2D(ring, OGR_G_GetX(a, k), OGR_G_GetY(a, k));
+      for (int k = 1; k < nb; k++) {
+        int m = reverse ? (j - k + 2 * (nb - 1)) % (nb - 1) : (j + k) % (nb - 1);
+        OGR_G_AddPoint_2D(ring, OGR_G_GetX(b, m), OGR_G_GetY(b, m));
+      }
+      for (int k = i + 1; k < na; k++)
+        OGR_G_AddPoint_2D(ring, OGR_G_GetX(a, k), OGR_G_GetY(a, k));
+      return ring;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * One polygon for a region whose dissolved parts meet only at pixel
+ * corners: their exterior rings are spliced at the shared vertices and all
+ * holes are kept. Takes ownership of `multi`; when a part touches the rest
+ * only through a hole, the MultiPolygon itself is returned.
+ */
+static OGRGeometryH vec_join_corners(OGRGeometryH multi) {
+  int n = OGR_G_GetGeometryCount(multi);
+  int *joined = (int *) CPLCalloc(n, sizeof(int));
+  OGRGeometryH shell = OGR_G_Clone(OGR_G_GetGeometryRef(OGR_G_GetGeometryRef(multi, 0), 0));
+  int n_joined = 1, progress = 1;
+  joined[0] = 1;
+
+  while (n_joined < n && progress) {
+    progress = 0;
+    for (int k = 1; k < n; k++) {
+      if (joined[k]) continue;
+      OGRGeometryH ring = vec_splice_rings(
+        shell, OGR_G_GetGeometryRef(OGR_G_GetGeometryRef(multi, k), 0));
+      if (ring == NULL) continue;
+      OGR_G_DestroyGeometry(shell);
+      shell = ring;
+      joined[k] = 1;
+      n_joined++;
+      progress = 1;
+    }
+  }
+
+  OGRGeometryH out = multi;
+  if (n_joined == n) {
+    out = OGR_G_CreateGeometry(wkbPolygon);
+    OGR_G_AddGeometryDirectly(out, shell);
+    shell = NULL;
+    for (int k = 0; k < n; k++) {
+      OGRGeometryH part = OGR_G_GetGeometryRef(multi, k);
+      for (int r = 1; r < OGR_G_GetGeometryCount(part); r++)
+        OGR_G_AddGeometry(out, OGR_G_GetGeometryRef(part, r));
+    }
+    OGR_G_DestroyGeometry(multi);
+  }
+  if (shell) OGR_G_DestroyGeometry(shell);
+  CPLFree(joined);
+  return out;
+}
+
+/* Map a pixel/line space geometry to georeferenced coordinates, in place */
+static void vec_to_georef(OGRGeometryH geom, const double *gt) {
+  int n_sub = OGR_G_GetGeometryCount(geom);
+  for (int i = 0; i < n_sub; i++) vec_to_georef(OGR_G_GetGeometryRef(geom, i), gt);
+  int n = OGR_G_GetPointCount(geom);
+  for (int i = 0; i < n; i++) {
+    double x = OGR_G_GetX(geom, i), y = OGR_G_GetY(geom, i);
+    OGR_G_SetPoint_2D(geom, i, gt[0] + x * gt[1] + y * gt[2],
+                      gt[3] + x * gt[4] + y * gt[5]);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Per-feature filters                                                       */
+/* -------------------------------------------------------------------------- */
+/*
+ * Applied to every polygon just before it is written: polygons smaller than
+ * `min_area` (CRS units squared) are dropped, the rest are simplified with
+ * `tolerance` while keeping each polygon valid. Zero disables a filter.
+ */
+typedef struct {
+  double tolerance;
+  double min_area;
+} vec_filter;
+
+static int vec_filter_active(const vec_filter *filter) {
+  return filter != NULL && (filter->tolerance > 0 || filter->min_area > 0);
+}
+
+/* Takes ownership of `geom`; returns the geometry to write, or NULL to drop */
+static OGRGeometryH vec_filter_geometry(const vec_filter *filter, OGRGeometryH geom) {
+  if (!vec_filter_active(filter)) return geom;
+
+  if (filter->min_area > 0 && OGR_G_Area(geom) < filter->min_area) {
+    OGR_G_DestroyGeometry(geom);
+    return NULL;
+  }
+  if (filter->tolerance > 0) {
+    OGRGeometryH simple = OGR_G_SimplifyPreserveTopology(geom, filter->tolerance);
+    if (simple != NULL && !OGR_G_IsEmpty(simple)) {
+      OGR_G_DestroyGeometry(geom);
+      geom = simple;
+    } else if (simple != NULL) {
+      OGR_G_DestroyGeometry(simple);
+    }
+  }
+  return geom;
+}
+
+/* Takes ownership of `geom`; filtered-out polygons count as written */
+static OGRErr vec_write_polygon(OGRLayerH layer, int field_index,
+                                OGRGeometryH geom, int value,
+                                const vec_filter *filter) {
+  geom = vec_filter_geometry(filter, geom);
+  if (geom == NULL) return OGRERR_NONE;
+
+  OGRFeatureH feat = OGR_F_Create(OGR_L_GetLayerDefn(layer));
+  OGR_F_SetFieldInteger(feat, field_index, value);
+  OGR_F_SetGeometryDirectly(feat, geom);
+  OGRErr err = OGR_L_CreateFeature(layer, feat);
+  OGR_F_Destroy(feat);
+  return err;
+}
+
+/*
+ * Seam pieces handed to the writer. Each region (union-find root) keeps a
+ * member list and `open`, the number of (member, neighbour tile) pairs whose
+ * neighbour is not finished yet; at zero no piece can join the region any
+ * more and it is dissolved and written.
+ */
+typedef struct {
+  vec_poly *pieces;
+  int n, cap;
+  int *parent, *next, *tail, *open;
+  int *tile_first, *tile_count;  /* pieces of each finished tile */
+  char *finished;                /* per tile */
+} vec_regions;
+
+static int vec_regions_add(vec_regions *rg, const vec_poly *p) {
+  if (rg->n == rg->cap) {
+    rg->cap = rg->cap ? rg->cap * 2 : 256;
+    rg->pieces = (vec_poly *) CPLRealloc(rg->pieces, rg->cap * sizeof(vec_poly));
+    rg->parent = (int *) CPLRealloc(rg->parent, rg->cap * sizeof(int));
+    rg->next = (int *) CPLRealloc(rg->next, rg->cap * sizeof(int));
+    rg->tail = (int *) CPLRealloc(rg->tail, rg->cap * sizeof(int));
+    rg->open = (int *) CPLRealloc(rg->open, rg->cap * sizeof(int));
+  }
+  int i = rg->n++;
+  rg->pieces[i] = *p;
+  rg->parent[i] = i;
+  rg->next[i] = -1;
+  rg->tail[i] = i;
+  rg->open[i] = 0;
+  return i;
+}
+
+static void vec_regions_union(vec_regions *rg, int a, int b) {
+  a = vec_find(rg->parent, a);
+  b = vec_find(rg->parent, b);
+  if (a == b) return;
+  if (b < a) { int tmp = a; a = b; b = tmp; }
+  rg->parent[b] = a;
+  rg->next[rg->tail[a]] = b;
+  rg->tail[a] = rg->tail[b];
+  rg->open[a] += rg->open[b];
+}
+
+/* Dissolve the region rooted at `root` into one polygon and write it */
+static OGRErr vec_write_region(vec_regions *rg, int root, const double *gt,
+                               OGRLayerH layer, int field_index,
+                               const vec_filter *filter) {
+  int value = rg->pieces[root].value;
+  OGRGeometryH geom;
+
+  if (rg->next[root] < 0) {
+    geom = rg->pieces[root].geom;
+    rg->pieces[root].geom = NULL;
+  } else {
+    OGRGeometryH parts = OGR_G_CreateGeometry(wkbMultiPolygon);
+    for (int m = root; m >= 0; m = rg->next[m]) {
+      OGR_G_AddGeometryDirectly(parts, rg->pieces[m].geom);
+      rg->pieces[m].geom = NULL;
+    }
+    geom = OGR_G_UnionCascaded(parts);
+    OGR_G_DestroyGeometry(parts);
+    if (geom == NULL) return OGRERR_FAILURE;
+    if (wkbFlatten(OGR_G_GetGeometryType(geom)) == wkbMultiPolygon)
+      geom = vec_join_corners(geom);
+  }
+
+  vec_to_georef(geom, gt);
+  return vec_write_polygon(layer, field_index, geom, value, filter);
+}
+
+/*
+ * Take finished tile `t`: write its inner polygons, link its seam pieces
+ * with those of finished neighbour tiles, and write every region that
+ * cannot grow any further.
+ */
+static OGRErr vec_take_tile(vec_job *job, vec_regions *rg, int t, const double *gt,
+                            OGRLayerH layer, int field_index,
+                            const vec_filter *filter) {
+  int tx = t % job->n_tx, ty = t / job->n_tx;
+  vec_tile *tile = &job->tiles[t];
+  OGRErr err = OGRERR_NONE;
+
+  rg->finished[t] = 1;
+  rg->tile_first[t] = rg->n;
+  for (int i = 0; i < tile->n; i++) {
+    vec_poly *p = &tile->polys[i];
+    if (p->seams == 0) {
+      if (err == OGRERR_NONE) {
+        vec_to_georef(p->geom, gt);
+        err = vec_write_polygon(layer, field_index, p->geom, p->value, filter);
+      } else {
+        OGR_G_DestroyGeometry(p->geom);
+      }
+    } else {
+      vec_regions_add(rg, p);
+    }
+    p->geom = NULL;
+  }
+  rg->tile_count[t] = rg->n - rg->tile_first[t];
+  vec_tile_free(tile);
+  if (err != OGRERR_NONE) return err;
+
+  /* Neighbour tiles across an edge, and across a corner with 8-connectedness */
+  for (int dy = -1; dy <= 1; dy++) {
+    for (int dx = -1; dx <= 1; dx++) {
+      if ((dx == 0 && dy == 0) || (job->conn == 4 && dx != 0 && dy != 0)) continue;
+      int nx = tx + dx, ny = ty + dy;
+      if (nx < 0 || ny < 0 || nx >= job->n_tx || ny >= job->n_ty) continue;
+      int nt = ny * job->n_tx + nx;
+      int mask = vec_seam_mask(dx, dy), back = vec_seam_mask(-dx, -dy);
+
+      for (int k = rg->tile_first[t]; k < rg->tile_first[t] + rg->tile_count[t]; k++) {
+        if ((rg->pieces[k].seams & mask) == mask && !rg->finished[nt])
+          rg->open[vec_find(rg->parent, k)]++;
+      }
+      if (!rg->finished[nt]) continue;
+
+      int first = rg->tile_first[nt], last = first + rg->tile_count[nt];
+      for (int j = first; j < last; j++) {
+        if ((rg->pieces[j].seams & back) == back)
+          rg->open[vec_find(rg->parent, j)]--;
+      }
+      for (int k = rg->tile_first[t]; k < rg->tile_first[t] + rg->tile_count[t]; k++) {
+        if ((rg->pieces[k].seams & mask) != mask) continue;
+        for (int j = first; j < last; j++) {
+          if ((rg->pieces[j].seams & back) == back &&
+              vec_linked(&rg->pieces[k], &rg->pieces[j], job->conn))
+            vec_regions_union(rg, k, j);
+        }
+      }
+    }
+  }
+
+  /* Regions touched by this tile that no unfinished tile can extend */
+  for (int dy = -1; dy <= 1 && err == OGRERR_NONE; dy++) {
+    for (int dx = -1; dx <= 1 && err == OGRERR_NONE; dx++) {
+      int nx = tx + dx, ny = ty + dy;
+      if (nx < 0 || ny < 0 || nx >= job->n_tx || ny >= job->n_ty) continue;
+      int nt = ny * job->n_tx + nx;
+      if (!rg->finished[nt]) continue;
+      int first = rg->tile_first[nt], last = first + rg->tile_count[nt];
+      for (int j = first; j < last && err == OGRERR_NONE; j++) {
+        int root = vec_find(rg->parent, j);
+        if (rg->open[root] == 0 && rg->pieces[root].geom != NULL)
+          err = vec_write_region(rg, root, gt, layer, field_index, filter);
+      }
+    }
+  }
+  return err;
+}
+
+/*
+ * Tiled counterpart of GDALPolygonize(): writes to `layer` the same regions
+ * as a single pass, one feature per region. Workers polygonize tiles while
+ * the calling thread takes them in completion order, writes polygons clear
+ * of the seams at once, and dissolves each region cut by seams as soon as
+ * all tiles it reaches are finished, so only open regions stay in memory.
+ */
+static CPLErr vec_polygonize_tiled(GDALDatasetH src_ds, const char *src_path,
+                                   int band_index, const char *mask_path,
+                                   int conn, int tile_size, int threads,
+                                   OGRLayerH layer, int field_index,
+                                   const vec_filter *filter,
+                                   char *message, size_t message_len) {
+  vec_job job;
+  memset(&job, 0, sizeof(job));
+  job.src_path = src_path;
+  job.mask_path = mask_path;
+  job.band_index = band_index;
+  job.conn = conn;
+  job.tile_size = tile_size;
+  job.width = GDALGetRasterXSize(src_ds);
+  job.height = GDALGetRasterYSize(src_ds);
+  job.n_tx = (job.width + tile_size - 1) / tile_size;
+  job.n_ty = (job.height + tile_size - 1) / tile_size;
+
+  double gt[6];
+  if (GDALGetGeoTransform(src_ds, gt) != CE_None) {
+    gt[0] = 0; gt[1] = 1; gt[2] = 0;
+    gt[3] = 0; gt[4] = 0; gt[5] = 1;
+  }
+
+  int n_tiles = job.n_tx * job.n_ty;
+  job.tiles = (vec_tile *) CPLCalloc(n_tiles, sizeof(vec_tile));
+  job.done = (int *) CPLMalloc(n_tiles * sizeof(int));
+  job.mutex = CPLCreateMutex();
+  job.cond = CPLCreateCond();
+
+  vec_regions rg;
+  memset(&rg, 0, sizeof(rg));
+  rg.tile_first = (int *) CPLCalloc(n_tiles, sizeof(int));
+  rg.tile_count = (int *) CPLCalloc(n_tiles, sizeof(int));
+  rg.finished = (char *) CPLCalloc(n_tiles, 1);
+
+  int n_threads = rgio_resolve_threads(threads, n_tiles);
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_threads, sizeof(CPLJoinableThread *));
+  for (int i = 0; i < n_threads; i++) {
+    workers[i] = CPLCreateJoinableThread(vec_worker, &job);
+    if (workers[i] != NULL) job.active++;
+    else job.failed = 1;
+  }
+  if (job.failed) snprintf(job.message, sizeof(job.message),
+                           "Failed to start polygonize worker");
+  CPLReleaseMutex(job.mutex);
+
+  /* Single writer: take tiles as workers finish them */
+  OGR_L_StartTransaction(layer);
+  int taken = 0;
+  for (;;) {
+    CPLAcquireMutex(job.mutex, 1000.0);
+    while (taken == job.n_done && job.active > 0) CPLCondWait(job.cond, job.mutex);
+    int t = taken < job.n_done ? job.done[taken++] : -1;
+    int failed = job.failed;
+    CPLReleaseMutex(job.mutex);
+    if (t < 0) break;
+    if (failed) continue;
+
+    if (vec_take_tile(&job, &rg, t, gt, layer, field_index, filter) != OGRERR_NONE)
+      vec_job_fail(&job, "Failed to write dissolved polygons");
+  }
+
+  for (int i = 0; i < n_threads; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+
+  /* Every region is closed once all tiles are taken; this is a safeguard */
+  for (int i = 0; i < rg.n && !job.failed; i++) {
+    int root = vec_find(rg.parent, i);
+    if (rg.pieces[root].geom != NULL &&
+        vec_write_region(&rg, root, gt, layer, field_index, filter) != OGRERR_NONE) {
+      job.failed = 1;
+      snprintf(job.message, sizeof(job.message), "Failed to write dissolved polygons");
+    }
+  }
+
+  CPLErr err = CE_None;
+  if (job.failed) {
+    OGR_L_RollbackTransaction(layer);
+    snprintf(message, message_len, "%s", job.message);
+    err = CE_Failure;
+  } else {
+    OGR_L_CommitTransaction(layer);
+  }
+
+  for (int i = 0; i < rg.n; i++) {
+    if (rg.pieces[i].geom) OGR_G_DestroyGeometry(rg.pieces[i].geom);
+  }
+  for (int t = 0; t < n_tiles; t++) vec_tile_free(&job.tiles[t]);
+  CPLFree(rg.pieces);
+  CPLFree(rg.parent);
+  CPLFree(rg.next);
+  CPLFree(rg.tail);
+  CPLFree(rg.open);
+  CPLFree(rg.tile_first);
+  CPLFree(rg.tile_count);
+  CPLFree(rg.finished);
+  CPLDestroyCond(job.cond);
+  CPLDestroyMutex(job.mutex);
+  CPLFree(job.done);
+  CPLFree(job.tiles);
+  return err;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  In-memory result                                                          */
+/* -------------------------------------------------------------------------- */
+/*
+ * Collect the polygons of an in-memory layer as
+ * list(value = <integer>, geometry = <list of raw WKB>, crs = <WKT>).
+ */
+static SEXP vec_collect(OGRLayerH layer, int field_index, const char *crs) {
+  R_xlen_t n = (R_xlen_t) OGR_L_GetFeatureCount(layer, TRUE);
+  SEXP values = PROTECT(Rf_allocVector(INTSXP, n));
+  SEXP geoms = PROTECT(Rf_allocVector(VECSXP, n));
+
+  R_xlen_t i = 0;
+  OGRFeatureH feat;
+  OGR_L_ResetReading(layer);
+  while (i < n && (feat = OGR_L_GetNextFeature(layer)) != NULL) {
+    INTEGER(values)[i] = OGR_F_GetFieldAsInteger(feat, field_index);
+    OGRGeometryH geom = OGR_F_GetGeometryRef(feat);
+    if (geom != NULL) {
+      SEXP wkb = Rf_allocVector(RAWSXP, OGR_G_WkbSize(geom));
+      SET_VECTOR_ELT(geoms, i, wkb);
+      OGR_G_ExportToWkb(geom, wkbNDR, RAW(wkb));
+    }
+    OGR_F_Destroy(feat);
+    i++;
+  }
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 3));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 3));
+  SET_VECTOR_ELT(result, 0, values);
+  SET_STRING_ELT(names, 0, Rf_mkChar("value"));
+  SET_VECTOR_ELT(result, 1, geoms);
+  SET_STRING_ELT(names, 1, Rf_mkChar("geometry"));
+  SET_VECTOR_ELT(result, 2, Rf_mkString(crs != NULL ? crs : ""));
+  SET_STRING_ELT(names, 2, Rf_mkChar("crs"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  UNPROTECT(4);
+  return result;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  _rgio_vec()                                                               */
+/* -------------------------------------------------------------------------- */
+
+/*
+ * An empty `dst` polygonizes into an in-memory layer and returns its
+ * features (see vec_collect()) instead of writing a dataset.
+ *
+ * @param tile_size Tile edge in pixels for tiled polygonization (0 = single pass)
+ * @param threads Worker threads for the tiled mode (0 = all CPUs)
+ * @param simplify_tolerance Simplification tolerance in CRS units (0 = none)
+ * @param min_area Minimum polygon area in CRS units squared (0 = keep all)
+ */
 SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
-               SEXP field, SEXP connectedness, SEXP mask, SEXP co) {
+               SEXP field, SEXP connectedness, SEXP mask, SEXP co,
+               SEXP tile_size, SEXP threads, SEXP simplify_tolerance,
+               SEXP min_area) {
 
   const char *src_path = CHAR(STRING_ELT(src, 0));
   const char *dst_path = CHAR(STRING_ELT(dst, 0));
@@ -23,6 +743,13 @@ SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
   int band_index = INTEGER(band)[0];
   int conn = INTEGER(connectedness)[0];
   const char *mask_path = CHAR(STRING_ELT(mask, 0));
+  int tile = INTEGER(tile_size)[0];
+  int thread_count = INTEGER(threads)[0];
+  int in_memory = dst_path[0] == '\0';
+  const char *dst_label = in_memory ? "in-memory output" : dst_path;
+  vec_filter filter;
+  filter.tolerance = REAL(simplify_tolerance)[0];
+  filter.min_area = REAL(min_area)[0];
 
   GDALAllRegister();
   OGRRegisterAll();
@@ -54,19 +781,20 @@ SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
     }
   }
 
-  GDALDriverH drv = GDALGetDriverByName(driver_name);
+  GDALDriverH drv = in_memory ? rgio_mem_vector_driver()
+                              : GDALGetDriverByName(driver_name);
   if (drv == NULL) {
     if (mask_ds) GDALClose(mask_ds);
     GDALClose(src_ds);
-    error("Vector driver not available: %s", driver_name);
+    error("Vector driver not available: %s", in_memory ? "Memory" : driver_name);
   }
 
   /* Remove existing dataset if present */
-  GDALDeleteDataset(drv, dst_path);
+  if (!in_memory) GDALDeleteDataset(drv, dst_path);
 
   char **create_opts = NULL;
   int co_len = LENGTH(co);
-  for (int i = 0; i < co_len; i++) {
+  for (int i = 0; i < co_len && !in_memory; i++) {
     create_opts = CSLAddString(create_opts, CHAR(STRING_ELT(co, i)));
   }
 
@@ -76,7 +804,7 @@ SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
   if (dst_ds == NULL) {
     if (mask_ds) GDALClose(mask_ds);
     GDALClose(src_ds);
-    error("Failed to create vector dataset: %s", dst_path);
+    error("Failed to create vector dataset: %s", dst_label);
   }
 
   const char *proj = GDALGetProjectionRef(src_ds);
@@ -98,7 +826,7 @@ SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
     GDALClose(dst_ds);
     if (mask_ds) GDALClose(mask_ds);
     GDALClose(src_ds);
-    error("Failed to create output layer in %s", dst_path);
+    error("Failed to create output layer in %s", dst_label);
   }
 
   OGRFieldDefnH fld = OGR_Fld_Create(field_name, OFTInteger);
@@ -119,23 +847,406 @@ SEXP _rgio_vec(SEXP src, SEXP dst, SEXP format, SEXP band,
     error("Unable to locate field '%s' in output layer", field_name);
   }
 
-  char **poly_opts = NULL;
-  if (conn == 8) {
-    poly_opts = CSLAddString(poly_opts, "8CONNECTED=YES");
+  /*
+   * Filters need each polygon as it is emitted, which GDALPolygonize()
+   * does not offer: a filtered single pass goes through the tiled path,
+   * whose memory is bounded by a tile and the regions still open at seams.
+   */
+  if (tile == 0 && vec_filter_active(&filter)) tile = VEC_FILTER_TILE;
+
+  CPLErr err;
+  char message[512] = "";
+  if (tile > 0) {
+    err = vec_polygonize_tiled(src_ds, src_path, band_index, mask_path, conn,
+                               tile, thread_count, layer, field_index,
+                               &filter, message, sizeof(message));
   } else {
-    poly_opts = CSLAddString(poly_opts, "8CONNECTED=NO");
+    char **poly_opts = NULL;
+    if (conn == 8) {
+      poly_opts = CSLAddString(poly_opts, "8CONNECTED=YES");
+    } else {
+      poly_opts = CSLAddString(poly_opts, "8CONNECTED=NO");
+    }
+
+    err = GDALPolygonize(src_band, mask_band, layer, field_index, poly_opts, NULL, NULL);
+    CSLDestroy(poly_opts);
   }
 
-  CPLErr err = GDALPolygonize(src_band, mask_band, layer, field_index, poly_opts, NULL, NULL);
-  CSLDestroy(poly_opts);
+  SEXP result = dst;
+  if (in_memory && err == CE_None) {
+    result = PROTECT(vec_collect(layer, field_index, proj));
+  }
 
   if (mask_ds) GDALClose(mask_ds);
   GDALClose(dst_ds);
   GDALClose(src_ds);
 
   if (err != CE_None) {
-    error("Polygonize operation failed for %s", src_path);
+    if (message[0] != '\0')
+      error("Polygonize operation failed for %s (%s): %s", src_path, dst_label, message);
+    error("Polygonize operation failed for %s (%s)", src_path, dst_label);
+  }
+
+  if (in_memory) UNPROTECT(1);
+  return result;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Batch polygonization                                                      */
+/* -------------------------------------------------------------------------- */
+/*
+ * Many (source, band) pairs are polygonized by worker threads into private
+ * in-memory layers. Finished sources go through a bounded queue to the
+ * calling thread, the single writer that appends them to one output layer.
+ */
+typedef struct {
+  int job;
+  OGRGeometryH *geoms;
+  int *values;
+  int n;
+  char *error;  /* NULL on success */
+} vec_batch_result;
+
+typedef struct {
+  char **src_paths;
+  int *bands;
+  int n_jobs;
+  int conn;
+  char *layer_wkt;          /* output layer CRS, NULL when it has none */
+  CPLMutex *mutex;
+  CPLCond *not_empty;
+  CPLCond *not_full;
+  int next_job;
+  vec_batch_result *queue;  /* ring buffer of q_cap results */
+  int q_cap, q_head, q_len;
+} vec_batch;
+
+static void vec_batch_result_free(vec_batch_result *r) {
+  for (int i = 0; i < r->n; i++) {
+    if (r->geoms[i]) OGR_G_DestroyGeometry(r->geoms[i]);
+  }
+  CPLFree(r->geoms);
+  CPLFree(r->values);
+  CPLFree(r->error);
+}
+
+/*
+ * Transformation from the CRS of `src_ds` to the output layer CRS in `*ct`,
+ * left NULL when both are the same (OSRIsSame()). Fails when only one of
+ * the two has a CRS or no transformation is available.
+ */
+static int vec_batch_transform(const vec_batch *b, GDALDatasetH src_ds,
+                               OGRCoordinateTransformationH *ct, char **error) {
+  *ct = NULL;
+  const char *proj = GDALGetProjectionRef(src_ds);
+  int has_crs = proj != NULL && strlen(proj) > 0;
+  if (!has_crs && b->layer_wkt == NULL) return 1;
+  if (!has_crs || b->layer_wkt == NULL) {
+    *error = CPLStrdup(has_crs ? "Source has a CRS but the output layer has none"
+                               : "Source has no CRS but the output layer has one");
+    return 0;
+  }
+
+  OGRSpatialReferenceH src_srs = OSRNewSpatialReference(NULL);
+  OGRSpatialReferenceH dst_srs = OSRNewSpatialReference(b->layer_wkt);
+  int ok = dst_srs != NULL && OSRSetFromUserInput(src_srs, proj) == OGRERR_NONE;
+  if (ok) {
+    OSRSetAxisMappingStrategy(src_srs, OAMS_TRADITIONAL_GIS_ORDER);
+    OSRSetAxisMappingStrategy(dst_srs, OAMS_TRADITIONAL_GIS_ORDER);
+    if (!OSRIsSame(src_srs, dst_srs)) {
+      *ct = OCTNewCoordinateTransformation(src_srs, dst_srs);
+      ok = *ct != NULL;
+    }
+  }
+  if (!ok) *error = CPLStrdup("Cannot transform source CRS to the output layer CRS");
+  OSRDestroySpatialReference(src_srs);
+  if (dst_srs) OSRDestroySpatialReference(dst_srs);
+  return ok;
+}
+
+static void vec_batch_polygonize(const vec_batch *b, int j, GDALDriverH vec_drv,
+                                 vec_batch_result *r) {
+  GDALDatasetH src_ds = GDALOpen(b->src_paths[j], GA_ReadOnly);
+  if (src_ds == NULL) {
+    r->error = CPLStrdup("Failed to open raster dataset");
+    return;
+  }
+  GDALRasterBandH band = GDALGetRasterBand(src_ds, b->bands[j]);
+  if (band == NULL) {
+    GDALClose(src_ds);
+    r->error = CPLStrdup(CPLSPrintf("Raster band %d not available", b->bands[j]));
+    return;
+  }
+  OGRCoordinateTransformationH ct = NULL;
+  if (!vec_batch_transform(b, src_ds, &ct, &r->error)) {
+    GDALClose(src_ds);
+    return;
+  }
+
+  GDALDatasetH scratch_ds = GDALCreate(vec_drv, "", 0, 0, 0, GDT_Unknown, NULL);
+  OGRLayerH layer = scratch_ds ?
+    GDALDatasetCreateLayer(scratch_ds, "polygons", NULL, wkbPolygon, NULL) : NULL;
+  OGRFieldDefnH fld = OGR_Fld_Create("value", OFTInteger);
+  int ok = layer != NULL && OGR_L_CreateField(layer, fld, TRUE) == OGRERR_NONE;
+  OGR_Fld_Destroy(fld);
+
+  if (ok) {
+    char **poly_opts = CSLAddString(NULL, b->conn == 8 ? "8CONNECTED=YES"
+                                                        : "8CONNECTED=NO");
+    ok = GDALPolygonize(band, NULL, layer, 0, poly_opts, NULL, NULL) == CE_None;
+    CSLDestroy(poly_opts);
+  }
+
+  if (ok) {
+    int cap = (int) OGR_L_GetFeatureCount(layer, TRUE);
+    r->geoms = (OGRGeometryH *) CPLMalloc((cap > 0 ? cap : 1) * sizeof(OGRGeometryH));
+    r->values = (int *) CPLMalloc((cap > 0 ? cap : 1) * sizeof(int));
+    OGRFeatureH feat;
+    OGR_L_ResetReading(layer);
+    while (r->n < cap && (feat = OGR_L_GetNextFeature(layer)) != NULL) {
+      r->geoms[r->n] = OGR_F_StealGeometry(feat);
+      r->values[r->n] = OGR_F_GetFieldAsInteger(feat, 0);
+      OGR_F_Destroy(feat);
+      if (ct != NULL && r->geoms[r->n] != NULL &&
+          OGR_G_Transform(r->geoms[r->n], ct) != OGRERR_NONE) {
+        r->n++;
+        r->error = CPLStrdup("Failed to reproject polygons to the output layer CRS");
+        break;
+      }
+      r->n++;
+    }
+  } else {
+    r->error = CPLStrdup("Polygonize operation failed");
+  }
+
+  if (ct) OCTDestroyCoordinateTransformation(ct);
+  if (scratch_ds) GDALClose(scratch_ds);
+  GDALClose(src_ds);
+}
+
+static void vec_batch_worker(void *arg) {
+  vec_batch *b = (vec_batch *) arg;
+  GDALDriverH vec_drv = rgio_mem_vector_driver();
+
+  for (;;) {
+    CPLAcquireMutex(b->mutex, 1000.0);
+    int j = b->next_job++;
+    CPLReleaseMutex(b->mutex);
+    if (j >= b->n_jobs) break;
+
+    vec_batch_result r;
+    memset(&r, 0, sizeof(r));
+    r.job = j;
+    if (vec_drv == NULL) {
+      r.error = CPLStrdup("In-memory vector driver not available");
+    } else {
+      vec_batch_polygonize(b, j, vec_drv, &r);
+    }
+
+    CPLAcquireMutex(b->mutex, 1000.0);
+    while (b->q_len == b->q_cap) CPLCondWait(b->not_full, b->mutex);
+    b->queue[(b->q_head + b->q_len) % b->q_cap] = r;
+    b->q_len++;
+    CPLCondSignal(b->not_empty);
+    CPLReleaseMutex(b->mutex);
+  }
+}
+
+/*
+ * Polygonize many (source, band) pairs into one layer.
+ *
+ * @param src Character vector of raster paths
+ * @param band Integer band index per source
+ * @param id Character source id per source, written to `id_field`
+ * @param dst, format, field, connectedness, co As in _rgio_vec()
+ * @param id_field Name of the source id attribute
+ * @param threads Worker threads (0 = all CPUs)
+ * @return list(features = <integer>, error = <character, NA when ok>)
+ */
+SEXP _rgio_vec_batch(SEXP src, SEXP band, SEXP id, SEXP dst, SEXP format,
+                     SEXP field, SEXP id_field, SEXP connectedness, SEXP co,
+                     SEXP threads) {
+  int n_jobs = Rf_length(src);
+  const char *dst_path = CHAR(STRING_ELT(dst, 0));
+  const char *driver_name = CHAR(STRING_ELT(format, 0));
+  const char *field_name = CHAR(STRING_ELT(field, 0));
+  const char *id_name = CHAR(STRING_ELT(id_field, 0));
+
+  GDALAllRegister();
+  OGRRegisterAll();
+
+  GDALDriverH drv = GDALGetDriverByName(driver_name);
+  if (drv == NULL) {
+    error("Vector driver not available: %s", driver_name);
+  }
+
+  /* Layer CRS from the first source that opens */
+  OGRSpatialReferenceH srs = NULL;
+  for (int j = 0; j < n_jobs && srs == NULL; j++) {
+    GDALDatasetH ds = GDALOpen(CHAR(STRING_ELT(src, j)), GA_ReadOnly);
+    if (ds == NULL) continue;
+    const char *proj = GDALGetProjectionRef(ds);
+    if (proj != NULL && strlen(proj) > 0) {
+      srs = OSRNewSpatialReference(NULL);
+      if (OSRSetFromUserInput(srs, proj) != OGRERR_NONE) {
+        OSRDestroySpatialReference(srs);
+        srs = NULL;
+      }
+    }
+    GDALClose(ds);
+    break;
+  }
+
+  GDALDeleteDataset(drv, dst_path);
+
+  char **create_opts = NULL;
+  for (int i = 0; i < LENGTH(co); i++) {
+    create_opts = CSLAddString(create_opts, CHAR(STRING_ELT(co, i)));
+  }
+  GDALDatasetH dst_ds = GDALCreate(drv, dst_path, 0, 0, 0, GDT_Unknown, create_opts);
+  CSLDestroy(create_opts);
+  if (dst_ds == NULL) {
+    if (srs) OSRDestroySpatialReference(srs);
+    error("Failed to create vector dataset: %s", dst_path);
   }
 
-  return dst;
+  OGRLayerH layer = GDALDatasetCreateLayer(dst_ds, "polygons", srs, wkbPolygon, NULL);
+  char *layer_wkt = NULL;
+  if (srs) {
+    OSRExportToWkt(srs, &layer_wkt);
+    OSRDestroySpatialReference(srs);
+  }
+  if (layer == NULL) {
+    CPLFree(layer_wkt);
+    GDALClose(dst_ds);
+    error("Failed to create output layer in %s", dst_path);
+  }
+
+  OGRFieldDefnH fld = OGR_Fld_Create(field_name, OFTInteger);
+  OGRFieldDefnH id_fld = OGR_Fld_Create(id_name, OFTString);
+  int ok = OGR_L_CreateField(layer, fld, TRUE) == OGRERR_NONE &&
+           OGR_L_CreateField(layer, id_fld, TRUE) == OGRERR_NONE;
+  OGR_Fld_Destroy(fld);
+  OGR_Fld_Destroy(id_fld);
+  int field_index = OGR_L_FindFieldIndex(layer, field_name, TRUE);
+  int id_index = OGR_L_FindFieldIndex(layer, id_name, TRUE);
+  if (!ok || field_index < 0 || id_index < 0) {
+    CPLFree(layer_wkt);
+    GDALClose(dst_ds);
+    error("Failed to create attribute fields '%s' and '%s'", field_name, id_name);
+  }
+
+  /* Worker inputs are copied so that threads never touch R objects */
+  vec_batch b;
+  memset(&b, 0, sizeof(b));
+  b.n_jobs = n_jobs;
+  b.conn = INTEGER(connectedness)[0];
+  b.layer_wkt = layer_wkt;
+  b.src_paths = (char **) CPLCalloc(n_jobs > 0 ? n_jobs : 1, sizeof(char *));
+  b.bands = (int *) CPLMalloc((n_jobs > 0 ? n_jobs : 1) * sizeof(int));
+  char **ids = (char **) CPLCalloc(n_jobs > 0 ? n_jobs : 1, sizeof(char *));
+  for (int j = 0; j < n_jobs; j++) {
+    b.src_paths[j] = CPLStrdup(CHAR(STRING_ELT(src, j)));
+    b.bands[j] = INTEGER(band)[j];
+    ids[j] = CPLStrdup(CHAR(STRING_ELT(id, j)));
+  }
+
+  int n_threads = rgio_resolve_threads(INTEGER(threads)[0], n_jobs);
+  b.q_cap = 2 * n_threads;
+  b.queue = (vec_batch_result *) CPLCalloc(b.q_cap, sizeof(vec_batch_result));
+  b.mutex = CPLCreateMutex();
+  CPLReleaseMutex(b.mutex);
+  b.not_empty = CPLCreateCond();
+  b.not_full = CPLCreateCond();
+
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_threads, sizeof(CPLJoinableThread *));
+  int started = 0;
+  for (int i = 0; i < n_threads; i++) {
+    workers[i] = CPLCreateJoinableThread(vec_batch_worker, &b);
+    if (workers[i]) started++;
+  }
+
+  int *features = (int *) CPLCalloc(n_jobs > 0 ? n_jobs : 1, sizeof(int));
+  char **errors = (char **) CPLCalloc(n_jobs > 0 ? n_jobs : 1, sizeof(char *));
+
+  /* Single writer: append results in completion order */
+  if (started > 0) {
+    OGR_L_StartTransaction(layer);
+    for (int done = 0; done < n_jobs; done++) {
+      CPLAcquireMutex(b.mutex, 1000.0);
+      while (b.q_len == 0) CPLCondWait(b.not_empty, b.mutex);
+      vec_batch_result r = b.queue[b.q_head];
+      b.q_head = (b.q_head + 1) % b.q_cap;
+      b.q_len--;
+      CPLCondSignal(b.not_full);
+      CPLReleaseMutex(b.mutex);
+
+      if (r.error != NULL) {
+        errors[r.job] = r.error;
+        r.error = NULL;
+      }
+      for (int k = 0; k < r.n && errors[r.job] == NULL; k++) {
+        OGRFeatureH feat = OGR_F_Create(OGR_L_GetLayerDefn(layer));
+        OGR_F_SetFieldInteger(feat, field_index, r.values[k]);
+        OGR_F_SetFieldString(feat, id_index, ids[r.job]);
+        OGR_F_SetGeometryDirectly(feat, r.geoms[k]);
+        r.geoms[k] = NULL;
+        if (OGR_L_CreateFeature(layer, feat) == OGRERR_NONE) {
+          features[r.job]++;
+        } else {
+          errors[r.job] = CPLStrdup("Failed to write features");
+        }
+        OGR_F_Destroy(feat);
+      }
+      vec_batch_result_free(&r);
+    }
+    OGR_L_CommitTransaction(layer);
+  }
+
+  for (int i = 0; i < n_threads; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLDestroyCond(b.not_full);
+  CPLDestroyCond(b.not_empty);
+  CPLDestroyMutex(b.mutex);
+  CPLFree(b.queue);
+  GDALClose(dst_ds);
+
+  for (int j = 0; j < n_jobs; j++) {
+    CPLFree(b.src_paths[j]);
+    CPLFree(ids[j]);
+  }
+  CPLFree(b.src_paths);
+  CPLFree(b.bands);
+  CPLFree(b.layer_wkt);
+  CPLFree(ids);
+
+  if (started == 0) {
+    CPLFree(errors);
+    CPLFree(features);
+    error("Failed to start polygonize workers");
+  }
+
+  SEXP r_features = PROTECT(Rf_allocVector(INTSXP, n_jobs));
+  SEXP r_errors = PROTECT(Rf_allocVector(STRSXP, n_jobs));
+  for (int j = 0; j < n_jobs; j++) {
+    INTEGER(r_features)[j] = features[j];
+    SET_STRING_ELT(r_errors, j, errors[j] ? Rf_mkChar(errors[j]) : NA_STRING);
+    CPLFree(errors[j]);
+  }
+  CPLFree(errors);
+  CPLFree(features);
+
+  SEXP result = PROTECT(Rf_allocVector(VECSXP, 2));
+  SEXP names = PROTECT(Rf_allocVector(STRSXP, 2));
+  SET_VECTOR_ELT(result, 0, r_features);
+  SET_STRING_ELT(names, 0, Rf_mkChar("features"));
+  SET_VECTOR_ELT(result, 1, r_errors);
+  SET_STRING_ELT(names, 1, Rf_mkChar("error"));
+  Rf_setAttrib(result, R_NamesSymbol, names);
+
+  UNPROTECT(4);
+  return result;
 }
@@ -7,56 +7,380 @@
 #include <Rinternals.h>
 #include <gdal.h>
 #include <gdal_utils.h>
+#include <cpl_atomic_ops.h>
 #include <cpl_conv.h>
 #include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <gdalwarper.h>
+#include <ogr_srs_api.h>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
+#include <string>
+#include <vector>
+#include "gdal_utils.h"
 
-extern "C" {
+/*
+ * Band layout of the mosaic VRT, kept after the dataset is closed so the
+ * derived VRT can be written against it.
+ */
+struct vrt_layout {
+  int width, height;
+  double gt[6];
+  std::string srs;
+  int n_bands;
+  std::vector<std::string> types;
+  std::vector<int> has_nodata;
+  std::vector<double> nodata;
+};
+
+static std::string vrt_escape(const char *text) {
+  char *escaped = CPLEscapeString(text, -1, CPLES_XML);
+  std::string out(escaped);
+  CPLFree(escaped);
+  return out;
+}
+
+static std::string vrt_number(double v) {
+  if (std::isnan(v)) return "nan";
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.17g", v);
+  return buf;
+}
 
 /*
- * Entry point for VRT frame creation
- * 
- * @param src Source raster file paths
- * @param bbox Bounding box (xmin, ymin, xmax, ymax)
- * @param width Grid width in pixels
- * @param height Grid height in pixels
- * @param crs Coordinate reference system
- * @param opts Additional VRT options (list)
- * @return VRT file path (character string)
+ * Mosaic band `band` of `base_path` as a full-size source. With
+ * `with_nodata` and a band nodata, a ComplexSource carries it as <NODATA>
+ * so nodata pixels are not handed over as data.
  */
-SEXP _rgio_vf(SEXP src, SEXP bbox, SEXP width, SEXP height,
-              SEXP crs, SEXP opts) {
-  
-  /* Register GDAL drivers */
-  GDALAllRegister();
-  
-  /* Extract parameters */
-  int n_sources = length(src);
-  double *bbox_vals = REAL(bbox);
-  double xmin = bbox_vals[0];
-  double ymin = bbox_vals[1];
-  double xmax = bbox_vals[2];
-  double ymax = bbox_vals[3];
-  int grid_width = INTEGER(width)[0];
-  int grid_height = INTEGER(height)[0];
-  const char *target_crs = CHAR(STRING_ELT(crs, 0));
-  
-  /* Build source file list */
-  char **src_files = (char **)CPLCalloc(n_sources + 1, sizeof(char *));
-  for (int i = 0; i < n_sources; i++) {
-    src_files[i] = CPLStrdup(CHAR(STRING_ELT(src, i)));
+static void vrt_source(std::string &xml, const char *base_path, int band,
+                       const vrt_layout &lay, int with_nodata) {
+  char rect[160];
+  snprintf(rect, sizeof(rect), "xOff=\"0\" yOff=\"0\" xSize=\"%d\" ySize=\"%d\"",
+           lay.width, lay.height);
+  const char *kind = with_nodata && lay.has_nodata[band - 1] ? "ComplexSource"
+                                                             : "SimpleSource";
+  xml += std::string("    <") + kind + ">\n";
+  xml += "      <SourceFilename relativeToVRT=\"0\">" + vrt_escape(base_path) +
+    "</SourceFilename>\n";
+  xml += "      <SourceBand>" + std::to_string(band) + "</SourceBand>\n";
+  xml += std::string("      <SrcRect ") + rect + " />\n";
+  xml += std::string("      <DstRect ") + rect + " />\n";
+  if (with_nodata && lay.has_nodata[band - 1]) {
+    xml += "      <NODATA>" + vrt_number(lay.nodata[band - 1]) + "</NODATA>\n";
   }
-  src_files[n_sources] = NULL;
-  
-  /* Generate unique VRT filename in /vsimem/ */
-  static int vrt_counter = 0;
-  char vrt_path[256];
-  snprintf(vrt_path, sizeof(vrt_path), "/vsimem/rgio_vrt_%d.vrt", vrt_counter++);
-  
+  xml += std::string("    </") + kind + ">\n";
+}
+
+/*
+ * Write the VRT returned to the user when derived bands are requested or
+ * the mosaic is a GTI tile index: the mosaic bands pass through from
+ * `base_path`, followed by one VRTDerivedRasterBand per entry of `derived`
+ * (possibly none), whose sources are mosaic bands. Nesting keeps each
+ * derived band at one source per input band, so pixel functions see aligned
+ * buffers however many tiles the mosaic has.
+ * Returns 0 and fills `msg` on failure; never raises an R error.
+ */
+static int vrt_write_derived(const char *vrt_path, const char *base_path,
+                             const vrt_layout &lay, SEXP derived,
+                             char *msg, size_t msg_len) {
+  int n_derived = length(derived) > 0 ? length(VECTOR_ELT(derived, 1)) : 0;
+  SEXP names = R_NilValue, funs = R_NilValue, bands = R_NilValue;
+  SEXP args = R_NilValue, types = R_NilValue, nodata = R_NilValue;
+  if (n_derived > 0) {
+    names = VECTOR_ELT(derived, 0);
+    funs = VECTOR_ELT(derived, 1);
+    bands = VECTOR_ELT(derived, 2);
+    args = VECTOR_ELT(derived, 3);
+    types = VECTOR_ELT(derived, 4);
+    nodata = VECTOR_ELT(derived, 5);
+  }
+
+  std::string xml = "<VRTDataset rasterXSize=\"" + std::to_string(lay.width) +
+    "\" rasterYSize=\"" + std::to_string(lay.height) + "\">\n";
+  if (!lay.srs.empty()) {
+    xml += "  <SRS>" + vrt_escape(lay.srs.c_str()) + "</SRS>\n";
+  }
+  xml += "  <GeoTransform>";
+  for (int i = 0; i < 6; i++) {
+    xml += (i ? ", " : "") + vrt_number(lay.gt[i]);
+  }
+  xml += "</GeoTransform>\n";
+
+  for (int b = 0; b < lay.n_bands; b++) {
+    xml += "  <VRTRasterBand dataType=\"" + lay.types[b] + "\" band=\"" +
+      std::to_string(b + 1) + "\">\n";
+    if (lay.has_nodata[b]) {
+      xml += "    <NoDataValue>" + vrt_number(lay.nodata[b]) + "</NoDataValue>\n";
+    }
+    vrt_source(xml, base_path, b + 1, lay, 0);
+    xml += "  </VRTRasterBand>\n";
+  }
+
+  for (int d = 0; d < n_derived; d++) {
+    const char *fun = CHAR(STRING_ELT(funs, d));
+    SEXP src_bands = VECTOR_ELT(bands, d);
+    SEXP fun_args = VECTOR_ELT(args, d);
+    SEXP arg_names = getAttrib(fun_args, R_NamesSymbol);
+    double nd = REAL(nodata)[d];
+
+    /* Without its own nodata a derived band takes that of its inputs */
+    for (int k = 0; k < length(src_bands); k++) {
+      int b = INTEGER(src_bands)[k];
+      if (b < 1 || b > lay.n_bands) {
+        snprintf(msg, msg_len, "Derived band '%s' refers to band %d; the mosaic has %d",
+                 CHAR(STRING_ELT(names, d)), b, lay.n_bands);
+        return 0;
+      }
+      if (ISNA(nd) && lay.has_nodata[b - 1]) nd = lay.nodata[b - 1];
+    }
+
+    xml += "  <VRTRasterBand dataType=\"" +
+      std::string(CHAR(STRING_ELT(types, d))) + "\" band=\"" +
+      std::to_string(lay.n_bands + d + 1) +
+      "\" subClass=\"VRTDerivedRasterBand\">\n";
+    xml += "    <Description>" + vrt_escape(CHAR(STRING_ELT(names, d))) +
+      "</Description>\n";
+    if (!ISNA(nd)) {
+      xml += "    <NoDataValue>" + vrt_number(nd) + "</NoDataValue>\n";
+    }
+    xml += "    <PixelFunctionType>" + vrt_escape(fun) + "</PixelFunctionType>\n";
+    if (length(fun_args) > 0) {
+      xml += "    <PixelFunctionArguments";
+      for (int a = 0; a < length(fun_args); a++) {
+        xml += std::string(" ") + CHAR(STRING_ELT(arg_names, a)) + "=\"" +
+          vrt_escape(CHAR(STRING_ELT(fun_args, a))) + "\"";
+      }
+      xml += " />\n";
+    }
+    xml += "    <SourceTransferType>Float64</SourceTransferType>\n";
+    for (int k = 0; k < length(src_bands); k++) {
+      vrt_source(xml, base_path, INTEGER(src_bands)[k], lay, 1);
+    }
+    xml += "  </VRTRasterBand>\n";
+  }
+  xml += "</VRTDataset>\n";
+
+  VSILFILE *fp = VSIFOpenL(vrt_path, "wb");
+  if (fp == NULL) {
+    snprintf(msg, msg_len, "Failed to create VRT: %s", vrt_path);
+    return 0;
+  }
+  size_t written = VSIFWriteL(xml.data(), 1, xml.size(), fp);
+  if (VSIFCloseL(fp) != 0 || written != xml.size()) {
+    snprintf(msg, msg_len, "Failed to write VRT: %s", vrt_path);
+    return 0;
+  }
+  return 1;
+}
+
+/* Resampling names as normalised by normalize_resample() */
+static GDALResampleAlg vrt_resample_alg(const char *name) {
+  if (strcmp(name, "bilinear") == 0) return GRA_Bilinear;
+  if (strcmp(name, "cubic") == 0) return GRA_Cubic;
+  if (strcmp(name, "cubicspline") == 0) return GRA_CubicSpline;
+  if (strcmp(name, "lanczos") == 0) return GRA_Lanczos;
+  if (strcmp(name, "average") == 0) return GRA_Average;
+  if (strcmp(name, "mode") == 0) return GRA_Mode;
+  return GRA_NearestNeighbour;
+}
+
+/*
+ * Wrap `ds` in a warped VRT to `target` unless it is already in that CRS
+ * (or has none). The warped VRT uses an approximate transformer (error
+ * threshold 0.125 pixel, as gdalwarp) and is written to `warp_path`, which
+ * is returned opened; `ds` is then closed. Returns `ds` itself when no
+ * warping is needed and NULL on failure.
+ */
+static GDALDatasetH vrt_warp_source(GDALDatasetH ds, OGRSpatialReferenceH target,
+                                    const char *target_wkt, GDALResampleAlg alg,
+                                    const char *warp_path, int *warped) {
+  *warped = 0;
+  const char *wkt = GDALGetProjectionRef(ds);
+  if (wkt == NULL || wkt[0] == '\0') return ds;
+  OGRSpatialReferenceH srs = OSRNewSpatialReference(wkt);
+  int same = srs == NULL || OSRIsSame(srs, target);
+  if (srs != NULL) OSRDestroySpatialReference(srs);
+  if (same) return ds;
+
+  GDALDatasetH warp = GDALAutoCreateWarpedVRT(ds, NULL, target_wkt, alg, 0.125, NULL);
+  if (warp == NULL) return NULL;
+  GDALDatasetH copy = GDALCreateCopy(GDALGetDriverByName("VRT"), warp_path, warp,
+                                     FALSE, NULL, NULL, NULL);
+  GDALClose(warp);
+  if (copy == NULL) {
+    VSIUnlink(warp_path);
+    return NULL;
+  }
+  GDALClose(ds);
+  *warped = 1;
+  return copy;
+}
+
+/* Record the band layout of an opened mosaic */
+static void vrt_layout_from_dataset(GDALDatasetH ds, vrt_layout *lay) {
+  lay->width = GDALGetRasterXSize(ds);
+  lay->height = GDALGetRasterYSize(ds);
+  if (GDALGetGeoTransform(ds, lay->gt) != CE_None) {
+    lay->gt[0] = 0; lay->gt[1] = 1; lay->gt[2] = 0;
+    lay->gt[3] = 0; lay->gt[4] = 0; lay->gt[5] = 1;
+  }
+  const char *wkt = GDALGetProjectionRef(ds);
+  lay->srs = wkt != NULL ? wkt : "";
+  lay->n_bands = GDALGetRasterCount(ds);
+  lay->types.resize(lay->n_bands);
+  lay->has_nodata.resize(lay->n_bands);
+  lay->nodata.resize(lay->n_bands);
+  for (int b = 0; b < lay->n_bands; b++) {
+    GDALRasterBandH band = GDALGetRasterBand(ds, b + 1);
+    lay->types[b] = GDALGetDataTypeName(GDALGetRasterDataType(band));
+    lay->nodata[b] = GDALGetRasterNoDataValue(band, &lay->has_nodata[b]);
+  }
+}
+
+/* Layout of the target grid, with the bands of the first source */
+static void vrt_layout_from_meta(const rgio_src_meta *first, const double *bbox,
+                                 int width, int height, const char *target_wkt,
+                                 vrt_layout *lay) {
+  lay->width = width;
+  lay->height = height;
+  lay->gt[0] = bbox[0];
+  lay->gt[1] = (bbox[2] - bbox[0]) / width;
+  lay->gt[2] = 0;
+  lay->gt[3] = bbox[3];
+  lay->gt[4] = 0;
+  lay->gt[5] = -(bbox[3] - bbox[1]) / height;
+  lay->srs = target_wkt;
+  lay->n_bands = first->n_bands;
+  lay->types.resize(lay->n_bands);
+  lay->has_nodata.resize(lay->n_bands);
+  lay->nodata.resize(lay->n_bands);
+  for (int b = 0; b < lay->n_bands; b++) {
+    lay->types[b] = GDALGetDataTypeName(first->types[b]);
+    lay->has_nodata[b] = first->has_nodata[b];
+    lay->nodata[b] = first->nodata[b];
+  }
+}
+
+/*
+ * Write the mosaic VRT straight from source metadata, as GDALBuildVRT would,
+ * without opening any source. Every source carries its SourceProperties, so
+ * GDAL opens it only when a read touches it, and sources outside the grid
+ * are left out. Applies when all sources are north-up, in the target CRS
+ * and share one band layout; returns 0 otherwise (nothing written, the
+ * caller falls back to GDALBuildVRT), 1 on success and -1 on write failure.
+ */
+static int vrt_write_mosaic(const char *path, const rgio_src_meta *meta, int n,
+                            const double *bbox, int width, int height,
+                            OGRSpatialReferenceH target, const char *target_wkt,
+                            const char *resample, vrt_layout *lay,
+                            char *msg, size_t msg_len) {
+  if (n == 0 || meta[0].n_bands == 0) return 0;
+  const char *same_wkt = NULL;  /* last WKT found to match the target */
+  for (int i = 0; i < n; i++) {
+    const rgio_src_meta *m = &meta[i];
+    if (m->gt[2] != 0 || m->gt[4] != 0 || m->gt[1] <= 0 || m->gt[5] >= 0) return 0;
+    if (m->n_bands != meta[0].n_bands) return 0;
+    for (int b = 0; b < m->n_bands; b++) {
+      if (m->types[b] != meta[0].types[b]) return 0;
+    }
+    if (m->wkt == NULL || m->wkt[0] == '\0') return 0;
+    if (same_wkt == NULL || strcmp(same_wkt, m->wkt) != 0) {
+      OGRSpatialReferenceH srs = OSRNewSpatialReference(m->wkt);
+      int same = srs != NULL && OSRIsSame(srs, target);
+      if (srs != NULL) OSRDestroySpatialReference(srs);
+      if (!same) return 0;
+      same_wkt = m->wkt;
+    }
+  }
+
+  double xmin = bbox[0], ymin = bbox[1], xmax = bbox[2], ymax = bbox[3];
+  double xres = (xmax - xmin) / width, yres = (ymax - ymin) / height;
+  double gt[6] = {xmin, xres, 0, ymax, 0, -yres};
+  const rgio_src_meta *first = &meta[0];
+  std::string resampling = strcmp(resample, "near") == 0 ? "" :
+    std::string(" resampling=\"") + resample + "\"";
+
+  std::string xml = "<VRTDataset rasterXSize=\"" + std::to_string(width) +
+    "\" rasterYSize=\"" + std::to_string(height) + "\">\n";
+  xml += "  <SRS>" + vrt_escape(target_wkt) + "</SRS>\n";
+  xml += "  <GeoTransform>";
+  for (int k = 0; k < 6; k++) {
+    xml += (k ? ", " : "") + vrt_number(gt[k]);
+  }
+  xml += "</GeoTransform>\n";
+
+  for (int b = 0; b < first->n_bands; b++) {
+    const char *type = GDALGetDataTypeName(first->types[b]);
+    xml += "  <VRTRasterBand dataType=\"" + std::string(type) + "\" band=\"" +
+      std::to_string(b + 1) + "\">\n";
+    if (first->has_nodata[b]) {
+      xml += "    <NoDataValue>" + vrt_number(first->nodata[b]) + "</NoDataValue>\n";
+    }
+    for (int i = 0; i < n; i++) {
+      const rgio_src_meta *m = &meta[i];
+      double sx0 = m->gt[0], sx1 = m->gt[0] + m->width * m->gt[1];
+      double sy1 = m->gt[3], sy0 = m->gt[3] + m->height * m->gt[5];
+      double ix0 = sx0 > xmin ? sx0 : xmin, ix1 = sx1 < xmax ? sx1 : xmax;
+      double iy0 = sy0 > ymin ? sy0 : ymin, iy1 = sy1 < ymax ? sy1 : ymax;
+      if (ix1 <= ix0 || iy1 <= iy0) continue;
+
+      const char *kind = m->has_nodata[b] ? "ComplexSource" : "SimpleSource";
+      xml += std::string("    <") + kind + resampling + ">\n";
+      xml += "      <SourceFilename relativeToVRT=\"0\">" + vrt_escape(m->path) +
+        "</SourceFilename>\n";
+      xml += "      <SourceBand>" + std::to_string(b + 1) + "</SourceBand>\n";
+      xml += "      <SourceProperties RasterXSize=\"" + std::to_string(m->width) +
+        "\" RasterYSize=\"" + std::to_string(m->height) + "\" DataType=\"" + type +
+        "\" BlockXSize=\"" + std::to_string(m->block_x[b]) + "\" BlockYSize=\"" +
+        std::to_string(m->block_y[b]) + "\" />\n";
+      xml += "      <SrcRect xOff=\"" + vrt_number((ix0 - sx0) / m->gt[1]) +
+        "\" yOff=\"" + vrt_number((sy1 - iy1) / -m->gt[5]) +
+        "\" xSize=\"" + vrt_number((ix1 - ix0) / m->gt[1]) +
+        "\" ySize=\"" + vrt_number((iy1 - iy0) / -m->gt[5]) + "\" />\n";
+      xml += "      <DstRect xOff=\"" + vrt_number((ix0 - xmin) / xres) +
+        "\" yOff=\"" + vrt_number((ymax - iy1) / yres) +
+        "\" xSize=\"" + vrt_number((ix1 - ix0) / xres) +
+        "\" ySize=\"" + vrt_number((iy1 - iy0) / yres) + "\" />\n";
+      if (m->has_nodata[b]) {
+        xml += "      <NODATA>" + vrt_number(m->nodata[b]) + "</NODATA>\n";
+      }
+      xml += std::string("    </") + kind + ">\n";
+    }
+    xml += "  </VRTRasterBand>\n";
+  }
+  xml += "</VRTDataset>\n";
+
+  VSILFILE *fp = VSIFOpenL(path, "wb");
+  size_t written = fp != NULL ? VSIFWriteL(xml.data(), 1, xml.size(), fp) : 0;
+  if (fp == NULL || VSIFCloseL(fp) != 0 || written != xml.size()) {
+    snprintf(msg, msg_len, "Failed to write VRT: %s", path);
+    return -1;
+  }
+
+  if (lay != NULL) {
+    vrt_layout_from_meta(first, bbox, width, height, target_wkt, lay);
+  }
+  return 1;
+}
+
+/*
+ * Build the mosaic with GDALBuildVRT, opening every source. Sources in
+ * another CRS are replaced by warped VRTs, so the mosaic reprojects lazily,
+ * only the windows that are read; their paths are added to `warp_files`.
+ * Returns 0 with a message in `msg` on failure.
+ */
+static int vrt_build_mosaic(const char *path, char **src_files, int n_sources,
+                            const double *bbox, int width, int height,
+                            const char *target_crs, OGRSpatialReferenceH target_srs,
+                            const char *target_wkt, const char *resample,
+                            const char *stem, vrt_layout *lay, char ***warp_files,
+                            char *msg, size_t msg_len) {
+  double xmin = bbox[0], ymin = bbox[1], xmax = bbox[2], ymax = bbox[3];
+
   /* Build VRT using GDALBuildVRT */
   char **buildvrt_argv = NULL;
-  
+
   /* Set target extent */
   buildvrt_argv = CSLAddString(buildvrt_argv, "-te");
   char xmin_str[64], ymin_str[64], xmax_str[64], ymax_str[64];
@@ -68,66 +392,260 @@ SEXP _rgio_vf(SEXP src, SEXP bbox, SEXP width, SEXP height,
   buildvrt_argv = CSLAddString(buildvrt_argv, ymin_str);
   buildvrt_argv = CSLAddString(buildvrt_argv, xmax_str);
   buildvrt_argv = CSLAddString(buildvrt_argv, ymax_str);
-  
+
   /* Set target resolution */
-  double xres = (xmax - xmin) / grid_width;
-  double yres = (ymax - ymin) / grid_height;
+  double xres = (xmax - xmin) / width;
+  double yres = (ymax - ymin) / height;
   buildvrt_argv = CSLAddString(buildvrt_argv, "-tr");
   char xres_str[64], yres_str[64];
   snprintf(xres_str, sizeof(xres_str), "%.15g", xres);
   snprintf(yres_str, sizeof(yres_str), "%.15g", yres);
   buildvrt_argv = CSLAddString(buildvrt_argv, xres_str);
   buildvrt_argv = CSLAddString(buildvrt_argv, yres_str);
-  
+
   /* Set target CRS */
   buildvrt_argv = CSLAddString(buildvrt_argv, "-a_srs");
   buildvrt_argv = CSLAddString(buildvrt_argv, target_crs);
-  
+
+  /* Resampling onto the target grid */
+  buildvrt_argv = CSLAddString(buildvrt_argv, "-r");
+  buildvrt_argv = CSLAddString(buildvrt_argv,
+                               strcmp(resample, "near") == 0 ? "nearest" : resample);
+
   /* Create build VRT options */
   GDALBuildVRTOptions *buildvrt_options = GDALBuildVRTOptionsNew(buildvrt_argv, NULL);
   CSLDestroy(buildvrt_argv);
-  
+
   if (buildvrt_options == NULL) {
-    CSLDestroy(src_files);
-    error("Failed to create build VRT options");
+    snprintf(msg, msg_len, "Failed to create build VRT options");
+    return 0;
   }
-  
+
+  GDALResampleAlg resample_alg = vrt_resample_alg(resample);
+
   /* Open source datasets */
   GDALDatasetH *src_datasets = (GDALDatasetH *)CPLCalloc(n_sources, sizeof(GDALDatasetH));
+  int ok = 1;
   for (int i = 0; i < n_sources; i++) {
     src_datasets[i] = GDALOpen(src_files[i], GA_ReadOnly);
     if (src_datasets[i] == NULL) {
-      /* Clean up already opened datasets */
-      for (int j = 0; j < i; j++) {
-        GDALClose(src_datasets[j]);
-      }
-      CPLFree(src_datasets);
-      GDALBuildVRTOptionsFree(buildvrt_options);
-      CSLDestroy(src_files);
-      error("Failed to open source file: %s", src_files[i]);
+      snprintf(msg, msg_len, "Failed to open source file: %s", src_files[i]);
+      ok = 0;
+      break;
+    }
+    char warp_path[1024];
+    snprintf(warp_path, sizeof(warp_path), "%s_warp_%d.vrt", stem, i);
+    int warped = 0;
+    GDALDatasetH ds = vrt_warp_source(src_datasets[i], target_srs, target_wkt,
+                                      resample_alg, warp_path, &warped);
+    if (ds == NULL) {
+      snprintf(msg, msg_len, "Failed to create warped VRT for: %s", src_files[i]);
+      ok = 0;
+      break;
+    }
+    src_datasets[i] = ds;
+    if (warped) {
+      *warp_files = CSLAddString(*warp_files, warp_path);
+      CPLFree(src_files[i]);
+      src_files[i] = CPLStrdup(warp_path);
     }
   }
-  
+
   /* Build VRT */
-  int err_flag = 0;
-  GDALDatasetH vrt_ds = GDALBuildVRT(vrt_path, n_sources, src_datasets,
-                                      (const char * const *)src_files,
-                                      buildvrt_options, &err_flag);
-  
+  GDALDatasetH vrt_ds = NULL;
+  if (ok) {
+    int err_flag = 0;
+    vrt_ds = GDALBuildVRT(path, n_sources, src_datasets,
+                          (const char * const *)src_files,
+                          buildvrt_options, &err_flag);
+    if (vrt_ds == NULL || err_flag != 0) {
+      snprintf(msg, msg_len, "VRT creation failed");
+      ok = 0;
+    }
+  }
+
   /* Clean up source datasets */
   for (int i = 0; i < n_sources; i++) {
-    GDALClose(src_datasets[i]);
+    if (src_datasets[i] != NULL) GDALClose(src_datasets[i]);
   }
   CPLFree(src_datasets);
   GDALBuildVRTOptionsFree(buildvrt_options);
-  CSLDestroy(src_files);
+
+  if (vrt_ds != NULL) {
+    if (ok && lay != NULL) vrt_layout_from_dataset(vrt_ds, lay);
+    /* Close VRT dataset (it remains at `path`) */
+    GDALClose(vrt_ds);
+  }
+  return ok;
+}
+
+extern "C" {
+
+/*
+ * Entry point for VRT frame creation
+ * 
+ * @param src Source raster file paths
+ * @param bbox Bounding box (xmin, ymin, xmax, ymax)
+ * @param width Grid width in pixels
+ * @param height Grid height in pixels
+ * @param crs Coordinate reference system
+ * @param opts Additional VRT options (list)
+ * @param derived Derived bands: list(name, fun, bands, args, datatype, nodata),
+ *   one element per band in each vector; empty for a plain mosaic
+ * @param resample Resampling method, for warped sources and the mosaic grid
+ * @param cache Path of the source metadata cache (character(0) for none)
+ * @param check Logical; compare cached entries against the sources' size
+ *   and modification time
+ * @param threads Worker threads refreshing the cache (0 = all CPUs)
+ * @param index Path of a GTI tile index (.gpkg or .fgb) to build the mosaic
+ *   as, instead of a VRT (character(0) for none)
+ * @param dst Path to write the VRT to (character(0) for /vsimem/)
+ * @return VRT file path (character string). A /vsimem/ VRT lies in a
+ *   directory of its own, which rg_vrt_build() ties to an rg_vrt handle
+ */
+SEXP _rgio_vf(SEXP src, SEXP bbox, SEXP width, SEXP height,
+              SEXP crs, SEXP opts, SEXP derived, SEXP resample,
+              SEXP cache, SEXP check, SEXP threads, SEXP index, SEXP dst) {
   
-  if (vrt_ds == NULL || err_flag != 0) {
-    error("VRT creation failed");
+  /* Register GDAL drivers */
+  GDALAllRegister();
+  
+  /* Extract parameters */
+  int n_sources = length(src);
+  double *bbox_vals = REAL(bbox);
+  int grid_width = INTEGER(width)[0];
+  int grid_height = INTEGER(height)[0];
+  const char *target_crs = CHAR(STRING_ELT(crs, 0));
+  const char *resample_method = CHAR(STRING_ELT(resample, 0));
+  
+  /* Build source file list */
+  char **src_files = (char **)CPLCalloc(n_sources + 1, sizeof(char *));
+  for (int i = 0; i < n_sources; i++) {
+    src_files[i] = CPLStrdup(CHAR(STRING_ELT(src, i)));
   }
+  src_files[n_sources] = NULL;
   
-  /* Close VRT dataset (it remains in /vsimem/) */
-  GDALClose(vrt_ds);
+  /*
+   * Each build gets its own /vsimem/ directory, so the VRT and its companion
+   * files (mosaic, warped sources) go away together; with `dst` they are
+   * written next to it instead. The counter is shared by concurrent calls.
+   */
+  static volatile int vrt_counter = 0;
+  int to_dst = length(dst) > 0;
+  char vrt_dir[64] = "";
+  char vrt_path[1024], stem[1024];
+  if (to_dst) {
+    snprintf(vrt_path, sizeof(vrt_path), "%s", CHAR(STRING_ELT(dst, 0)));
+    snprintf(stem, sizeof(stem), "%s", vrt_path);
+    char *dot = strrchr(stem, '.');
+    if (dot != NULL && strpbrk(dot, "/\\") == NULL) *dot = '\0';
+  } else {
+    snprintf(vrt_dir, sizeof(vrt_dir), "/vsimem/rgio_vrt_%d",
+             CPLAtomicInc(&vrt_counter));
+    VSIMkdir(vrt_dir, 0755);
+    snprintf(stem, sizeof(stem), "%s/rgio", vrt_dir);
+    snprintf(vrt_path, sizeof(vrt_path), "%s.vrt", stem);
+  }
+
+  /* With derived bands the mosaic goes to a base VRT they refer to */
+  int n_derived = length(derived) > 0 ? length(VECTOR_ELT(derived, 1)) : 0;
+  char base_path[1024];
+  snprintf(base_path, sizeof(base_path), "%s_mosaic.vrt", stem);
+  if (n_derived > 0) {
+    SEXP funs = VECTOR_ELT(derived, 1);
+    for (int d = 0; d < n_derived; d++) {
+      if (strncmp(CHAR(STRING_ELT(funs, d)), "rgio_", 5) == 0 &&
+          !rgio_register_pixel_functions()) {
+        CSLDestroy(src_files);
+        if (!to_dst) VSIRmdir(vrt_dir);
+        error("rgio pixel functions require GDAL >= 3.4");
+      }
+    }
+  }
+  const char *mosaic_path = n_derived > 0 ? base_path : vrt_path;
+
+  /* A GTI mosaic is described by <index>.gti, wrapped by the returned VRT */
+  int use_index = length(index) > 0;
+  const char *index_path = use_index ? CHAR(STRING_ELT(index, 0)) : NULL;
+  char gti_path[1024];
+  if (use_index) {
+    snprintf(gti_path, sizeof(gti_path), "%s", CPLResetExtension(index_path, "gti"));
+    mosaic_path = gti_path;
+  }
+
+  /* Target CRS, to find sources that need reprojecting */
+  OGRSpatialReferenceH target_srs = OSRNewSpatialReference(NULL);
+  char *target_wkt = NULL;
+  if (OSRSetFromUserInput(target_srs, target_crs) != OGRERR_NONE ||
+      OSRExportToWkt(target_srs, &target_wkt) != OGRERR_NONE) {
+    OSRDestroySpatialReference(target_srs);
+    CPLFree(target_wkt);
+    CSLDestroy(src_files);
+    if (!to_dst) VSIRmdir(vrt_dir);
+    error("Invalid CRS: %s", target_crs);
+  }
+
+  char msg[1024] = "";
+  int ok = 1, built = 0;
+  vrt_layout *lay = n_derived > 0 || use_index ? new vrt_layout() : NULL;
+  char **warp_files = NULL;
+
+  /* From source metadata, cached or collected on a worker pool */
+  if (length(cache) > 0 || use_index) {
+    rgio_src_meta *meta =
+      (rgio_src_meta *) CPLCalloc(n_sources > 0 ? n_sources : 1, sizeof(rgio_src_meta));
+    int n_opened = 0;
+    ok = rgio_vrt_meta(src_files, n_sources,
+                       length(cache) > 0 ? CHAR(STRING_ELT(cache, 0)) : NULL,
+                       LOGICAL(check)[0], INTEGER(threads)[0], meta, &n_opened,
+                       msg, sizeof(msg));
+    if (ok && use_index) {
+      ok = rgio_write_tile_index(index_path, gti_path, meta, n_sources, bbox_vals,
+                                 grid_width, grid_height, target_wkt,
+                                 resample_method, msg, sizeof(msg));
+      if (ok) {
+        vrt_layout_from_meta(&meta[0], bbox_vals, grid_width, grid_height,
+                             target_wkt, lay);
+      }
+      built = 1;
+      for (int i = 0; i < n_sources; i++) rgio_src_meta_free(&meta[i]);
+    } else if (ok) {
+      int status = vrt_write_mosaic(mosaic_path, meta, n_sources, bbox_vals,
+                                    grid_width, grid_height, target_srs, target_wkt,
+                                    resample_method, lay, msg, sizeof(msg));
+      ok = status >= 0;
+      built = status > 0;
+      for (int i = 0; i < n_sources; i++) rgio_src_meta_free(&meta[i]);
+    }
+    CPLFree(meta);
+  }
+
+  if (ok && !built) {
+    ok = vrt_build_mosaic(mosaic_path, src_files, n_sources, bbox_vals,
+                          grid_width, grid_height, target_crs, target_srs,
+                          target_wkt, resample_method, stem, lay, &warp_files,
+                          msg, sizeof(msg));
+  }
+  OSRDestroySpatialReference(target_srs);
+  CPLFree(target_wkt);
+  CSLDestroy(src_files);
+
+  if (ok && lay != NULL) {
+    ok = vrt_write_derived(vrt_path, mosaic_path, *lay, derived, msg, sizeof(msg));
+  }
+  delete lay;
+
+  if (!ok) {
+    if (!use_index) VSIUnlink(mosaic_path);
+    VSIUnlink(vrt_path);
+    for (int j = 0; warp_files != NULL && warp_files[j] != NULL; j++) {
+      VSIUnlink(warp_files[j]);
+    }
+    CSLDestroy(warp_files);
+    if (!to_dst) VSIRmdirRecursive(vrt_dir);
+    error("%s", msg);
+  }
+  CSLDestroy(warp_files);
   
   /* Return VRT path */
   SEXP result = PROTECT(allocVector(STRSXP, 1));
@@ -0,0 +1,344 @@
+/*
+ * vrt_cache.c
+ * Source metadata for VRT mosaics, persisted in a sidecar cache
+ */
+
+#include <gdal.h>
+#include <cpl_conv.h>
+#include <cpl_minixml.h>
+#include <cpl_multiproc.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/*
+ * rg_vrt_build() can write the mosaic XML itself when it knows, for every
+ * source, the raster size, geotransform, CRS and per band data type, nodata
+ * and block size. Those are kept in a small XML sidecar:
+ *
+ *   <RgioSourceCache version="1">
+ *     <Source path="..." size="..." mtime="..." width="..." height="">
+ *       <GeoTransform>gt0,gt1,gt2,gt3,gt4,gt5</GeoTransform>
+ *       <SRS>WKT</SRS>
+ *       <Band type="UInt16" blockXSize="512" blockYSize="512" nodata="0" />
+ *     </Source>
+ *   </RgioSourceCache>
+ *
+ * Only sources missing from the cache, or whose size or modification time
+ * changed, are opened, on a pool of workers. For remote sources the check
+ * is one VSIStatL() (a HEAD request); with check = 0 cached entries are
+ * trusted outright and nothing but new sources touches the network.
+ */
+
+#define META_CACHE_ROOT "RgioSourceCache"
+
+static void meta_alloc_bands(rgio_src_meta *m, int n_bands) {
+  m->n_bands = n_bands;
+  int n = n_bands > 0 ? n_bands : 1;
+  m->types = (GDALDataType *) CPLCalloc(n, sizeof(GDALDataType));
+  m->has_nodata = (int *) CPLCalloc(n, sizeof(int));
+  m->nodata = (double *) CPLCalloc(n, sizeof(double));
+  m->block_x = (int *) CPLCalloc(n, sizeof(int));
+  m->block_y = (int *) CPLCalloc(n, sizeof(int));
+}
+
+void rgio_src_meta_free(rgio_src_meta *m) {
+  CPLFree(m->path);
+  CPLFree(m->wkt);
+  CPLFree(m->types);
+  CPLFree(m->has_nodata);
+  CPLFree(m->nodata);
+  CPLFree(m->block_x);
+  CPLFree(m->block_y);
+  memset(m, 0, sizeof(*m));
+}
+
+static void meta_copy(rgio_src_meta *dst, const rgio_src_meta *src) {
+  *dst = *src;
+  dst->path = CPLStrdup(src->path);
+  dst->wkt = CPLStrdup(src->wkt);
+  meta_alloc_bands(dst, src->n_bands);
+  for (int b = 0; b < src->n_bands; b++) {
+    dst->types[b] = src->types[b];
+    dst->has_nodata[b] = src->has_nodata[b];
+    dst->nodata[b] = src->nodata[b];
+    dst->block_x[b] = src->block_x[b];
+    dst->block_y[b] = src->block_y[b];
+  }
+}
+
+static int meta_cmp_path(const void *a, const void *b) {
+  return strcmp(((const rgio_src_meta *) a)->path, ((const rgio_src_meta *) b)->path);
+}
+
+static int meta_cmp_ptr(const void *a, const void *b) {
+  return meta_cmp_path(*(const rgio_src_meta * const *) a,
+                       *(const rgio_src_meta * const *) b);
+}
+
+static const rgio_src_meta *meta_find(const rgio_src_meta *cache, int n_cache,
+                                      const char *path) {
+  if (n_cache == 0) return NULL;
+  rgio_src_meta key;
+  key.path = (char *) path;
+  return (const rgio_src_meta *) bsearch(&key, cache, n_cache, sizeof(rgio_src_meta),
+                                         meta_cmp_path);
+}
+
+/* Open `path` and fill `m`; returns 0 on failure */
+static int meta_collect(const char *path, rgio_src_meta *m) {
+  GDALDatasetH ds = GDALOpenEx(path, GDAL_OF_RASTER | GDAL_OF_READONLY,
+                               NULL, NULL, NULL);
+  if (ds == NULL) return 0;
+  m->path = CPLStrdup(path);
+  m->width = GDALGetRasterXSize(ds);
+  m->height = GDALGetRasterYSize(ds);
+  if (GDALGetGeoTransform(ds, m->gt) != CE_None) {
+    m->gt[0] = 0; m->gt[1] = 1; m->gt[2] = 0;
+    m->gt[3] = 0; m->gt[4] = 0; m->gt[5] = 1;
+  }
+  const char *wkt = GDALGetProjectionRef(ds);
+  m->wkt = CPLStrdup(wkt != NULL ? wkt : "");
+  meta_alloc_bands(m, GDALGetRasterCount(ds));
+  for (int b = 0; b < m->n_bands; b++) {
+    GDALRasterBandH band = GDALGetRasterBand(ds, b + 1);
+    m->types[b] = GDALGetRasterDataType(band);
+    m->nodata[b] = GDALGetRasterNoDataValue(band, &m->has_nodata[b]);
+    GDALGetBlockSize(band, &m->block_x[b], &m->block_y[b]);
+  }
+  GDALClose(ds);
+  return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Sidecar I/O                                                               */
+/* -------------------------------------------------------------------------- */
+static int meta_from_xml(CPLXMLNode *node, rgio_src_meta *m) {
+  const char *path = CPLGetXMLValue(node, "path", NULL);
+  const char *gt = CPLGetXMLValue(node, "GeoTransform", NULL);
+  if (path == NULL || gt == NULL) return 0;
+  char **tokens = CSLTokenizeString2(gt, ",", 0);
+  int ok = CSLCount((CSLConstList) tokens) == 6;
+  for (int k = 0; ok && k < 6; k++) m->gt[k] = CPLAtof(tokens[k]);
+  CSLDestroy(tokens);
+  if (!ok) return 0;
+
+  m->path = CPLStrdup(path);
+  m->size = CPLAtoGIntBig(CPLGetXMLValue(node, "size", "-1"));
+  m->mtime = CPLAtoGIntBig(CPLGetXMLValue(node, "mtime", "-1"));
+  m->width = atoi(CPLGetXMLValue(node, "width", "0"));
+  m->height = atoi(CPLGetXMLValue(node, "height", "0"));
+  m->wkt = CPLStrdup(CPLGetXMLValue(node, "SRS", ""));
+
+  int n_bands = 0;
+  for (CPLXMLNode *c = node->psChild; c != NULL; c = c->psNext) {
+    if (c->eType == CXT_Element && EQUAL(c->pszValue, "Band")) n_bands++;
+  }
+  meta_alloc_bands(m, n_bands);
+  int b = 0;
+  for (CPLXMLNode *c = node->psChild; c != NULL; c = c->psNext) {
+    if (c->eType != CXT_Element || !EQUAL(c->pszValue, "Band")) continue;
+    m->types[b] = GDALGetDataTypeByName(CPLGetXMLValue(c, "type", "Byte"));
+    m->block_x[b] = atoi(CPLGetXMLValue(c, "blockXSize", "0"));
+    m->block_y[b] = atoi(CPLGetXMLValue(c, "blockYSize", "0"));
+    const char *nd = CPLGetXMLValue(c, "nodata", NULL);
+    m->has_nodata[b] = nd != NULL;
+    m->nodata[b] = nd != NULL ? CPLAtof(nd) : 0;
+    b++;
+  }
+  return m->width > 0 && m->height > 0;
+}
+
+static void meta_to_xml(CPLXMLNode *root, const rgio_src_meta *m) {
+  CPLXMLNode *node = CPLCreateXMLNode(root, CXT_Element, "Source");
+  CPLAddXMLAttributeAndValue(node, "path", m->path);
+  CPLAddXMLAttributeAndValue(node, "size", CPLSPrintf("%lld", (long long) m->size));
+  CPLAddXMLAttributeAndValue(node, "mtime", CPLSPrintf("%lld", (long long) m->mtime));
+  CPLAddXMLAttributeAndValue(node, "width", CPLSPrintf("%d", m->width));
+  CPLAddXMLAttributeAndValue(node, "height", CPLSPrintf("%d", m->height));
+  CPLCreateXMLElementAndValue(
+    node, "GeoTransform",
+    CPLSPrintf("%.17g,%.17g,%.17g,%.17g,%.17g,%.17g", m->gt[0], m->gt[1],
+               m->gt[2], m->gt[3], m->gt[4], m->gt[5]));
+  if (m->wkt != NULL && m->wkt[0] != '\0') {
+    CPLCreateXMLElementAndValue(node, "SRS", m->wkt);
+  }
+  for (int b = 0; b < m->n_bands; b++) {
+    CPLXMLNode *band = CPLCreateXMLNode(node, CXT_Element, "Band");
+    CPLAddXMLAttributeAndValue(band, "type", GDALGetDataTypeName(m->types[b]));
+    CPLAddXMLAttributeAndValue(band, "blockXSize", CPLSPrintf("%d", m->block_x[b]));
+    CPLAddXMLAttributeAndValue(band, "blockYSize", CPLSPrintf("%d", m->block_y[b]));
+    if (m->has_nodata[b]) {
+      CPLAddXMLAttributeAndValue(band, "nodata", CPLSPrintf("%.17g", m->nodata[b]));
+    }
+  }
+}
+
+/* Entries of the sidecar sorted by path; *n is 0 when it is absent */
+static rgio_src_meta *meta_cache_read(const char *cache_path, int *n) {
+  *n = 0;
+  VSIStatBufL st;
+  if (VSIStatL(cache_path, &st) != 0) return NULL;
+  CPLXMLNode *root = CPLParseXMLFile(cache_path);
+  if (root == NULL) return NULL;
+  CPLXMLNode *top = CPLGetXMLNode(root, "=" META_CACHE_ROOT);
+
+  int n_nodes = 0;
+  for (CPLXMLNode *c = top ? top->psChild : NULL; c != NULL; c = c->psNext) {
+    if (c->eType == CXT_Element && EQUAL(c->pszValue, "Source")) n_nodes++;
+  }
+  rgio_src_meta *cache =
+    (rgio_src_meta *) CPLCalloc(n_nodes > 0 ? n_nodes : 1, sizeof(rgio_src_meta));
+  for (CPLXMLNode *c = top ? top->psChild : NULL; c != NULL; c = c->psNext) {
+    if (c->eType != CXT_Element || !EQUAL(c->pszValue, "Source")) continue;
+    if (meta_from_xml(c, &cache[*n])) {
+      (*n)++;
+    } else {
+      rgio_src_meta_free(&cache[*n]);
+    }
+  }
+  CPLDestroyXMLNode(root);
+  qsort(cache, *n, sizeof(rgio_src_meta), meta_cmp_path);
+  return cache;
+}
+
+/* -------------------------------------------------------------------------- */
+/*  Refresh on a worker pool                                                  */
+/* -------------------------------------------------------------------------- */
+typedef struct {
+  int n;
+  char **paths;
+  const rgio_src_meta *cache;
+  int n_cache;
+  int check;
+  rgio_src_meta *meta;
+  int *opened;
+  int failed;              /* index of the first unreadable source, or -1 */
+  CPLMutex *mutex;
+  int next;
+} meta_job;
+
+static void meta_worker(void *arg) {
+  meta_job *job = (meta_job *) arg;
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+
+  for (;;) {
+    CPLAcquireMutex(job->mutex, 1000.0);
+    int i = job->next < job->n ? job->next++ : -1;
+    CPLReleaseMutex(job->mutex);
+    if (i < 0) break;
+
+    const char *path = job->paths[i];
+    const rgio_src_meta *hit = meta_find(job->cache, job->n_cache, path);
+    if (hit != NULL && !job->check) {
+      meta_copy(&job->meta[i], hit);
+      continue;
+    }
+    VSIStatBufL st;
+    int have_stat = VSIStatL(path, &st) == 0;
+    if (hit != NULL && have_stat && hit->size == (GIntBig) st.st_size &&
+        hit->mtime == (GIntBig) st.st_mtime) {
+      meta_copy(&job->meta[i], hit);
+      continue;
+    }
+    if (!meta_collect(path, &job->meta[i])) {
+      CPLAcquireMutex(job->mutex, 1000.0);
+      if (job->failed < 0 || i < job->failed) job->failed = i;
+      CPLReleaseMutex(job->mutex);
+      continue;
+    }
+    job->meta[i].size = have_stat ? (GIntBig) st.st_size : -1;
+    job->meta[i].mtime = have_stat ? (GIntBig) st.st_mtime : -1;
+    job->opened[i] = 1;
+  }
+
+  CPLPopErrorHandler();
+}
+
+/*
+ * Fill meta[0..n-1] for `paths`, using and refreshing the sidecar at
+ * `cache_path` (NULL to open every source). The sidecar keeps entries for
+ * sources not in `paths`, so one cache can serve several mosaics. Returns 0 with a message in `msg`
+ * if a source cannot be opened or the sidecar cannot be written.
+ */
+int rgio_vrt_meta(char **paths, int n, const char *cache_path, int check,
+                  int threads, rgio_src_meta *meta, int *n_opened,
+                  char *msg, size_t msg_len) {
+  int n_cache = 0;
+  rgio_src_meta *cache =
+    cache_path != NULL ? meta_cache_read(cache_path, &n_cache) : NULL;
+
+  meta_job job;
+  memset(&job, 0, sizeof(job));
+  job.n = n;
+  job.paths = paths;
+  job.cache = cache;
+  job.n_cache = n_cache;
+  job.check = check;
+  job.meta = meta;
+  job.opened = (int *) CPLCalloc(n > 0 ? n : 1, sizeof(int));
+  job.failed = -1;
+
+  int n_workers = rgio_resolve_threads(threads, n);
+  job.mutex = CPLCreateMutex();
+  CPLReleaseMutex(job.mutex);
+  CPLJoinableThread **workers =
+    (CPLJoinableThread **) CPLCalloc(n_workers, sizeof(CPLJoinableThread *));
+  for (int i = 1; i < n_workers; i++) {
+    workers[i] = CPLCreateJoinableThread(meta_worker, &job);
+  }
+  meta_worker(&job);  /* the calling thread opens sources too */
+  for (int i = 1; i < n_workers; i++) {
+    if (workers[i]) CPLJoinThread(workers[i]);
+  }
+  CPLFree(workers);
+  CPLDestroyMutex(job.mutex);
+
+  *n_opened = 0;
+  for (int i = 0; i < n; i++) *n_opened += job.opened[i];
+  CPLFree(job.opened);
+
+  int ok = 1;
+  if (job.failed >= 0) {
+    snprintf(msg, msg_len, "Failed to open source file: %s", paths[job.failed]);
+    ok = 0;
+  } else if (cache_path != NULL && (*n_opened > 0 || n_cache == 0)) {
+    /* rewrite the sidecar: untouched entries first, then this mosaic's */
+    int *used = (int *) CPLCalloc(n_cache > 0 ? n_cache : 1, sizeof(int));
+    for (int i = 0; i < n; i++) {
+      const rgio_src_meta *hit = meta_find(cache, n_cache, paths[i]);
+      if (hit != NULL) used[hit - cache] = 1;
+    }
+    CPLXMLNode *root = CPLCreateXMLNode(NULL, CXT_Element, META_CACHE_ROOT);
+    CPLAddXMLAttributeAndValue(root, "version", "1");
+    for (int k = 0; k < n_cache; k++) {
+      if (!used[k]) meta_to_xml(root, &cache[k]);
+    }
+    const rgio_src_meta **order =
+      (const rgio_src_meta **) CPLCalloc(n > 0 ? n : 1, sizeof(rgio_src_meta *));
+    for (int i = 0; i < n; i++) order[i] = &meta[i];
+    qsort(order, n, sizeof(rgio_src_meta *), meta_cmp_ptr);
+    for (int i = 0; i < n; i++) {
+      if (i == 0 || strcmp(order[i]->path, order[i - 1]->path) != 0) {
+        meta_to_xml(root, order[i]);
+      }
+    }
+    CPLFree(order);
+    if (!CPLSerializeXMLTreeToFile(root, cache_path)) {
+      snprintf(msg, msg_len, "Failed to write VRT cache: %s", cache_path);
+      ok = 0;
+    }
+    CPLDestroyXMLNode(root);
+    CPLFree(used);
+  }
+
+  for (int k = 0; k < n_cache; k++) rgio_src_meta_free(&cache[k]);
+  CPLFree(cache);
+  if (!ok) {
+    for (int i = 0; i < n; i++) rgio_src_meta_free(&meta[i]);
+  }
+  return ok;
+}
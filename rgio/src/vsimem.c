@@ -0,0 +1,78 @@
+/*
+ * vsimem.c
+ * Lifetime and usage of /vsimem files created by rgio
+ */
+
+#include <R.h>
+#include <Rinternals.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <cpl_vsi.h>
+#include <string.h>
+#include "gdal_utils.h"
+
+/*
+ * _rgio_vsimem_remove
+ * Remove the /vsimem directory `dir` with all files in it. Called by the
+ * finalizer of rg_vrt handles and by rg_vrt_release(); returns TRUE when
+ * the directory existed.
+ */
+SEXP _rgio_vsimem_remove(SEXP dir) {
+  if (TYPEOF(dir) != STRSXP || length(dir) != 1 ||
+      strncmp(CHAR(STRING_ELT(dir, 0)), "/vsimem/", 8) != 0) {
+    error("'dir' must be a single /vsimem/ path");
+  }
+  const char *path = CHAR(STRING_ELT(dir, 0));
+  VSIStatBufL st;
+  int exists = VSIStatL(path, &st) == 0;
+  if (exists) VSIRmdirRecursive(path);
+  return Rf_ScalarLogical(exists);
+}
+
+/*
+ * _rgio_vsimem_usage
+ * Files under `prefix` (a /vsimem/ path) and their sizes in bytes, as a
+ * list(path, bytes).
+ */
+SEXP _rgio_vsimem_usage(SEXP prefix) {
+  if (TYPEOF(prefix) != STRSXP || length(prefix) != 1) {
+    error("'prefix' must be a single character string");
+  }
+  const char *root = CHAR(STRING_ELT(prefix, 0));
+  if (strncmp(root, "/vsimem/", 8) != 0) {
+    error("'prefix' must start with /vsimem/");
+  }
+
+  char **entries = VSIReadDirRecursive(root);
+  int n_entries = CSLCount((CSLConstList) entries);
+  char **paths = NULL;
+  GIntBig *sizes = (GIntBig *) CPLCalloc(n_entries > 0 ? n_entries : 1, sizeof(GIntBig));
+  int n = 0;
+  for (int i = 0; i < n_entries; i++) {
+    const char *path = CPLFormFilename(root, entries[i], NULL);
+    VSIStatBufL st;
+    if (VSIStatL(path, &st) != 0 || VSI_ISDIR(st.st_mode)) continue;
+    paths = CSLAddString(paths, path);
+    sizes[n++] = st.st_size;
+  }
+  CSLDestroy(entries);
+
+  SEXP out = PROTECT(allocVector(VECSXP, 2));
+  SEXP r_path = PROTECT(allocVector(STRSXP, n));
+  SEXP r_bytes = PROTECT(allocVector(REALSXP, n));
+  for (int i = 0; i < n; i++) {
+    SET_STRING_ELT(r_path, i, mkChar(paths[i]));
+    REAL(r_bytes)[i] = (double) sizes[i];
+  }
+  CSLDestroy(paths);
+  CPLFree(sizes);
+  SET_VECTOR_ELT(out, 0, r_path);
+  SET_VECTOR_ELT(out, 1, r_bytes);
+
+  SEXP names = PROTECT(allocVector(STRSXP, 2));
+  SET_STRING_ELT(names, 0, mkChar("path"));
+  SET_STRING_ELT(names, 1, mkChar("bytes"));
+  setAttrib(out, R_NamesSymbol, names);
+  UNPROTECT(4);
+  return out;
+}